@@ -0,0 +1,155 @@
+//
+// Counts heap allocations of `ObjReader::ParseFromString`.
+//
+// Shapes, materials and tags are moved(not copied) to the output with C++11,
+// so the storage of each element is allocated only once. Compare with the
+// C++03 build(`alloc_count_cxx03`), where they are copied.
+//
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+static size_t gNumAllocs = 0;
+static size_t gAllocBytes = 0;
+
+static void *CountedAlloc(size_t size) {
+  gNumAllocs++;
+  gAllocBytes += size;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// All forms of the global operator new/delete are replaced, so that every
+// pointer is released by the matching function.
+#if __cplusplus > 199711L
+void *operator new(size_t size) { return CountedAlloc(size); }
+void *operator new[](size_t size) { return CountedAlloc(size); }
+#else
+void *operator new(size_t size) throw(std::bad_alloc) {
+  return CountedAlloc(size);
+}
+void *operator new[](size_t size) throw(std::bad_alloc) {
+  return CountedAlloc(size);
+}
+#endif
+
+// GCC cannot inline `operator new` with a dynamic exception specification
+// (C++03), so it does not see that the pointer freed here comes from malloc.
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11) && \
+    (__cplusplus <= 199711L)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *p) throw() { free(p); }
+void operator delete[](void *p) throw() { free(p); }
+#if __cplusplus >= 201402L
+void operator delete(void *p, size_t) throw() { free(p); }
+void operator delete[](void *p, size_t) throw() { free(p); }
+#endif
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11) && \
+    (__cplusplus <= 199711L)
+#pragma GCC diagnostic pop
+#endif
+
+// Texture names are longer than the small string buffer of std::string, so
+// each of them takes an allocation.
+static void GenerateObj(int num_shapes, int num_materials,
+                        std::string *obj_text, std::string *mtl_text) {
+  const int n = 32;  // grid size of a shape
+
+  std::stringstream mtl;
+  for (int m = 0; m < num_materials; m++) {
+    mtl << "newmtl material_with_a_long_name_" << m << "\n";
+    mtl << "Kd 0.8 0.8 0.8\n";
+    mtl << "map_Ka textures/ambient_texture_" << m << ".png\n";
+    mtl << "map_Kd textures/diffuse_texture_" << m << ".png\n";
+    mtl << "map_Ks textures/specular_texture_" << m << ".png\n";
+    mtl << "map_Bump textures/normal_map_texture_" << m << ".png\n";
+  }
+  (*mtl_text) = mtl.str();
+
+  std::stringstream obj;
+  obj << "mtllib dummy.mtl\n";
+  for (int y = 0; y <= n; y++) {
+    for (int x = 0; x <= n; x++) {
+      obj << "v " << x << " " << y << " 0\n";
+    }
+  }
+  obj << "t crease 2/1/0 1 2 0.5\n";
+  for (int s = 0; s < num_shapes; s++) {
+    obj << "g shape_with_a_long_name_" << s << "\n";
+    obj << "usemtl material_with_a_long_name_" << (s % num_materials) << "\n";
+    for (int y = 0; y < n; y++) {
+      for (int x = 0; x < n; x++) {
+        int i0 = y * (n + 1) + x + 1;
+        obj << "f " << i0 << " " << (i0 + 1) << " " << (i0 + n + 2) << " "
+            << (i0 + n + 1) << "\n";
+      }
+    }
+  }
+  (*obj_text) = obj.str();
+}
+
+static void CountAllocs(int num_shapes, int num_materials, size_t *num_allocs,
+                        size_t *alloc_bytes) {
+  std::string obj_text;
+  std::string mtl_text;
+  GenerateObj(num_shapes, num_materials, &obj_text, &mtl_text);
+
+  tinyobj::ObjReader reader;
+
+  gNumAllocs = 0;
+  gAllocBytes = 0;
+  if (!reader.ParseFromString(obj_text, mtl_text)) {
+    printf("Failed to parse: %s\n", reader.Error().c_str());
+    exit(EXIT_FAILURE);
+  }
+  (*num_allocs) = gNumAllocs;
+  (*alloc_bytes) = gAllocBytes;
+}
+
+int main(int argc, char **argv) {
+  int num_shapes = 1000;
+  int num_materials = 1000;
+  if (argc > 1) {
+    num_shapes = atoi(argv[1]);
+    num_materials = num_shapes;
+  }
+  if (num_shapes < 1) {
+    num_shapes = num_materials = 1;
+  }
+
+#if __cplusplus > 199711L
+  printf("C++11(move)\n");
+#else
+  printf("C++03(copy)\n");
+#endif
+
+  // The difference between N and 2N elements is the cost of each element.
+  size_t num_allocs[2];
+  size_t alloc_bytes[2];
+  CountAllocs(num_shapes, num_materials, &num_allocs[0], &alloc_bytes[0]);
+  CountAllocs(2 * num_shapes, 2 * num_materials, &num_allocs[1],
+              &alloc_bytes[1]);
+
+  printf("%d shapes, %d materials: %lu allocations, %lu bytes\n", num_shapes,
+         num_materials, static_cast<unsigned long>(num_allocs[0]),
+         static_cast<unsigned long>(alloc_bytes[0]));
+  printf("%d shapes, %d materials: %lu allocations, %lu bytes\n",
+         2 * num_shapes, 2 * num_materials,
+         static_cast<unsigned long>(num_allocs[1]),
+         static_cast<unsigned long>(alloc_bytes[1]));
+  printf("per shape + material: %.1f allocations, %.1f bytes\n",
+         double(num_allocs[1] - num_allocs[0]) / double(num_shapes),
+         double(alloc_bytes[1] - alloc_bytes[0]) / double(num_shapes));
+
+  return EXIT_SUCCESS;
+}
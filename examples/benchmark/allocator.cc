@@ -0,0 +1,221 @@
+//
+// Parses a .obj in memory with `ObjReader`, with the default allocator
+// (`allocator_default`) or with an arena allocator given by
+// TINYOBJLOADER_ALLOCATOR(`allocator_arena`).
+//
+// The arena hands out memory from large blocks and frees nothing; it is reset
+// after each parse, so growing the arrays of the loader costs no malloc/free.
+//
+// Usage: allocator_default [file.obj]
+//        allocator_arena [file.obj]
+//
+#ifdef BENCHMARK_ARENA
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Blocks are kept by `Reset`, so later parses reuse the memory(pages) of
+// earlier ones.
+class Arena {
+ public:
+  static void *Allocate(size_t size) {
+    size = (size + 15) & ~size_t(15);
+    while (used_ + size > capacity_) {
+      if (current_ < blocks_.size() && blocks_[current_].second >= size) {
+        // Next kept block.
+      } else {
+        size_t block_size = (size > kBlockSize) ? size : kBlockSize;
+        char *block = static_cast<char *>(malloc(block_size));
+        if (!block) throw std::bad_alloc();
+        blocks_.insert(blocks_.begin() + static_cast<std::ptrdiff_t>(current_),
+                       std::make_pair(block, block_size));
+      }
+      base_ = blocks_[current_].first;
+      capacity_ = blocks_[current_].second;
+      used_ = 0;
+      current_++;
+    }
+    void *p = base_ + used_;
+    used_ += size;
+    return p;
+  }
+
+  static void Reset() {
+    current_ = 0;
+    base_ = NULL;
+    used_ = capacity_ = 0;
+  }
+
+  static void Release() {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+      free(blocks_[i].first);
+    }
+    blocks_.clear();
+    Reset();
+  }
+
+ private:
+  static const size_t kBlockSize = 64 * 1024 * 1024;
+  static std::vector<std::pair<char *, size_t> > blocks_;
+  static size_t current_;  // index of the next block
+  static char *base_;
+  static size_t used_;
+  static size_t capacity_;
+};
+
+std::vector<std::pair<char *, size_t> > Arena::blocks_;
+size_t Arena::current_ = 0;
+char *Arena::base_ = NULL;
+size_t Arena::used_ = 0;
+size_t Arena::capacity_ = 0;
+
+template <typename T>
+struct arena_allocator {
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  template <typename U>
+  struct rebind {
+    typedef arena_allocator<U> other;
+  };
+
+  arena_allocator() {}
+  template <typename U>
+  arena_allocator(const arena_allocator<U> &) {}
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+  pointer allocate(size_type n, const void * = 0) {
+    return static_cast<pointer>(Arena::Allocate(n * sizeof(T)));
+  }
+  void deallocate(pointer, size_type) {}
+  size_type max_size() const { return size_type(-1) / sizeof(T); }
+  void construct(pointer p, const T &v) { new (p) T(v); }
+  void destroy(pointer p) { p->~T(); }
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T> &, const arena_allocator<U> &) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T> &, const arena_allocator<U> &) {
+  return false;
+}
+
+#define TINYOBJLOADER_ALLOCATOR arena_allocator
+#endif
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static const int kNumRepeats = 5;
+
+static double Now() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// A grid of n x n quads, split into 100 shapes.
+static std::string GenerateObj(int n) {
+  std::stringstream ss;
+  for (int y = 0; y <= n; y++) {
+    for (int x = 0; x <= n; x++) {
+      ss << "v " << x << " " << y << " 0\n";
+      ss << "vt " << (float(x) / n) << " " << (float(y) / n) << "\n";
+    }
+  }
+  ss << "vn 0 0 1\n";
+  for (int y = 0; y < n; y++) {
+    if ((y % (n / 100 + 1)) == 0) {
+      ss << "g shape_" << y << "\n";
+    }
+    for (int x = 0; x < n; x++) {
+      int i0 = y * (n + 1) + x + 1;
+      int i1 = i0 + 1;
+      int i2 = i0 + n + 2;
+      int i3 = i0 + n + 1;
+      ss << "f " << i0 << "/" << i0 << "/1 " << i1 << "/" << i1 << "/1 " << i2
+         << "/" << i2 << "/1 " << i3 << "/" << i3 << "/1\n";
+    }
+  }
+  return ss.str();
+}
+
+static bool ReadFile(const char *filename, std::string *data) {
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  (*data) = ss.str();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string obj_text;
+  const char *name = "1000x1000 grid";
+  if (argc > 1) {
+    name = argv[1];
+    if (!ReadFile(argv[1], &obj_text)) {
+      printf("Failed to read %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  } else {
+    obj_text = GenerateObj(1000);
+  }
+
+  tinyobj::ObjReaderConfig config;
+  config.triangulate = true;
+
+  double best = 1e30;
+  size_t num_indices = 0;
+  for (int i = 0; i < kNumRepeats; i++) {
+    double t0 = Now();
+    {
+      tinyobj::ObjReader reader;
+      if (!reader.ParseFromString(obj_text, "", config)) {
+        printf("Failed to parse: %s\n", reader.Error().c_str());
+        return EXIT_FAILURE;
+      }
+      num_indices = 0;
+      for (size_t s = 0; s < reader.GetShapes().size(); s++) {
+        num_indices += reader.GetShapes()[s].mesh.indices.size();
+      }
+    }
+#ifdef BENCHMARK_ARENA
+    Arena::Reset();
+#endif
+    double t1 = Now();
+    if ((t1 - t0) < best) best = t1 - t0;
+  }
+
+#ifdef BENCHMARK_ARENA
+  const char *allocator = "arena";
+#else
+  const char *allocator = "std::allocator";
+#endif
+  printf("%-32s %-16s %9.3f ms  (%lu indices)\n", name, allocator, best,
+         static_cast<unsigned long>(num_indices));
+
+#ifdef BENCHMARK_ARENA
+  Arena::Release();
+#endif
+
+  return EXIT_SUCCESS;
+}
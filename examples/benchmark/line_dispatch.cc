@@ -0,0 +1,156 @@
+//
+// Microbenchmark of line classification.
+//
+// Parses .obj files(e.g. models/*.obj) in memory with `ObjReader` and
+// `LoadObjWithCallback`, and a generated .mtl with 100k materials with
+// `LoadMtl`. Each material has most of the keywords of the MTL format, so the
+// .mtl is dominated by keyword dispatch.
+//
+// Usage: line_dispatch [file.obj ...]
+//
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int kNumRepeats = 5;
+
+static double Now() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::string GenerateMtl(int num_materials) {
+  static const char *kKeywords[] = {
+      "Ka 0.1 0.1 0.1",
+      "Kd 0.8 0.8 0.8",
+      "Ks 0.5 0.5 0.5",
+      "Kt 0.0 0.0 0.0",
+      "Ke 0.0 0.0 0.0",
+      "Ni 1.45",
+      "Ns 32",
+      "illum 2",
+      "d 1.0",
+      "Pr 0.5",
+      "Pm 0.0",
+      "Ps 0.1",
+      "Pc 0.2",
+      "Pcr 0.3",
+      "aniso 0.0",
+      "anisor 0.0",
+      "map_Ka ambient.png",
+      "map_Kd diffuse.png",
+      "map_Ks specular.png",
+      "map_Ns shininess.png",
+      "map_bump -bm 0.5 bump.png",
+      "map_d alpha.png",
+      "disp disp.png",
+      "refl -type sphere refl.png",
+      "map_Pr roughness.png",
+      "map_Pm metallic.png",
+      "map_Ke emissive.png",
+      "norm normal.png",
+      "custom_param 1 2 3",
+      NULL};
+
+  std::stringstream ss;
+  for (int m = 0; m < num_materials; m++) {
+    ss << "newmtl material_" << m << "\n";
+    for (int k = 0; kKeywords[k]; k++) {
+      ss << kKeywords[k] << "\n";
+    }
+  }
+  return ss.str();
+}
+
+static bool ReadFile(const char *filename, std::string *data) {
+  std::ifstream ifs(filename, std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  (*data) = ss.str();
+  return true;
+}
+
+static void vertex_cb(void *, tinyobj::real_t, tinyobj::real_t,
+                      tinyobj::real_t, tinyobj::real_t) {}
+
+static void BenchObj(const char *filename, double *reader_ms,
+                     double *callback_ms) {
+  std::string obj_text;
+  if (!ReadFile(filename, &obj_text)) {
+    printf("Failed to read %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  // .mtl files are not read, so only the .obj is measured.
+  tinyobj::ObjReaderConfig config;
+  config.triangulate = false;
+
+  tinyobj::callback_t callback;
+  callback.vertex_cb = vertex_cb;
+
+  double best_reader = 1e30;
+  double best_callback = 1e30;
+  for (int i = 0; i < kNumRepeats; i++) {
+    tinyobj::ObjReader reader;
+    double t0 = Now();
+    reader.ParseFromString(obj_text, "", config);
+    double t1 = Now();
+
+    std::istringstream iss(obj_text);
+    tinyobj::LoadObjWithCallback(iss, callback);
+    double t2 = Now();
+
+    if ((t1 - t0) < best_reader) best_reader = t1 - t0;
+    if ((t2 - t1) < best_callback) best_callback = t2 - t1;
+  }
+
+  printf("%-48s %9.3f ms(ObjReader) %9.3f ms(callback)\n", filename,
+         best_reader, best_callback);
+  (*reader_ms) += best_reader;
+  (*callback_ms) += best_callback;
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> filenames;
+  for (int i = 1; i < argc; i++) {
+    filenames.push_back(argv[i]);
+  }
+
+  double reader_ms = 0.0;
+  double callback_ms = 0.0;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    BenchObj(filenames[i], &reader_ms, &callback_ms);
+  }
+  if (!filenames.empty()) {
+    printf("%-48s %9.3f ms(ObjReader) %9.3f ms(callback)\n", "total",
+           reader_ms, callback_ms);
+  }
+
+  std::string mtl_text = GenerateMtl(100000);
+  double best_mtl = 1e30;
+  for (int i = 0; i < kNumRepeats; i++) {
+    std::istringstream iss(mtl_text);
+    std::map<std::string, int> material_map;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    double t0 = Now();
+    tinyobj::LoadMtl(&material_map, &materials, &iss, &warn, &err);
+    double t1 = Now();
+    if ((t1 - t0) < best_mtl) best_mtl = t1 - t0;
+  }
+  printf("%-48s %9.3f ms(LoadMtl)\n", "100k materials", best_mtl);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+//
+// Thread scaling of `parseObj` of experimental/tinyobj_loader_opt.h.
+//
+// Parses a .obj(or a generated one: a large `v` block followed by a large `f`
+// block, which is the worst case of a static split) with 1 to 128 threads,
+// with small chunks scheduled by work stealing(`LoadOption::chunk_size`,
+// default 64 KiB) and with one chunk per thread(= the static split of
+// `len / num_threads`).
+//
+// Usage: opt_scaling [file.obj]
+//
+#define TINYOBJ_LOADER_OPT_IMPLEMENTATION
+#include "tinyobj_loader_opt.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static const int kNumRepeats = 3;
+
+static std::string GenerateObj(int n) {
+  std::stringstream ss;
+  for (int y = 0; y <= n; y++) {
+    for (int x = 0; x <= n; x++) {
+      ss << "v " << x << ".5 " << y << ".25 0.125\n";
+    }
+  }
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      int i0 = y * (n + 1) + x + 1;
+      ss << "f " << i0 << " " << (i0 + 1) << " " << (i0 + n + 2) << " "
+         << (i0 + n + 1) << "\n";
+    }
+  }
+  return ss.str();
+}
+
+static double Parse(const std::string &obj_text, int num_threads,
+                    size_t chunk_size) {
+  double best = 1e30;
+  for (int i = 0; i < kNumRepeats; i++) {
+    tinyobj_opt::attrib_t attrib;
+    std::vector<tinyobj_opt::shape_t> shapes;
+    std::vector<tinyobj_opt::material_t> materials;
+    tinyobj_opt::LoadOption option;
+    option.req_num_threads = num_threads;
+    option.chunk_size = chunk_size;
+
+    auto t0 = std::chrono::steady_clock::now();
+    tinyobj_opt::parseObj(&attrib, &shapes, &materials, obj_text.data(),
+                          obj_text.size(), option);
+    auto t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    if (ms < best) best = ms;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  std::string obj_text;
+  if (argc > 1) {
+    std::ifstream ifs(argv[1], std::ios::binary);
+    if (!ifs) {
+      printf("Failed to read %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    obj_text = ss.str();
+  } else {
+    obj_text = GenerateObj(1000);
+  }
+  obj_text.push_back('\0');
+
+  printf("%.1f MB, %u hardware threads\n", double(obj_text.size()) / 1.0e6,
+         std::thread::hardware_concurrency());
+  printf("threads  work stealing(ms)  static split(ms)\n");
+
+  const tinyobj_opt::LoadOption default_option;
+  for (int num_threads = 1; num_threads <= 128; num_threads *= 2) {
+    double stealing_ms = Parse(obj_text, num_threads, default_option.chunk_size);
+    double static_ms =
+        Parse(obj_text, num_threads,
+              (obj_text.size() + size_t(num_threads) - 1) / size_t(num_threads));
+    printf("%7d  %17.2f  %16.2f\n", num_threads, stealing_ms, static_ms);
+  }
+
+  return EXIT_SUCCESS;
+}
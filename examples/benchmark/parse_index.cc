@@ -0,0 +1,173 @@
+//
+// Microbenchmark of face index parsing.
+//
+// Parses generated `f` vertices(`i/j/k` with 1 to 7 digit indices, some of
+// them relative) with
+//
+// - `parseTriple`(atoi + fixIndex for each index)
+// - `parseTripleAs`
+// - `parseRawTriple` of tinyobj_loader_opt.h with `my_atoi`
+// - `parseRawTriple` of tinyobj_loader_opt.h
+//
+// `parseTripleAs` and `parseRawTriple` convert digits 8 at once(SWAR), or one
+// by one when built with TINYOBJLOADER_DISABLE_SWAR(parse_index_noswar).
+//
+// The checksums of the first two(resolved indices) and of the last two(raw
+// indices) must be the same.
+//
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+#define TINYOBJ_LOADER_OPT_IMPLEMENTATION
+#include "experimental/tinyobj_loader_opt.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// `parseRawTriple` of tinyobj_loader_opt.h before SWAR.
+static tinyobj_opt::index_t parseRawTripleMyAtoi(const char **token) {
+  tinyobj_opt::index_t vi(static_cast<int>(0x80000000));
+  vi.vertex_index = tinyobj_opt::my_atoi((*token));
+  (*token) += strcspn((*token), "/ \t\r");
+  if ((*token)[0] != '/') {
+    return vi;
+  }
+  (*token)++;
+  if ((*token)[0] == '/') {
+    (*token)++;
+    vi.normal_index = tinyobj_opt::my_atoi((*token));
+    (*token) += strcspn((*token), "/ \t\r");
+    return vi;
+  }
+  vi.texcoord_index = tinyobj_opt::my_atoi((*token));
+  (*token) += strcspn((*token), "/ \t\r");
+  if ((*token)[0] != '/') {
+    return vi;
+  }
+  (*token)++;
+  vi.normal_index = tinyobj_opt::my_atoi((*token));
+  (*token) += strcspn((*token), "/ \t\r");
+  return vi;
+}
+
+static const int kNumAttribs = 10000000;
+
+#ifdef TINYOBJLOADER_HAS_SWAR
+#define DIGITS "(SWAR)"
+#else
+#define DIGITS "(scalar)"
+#endif
+
+static std::string GenerateFaceVertices(int num_vertices) {
+  std::string s;
+  char buf[64];
+  srand(1);
+  for (int i = 0; i < num_vertices; i++) {
+    int idx[3];
+    for (int k = 0; k < 3; k++) {
+      // 1 to 7 digits.
+      int digits = 1 + (rand() % 7);
+      int max_val = 1;
+      for (int d = 0; d < digits; d++) max_val *= 10;
+      if (max_val > kNumAttribs) max_val = kNumAttribs;
+      idx[k] = 1 + (rand() % max_val);
+      if ((rand() % 8) == 0) idx[k] = -idx[k];
+    }
+    snprintf(buf, sizeof(buf), "%d/%d/%d ", idx[0], idx[1], idx[2]);
+    s += buf;
+  }
+  return s;
+}
+
+typedef long long (*ParseFunc)(const std::string &s);
+
+static long long ParseTriple(const std::string &s) {
+  long long sum = 0;
+  std::string warn;
+  tinyobj::warning_context context;
+  context.warn = &warn;
+  context.line_number = 1;
+  const char *token = s.c_str();
+  while (token[0]) {
+    tinyobj::vertex_index_t vi;
+    tinyobj::parseTriple(&token, kNumAttribs, kNumAttribs, kNumAttribs, &vi,
+                         context);
+    sum += vi.v_idx + vi.vt_idx + vi.vn_idx;
+    token += strspn(token, " \t\r");
+  }
+  return sum;
+}
+
+static long long ParseTripleAs(const std::string &s) {
+  long long sum = 0;
+  const char *token = s.c_str();
+  const char *end = s.c_str() + s.size();
+  while (token[0]) {
+    tinyobj::vertex_index_t vi;
+    if (!tinyobj::parseTripleAs<tinyobj::FACE_PATTERN_V_VT_VN>(
+            &token, end, kNumAttribs, kNumAttribs, kNumAttribs, &vi)) {
+      printf("parseTripleAs failed at offset %lu\n",
+             static_cast<unsigned long>(token - s.c_str()));
+      exit(EXIT_FAILURE);
+    }
+    sum += vi.v_idx + vi.vt_idx + vi.vn_idx;
+    token += strspn(token, " \t\r");
+  }
+  return sum;
+}
+
+// Indices of tinyobj_loader_opt.h are resolved later(by `fixIndex`).
+static long long ParseRawTripleMyAtoi(const std::string &s) {
+  long long sum = 0;
+  const char *token = s.c_str();
+  while (token[0]) {
+    tinyobj_opt::index_t vi = parseRawTripleMyAtoi(&token);
+    sum += vi.vertex_index + vi.texcoord_index + vi.normal_index;
+    token += strspn(token, " \t\r");
+  }
+  return sum;
+}
+
+static long long ParseRawTriple(const std::string &s) {
+  long long sum = 0;
+  const char *token = s.c_str();
+  const char *end = s.c_str() + s.size();
+  while (token[0]) {
+    tinyobj_opt::index_t vi = tinyobj_opt::parseRawTriple(&token, end);
+    sum += vi.vertex_index + vi.texcoord_index + vi.normal_index;
+    token += strspn(token, " \t\r");
+  }
+  return sum;
+}
+
+static void Run(const char *name, ParseFunc func, const std::string &s,
+                int num_vertices) {
+  double best = 1e30;
+  long long sum = 0;
+  for (int i = 0; i < 5; i++) {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    sum = func(s);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    if (ms < best) best = ms;
+  }
+  printf("%-28s %8.2f ms  %6.2f ns/vertex  (checksum %lld)\n", name, best,
+         1.0e6 * best / num_vertices, sum);
+}
+
+int main(int argc, char **argv) {
+  int num_vertices = 10000000;
+  if (argc > 1) {
+    num_vertices = atoi(argv[1]);
+  }
+
+  std::string s = GenerateFaceVertices(num_vertices);
+
+  Run("parseTriple", ParseTriple, s, num_vertices);
+  Run("parseTripleAs" DIGITS, ParseTripleAs, s, num_vertices);
+  Run("opt: my_atoi", ParseRawTripleMyAtoi, s, num_vertices);
+  Run("opt: parseRawTriple" DIGITS, ParseRawTriple, s, num_vertices);
+
+  return EXIT_SUCCESS;
+}
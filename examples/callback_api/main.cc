@@ -1,7 +1,8 @@
 //
 // An example of how to use callback API.
 // This example is minimum and incomplete. Just showing the usage of callback
-// API.
+// API(`LoadObjWithCallback`), and batched callback API
+// (`LoadObjWithBatchCallback`, with `--batch` option).
 // You need to implement your own Mesh data struct constrution based on this
 // example in practical.
 //
@@ -117,7 +118,86 @@ void object_cb(void *user_data, const char *name) {
   printf("object : name = %s\n", name);
 }
 
+//
+// Batched callbacks. Attributes and indices are passed in arrays.
+//
+
+void batch_vertex_cb(void *user_data, const float *xyz, const float *w,
+                     size_t count) {
+  MyMesh *mesh = reinterpret_cast<MyMesh *>(user_data);
+  printf("v[%ld..%ld]\n", mesh->vertices.size() / 3,
+         mesh->vertices.size() / 3 + count - 1);
+
+  mesh->vertices.insert(mesh->vertices.end(), xyz, xyz + 3 * count);
+  // Discard w
+  (void)w;
+}
+
+void batch_normal_cb(void *user_data, const float *xyz, size_t count) {
+  MyMesh *mesh = reinterpret_cast<MyMesh *>(user_data);
+  printf("vn[%ld..%ld]\n", mesh->normals.size() / 3,
+         mesh->normals.size() / 3 + count - 1);
+
+  mesh->normals.insert(mesh->normals.end(), xyz, xyz + 3 * count);
+}
+
+void batch_texcoord_cb(void *user_data, const float *uvw, size_t count) {
+  MyMesh *mesh = reinterpret_cast<MyMesh *>(user_data);
+  printf("vt[%ld..%ld]\n", mesh->texcoords.size() / 3,
+         mesh->texcoords.size() / 3 + count - 1);
+
+  mesh->texcoords.insert(mesh->texcoords.end(), uvw, uvw + 3 * count);
+}
+
+void batch_face_cb(void *user_data, const tinyobj::index_t *indices,
+                   const unsigned int *num_vertices, size_t count) {
+  // NOTE: Unlike `index_cb`, indices are 0-based and relative indices are
+  // already resolved. -1 is set for the index value which does not exist in
+  // .obj
+  MyMesh *mesh = reinterpret_cast<MyMesh *>(user_data);
+  printf("%ld faces\n", count);
+
+  const tinyobj::index_t *idx = indices;
+  for (size_t f = 0; f < count; f++) {
+    for (unsigned int v = 0; v < num_vertices[f]; v++, idx++) {
+      mesh->v_indices.push_back(idx->vertex_index);
+      if (idx->normal_index != -1) {
+        mesh->vn_indices.push_back(idx->normal_index);
+      }
+      if (idx->texcoord_index != -1) {
+        mesh->vt_indices.push_back(idx->texcoord_index);
+      }
+    }
+  }
+}
+
+void batch_line_cb(void *user_data, const tinyobj::index_t *indices,
+                   const unsigned int *num_vertices, size_t count) {
+  (void)user_data;
+  (void)indices;
+  (void)num_vertices;
+  printf("%ld lines\n", count);
+}
+
+void batch_point_cb(void *user_data, const tinyobj::index_t *indices,
+                    const unsigned int *num_vertices, size_t count) {
+  (void)user_data;
+  (void)indices;
+  (void)num_vertices;
+  printf("%ld points\n", count);
+}
+
 int main(int argc, char **argv) {
+  bool batch = false;
+  std::string filename = "../../models/cornell_box.obj";
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--batch") {
+      batch = true;
+    } else {
+      filename = std::string(argv[i]);
+    }
+  }
+
   tinyobj::callback_t cb;
   cb.vertex_cb = vertex_cb;
   cb.normal_cb = normal_cb;
@@ -128,13 +208,22 @@ int main(int argc, char **argv) {
   cb.group_cb = group_cb;
   cb.object_cb = object_cb;
 
+  tinyobj::batch_callback_t batch_cb;
+  batch_cb.vertex_cb = batch_vertex_cb;
+  batch_cb.normal_cb = batch_normal_cb;
+  batch_cb.texcoord_cb = batch_texcoord_cb;
+  batch_cb.face_cb = batch_face_cb;
+  batch_cb.line_cb = batch_line_cb;
+  batch_cb.point_cb = batch_point_cb;
+  batch_cb.usemtl_cb = usemtl_cb;
+  batch_cb.mtllib_cb = mtllib_cb;
+  batch_cb.group_cb = group_cb;
+  batch_cb.object_cb = object_cb;
+  batch_cb.batch_size = 1024;
+
   MyMesh mesh;
   std::string warn;
   std::string err;
-  std::string filename = "../../models/cornell_box.obj";
-  if (argc > 1) {
-    filename = std::string(argv[1]);
-  }
   std::ifstream ifs(filename.c_str());
 
   if (ifs.fail()) {
@@ -144,7 +233,13 @@ int main(int argc, char **argv) {
 
   tinyobj::MaterialFileReader mtlReader("../../models/");
 
-  bool ret = tinyobj::LoadObjWithCallback(ifs, cb, &mesh, &mtlReader, &warn, &err);
+  bool ret;
+  if (batch) {
+    ret = tinyobj::LoadObjWithBatchCallback(ifs, batch_cb, &mesh, &mtlReader,
+                                            &warn, &err);
+  } else {
+    ret = tinyobj::LoadObjWithCallback(ifs, cb, &mesh, &mtlReader, &warn, &err);
+  }
 
   if (!warn.empty()) {
     std::cout << "WARN: " << warn << std::endl;
@@ -42,6 +42,7 @@ THE SOFTWARE.
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -50,12 +51,23 @@ THE SOFTWARE.
 #include <map>
 #include <vector>
 
-#include <atomic>  // C++11
-#include <chrono>  // C++11
-#include <thread>  // C++11
+#include <algorithm>
+#include <atomic>              // C++11
+#include <chrono>              // C++11
+#include <condition_variable>  // C++11
+#include <functional>          // C++11
+#include <mutex>               // C++11
+#include <thread>              // C++11
 
 #include "lfpAlloc/Allocator.hpp"
 
+// Number parsing(`tinyobj::tryParseDoubleFast`, SWAR digit conversion) and
+// SIMD byte scanning(`tinyobj::ScanBytes`) are shared with tiny_obj_loader.h.
+// Define TINYOBJLOADER_DISABLE_SIMD to always scan byte by byte, and
+// TINYOBJLOADER_DISABLE_SWAR to always convert digits one by one.
+#define TINYOBJLOADER_PARSE_HELPERS
+#include "../tiny_obj_loader.h"
+
 namespace tinyobj_opt {
 
 // ----------------------------------------------------------------------------
@@ -405,19 +417,58 @@ static inline int my_atoi(const char *c) {
   return value * sign;
 }
 
+// Same as `my_atoi`, but converts up to 8 digits at once on little endian
+// targets, and advances `token` to the end of the digits. `token` must be in
+// the '\0' terminated string which ends at `end`.
+static inline int parseIndex(const char **token, const char *end) {
+  const char *c = (*token);
+  int sign = 1;
+  if (*c == '+' || *c == '-') {
+    if (*c == '-') sign = -1;
+    c++;
+  }
+  int value = 0;
+#ifdef TINYOBJLOADER_HAS_SWAR
+  if ((end - c) >= 8) {
+    uint64_t val;
+    memcpy(&val, c, 8);
+    uint32_t digits = 0;
+    const int n = tinyobj::parseLeadingDigits(val, &digits);
+    if ((n < 8) || !IS_DIGIT(c[8])) {
+      (*token) = c + n;
+      return static_cast<int>(digits) * sign;
+    }
+  }
+#else
+  (void)end;
+#endif
+  while (IS_DIGIT(*c)) {
+    value *= 10;
+    value += (int)(*c - '0');
+    c++;
+  }
+  (*token) = c;
+  return value * sign;
+}
+
 // Make index zero-base, and also support relative index.
+// Resolves a raw index of `parseRawTriple`. `n` is the number of elements
+// defined before the face. Returns -1 for an unspecified(0x80000000) or out of
+// range relative index.
 static inline int fixIndex(int idx, int n) {
   if (idx > 0) return idx - 1;
   if (idx == 0) return 0;
+  if (idx == static_cast<int>(0x80000000)) return -1;  // not specified
+  if (n + idx < 0) return -1;
   return n + idx;  // negative value = relative
 }
 
 // Parse raw triples: i, i/j/k, i//k, i/j
-static index_t parseRawTriple(const char **token) {
+static index_t parseRawTriple(const char **token, const char *end) {
   index_t vi(
       static_cast<int>(0x80000000));  // 0x80000000 = -2147483648 = invalid
 
-  vi.vertex_index = my_atoi((*token));
+  vi.vertex_index = parseIndex(token, end);
   while ((*token)[0] != '\0' && (*token)[0] != '/' && (*token)[0] != ' ' &&
          (*token)[0] != '\t' && (*token)[0] != '\r') {
     (*token)++;
@@ -430,7 +481,7 @@ static index_t parseRawTriple(const char **token) {
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    vi.normal_index = my_atoi((*token));
+    vi.normal_index = parseIndex(token, end);
     while ((*token)[0] != '\0' && (*token)[0] != '/' && (*token)[0] != ' ' &&
            (*token)[0] != '\t' && (*token)[0] != '\r') {
       (*token)++;
@@ -439,7 +490,7 @@ static index_t parseRawTriple(const char **token) {
   }
 
   // i/j/k or i/j
-  vi.texcoord_index = my_atoi((*token));
+  vi.texcoord_index = parseIndex(token, end);
   while ((*token)[0] != '\0' && (*token)[0] != '/' && (*token)[0] != ' ' &&
          (*token)[0] != '\t' && (*token)[0] != '\r') {
     (*token)++;
@@ -450,7 +501,7 @@ static index_t parseRawTriple(const char **token) {
 
   // i/j/k
   (*token)++;  // skip '/'
-  vi.normal_index = my_atoi((*token));
+  vi.normal_index = parseIndex(token, end);
   while ((*token)[0] != '\0' && (*token)[0] != '/' && (*token)[0] != ' ' &&
          (*token)[0] != '\t' && (*token)[0] != '\r') {
     (*token)++;
@@ -505,6 +556,10 @@ static bool tryParseDouble(const char *s, const char *s_end, double *result) {
     return false;
   }
 
+  if (tinyobj::tryParseDoubleFast<float>(s, s_end, result)) {
+    return true;
+  }
+
   double mantissa = 0.0;
   // This exponent is base 2 rather than 10.
   // However the exponent we parse is supposed to be one of ten,
@@ -993,49 +1048,30 @@ typedef enum {
 
 } CommandType;
 
+// A parsed line, or consecutive lines of the same type(v, vn, vt or f).
+// Values of v, vn, vt and f are stored in flat arrays of the chunk(see
+// `CommandBuffer`), so a command is a small fixed-size record.
 typedef struct {
-  float vx, vy, vz;
-  float nx, ny, nz;
-  float tx, ty;
-
-  // for f
-  std::vector<index_t, lfpAlloc::lfpAllocator<index_t> > f;
-  // std::vector<index_t> f;
-  std::vector<int, lfpAlloc::lfpAllocator<int> > f_num_verts;
-
-  const char *group_name;
-  unsigned int group_name_len;
-  const char *object_name;
-  unsigned int object_name_len;
-  const char *material_name;
-  unsigned int material_name_len;
-
-  const char *mtllib_name;
-  unsigned int mtllib_name_len;
-
   CommandType type;
-} Command;
+  // v, vn, vt: the number of lines, f: the number of faces(after
+  // triangulation).
+  unsigned int count;
 
-struct CommandCount {
-  size_t num_v;
-  size_t num_vn;
-  size_t num_vt;
-  size_t num_f;
-  size_t num_indices;
-  CommandCount() {
-    num_v = 0;
-    num_vn = 0;
-    num_vt = 0;
-    num_f = 0;
-    num_indices = 0;
-  }
-};
+  // g, o, usemtl and mtllib: the name(points into the .obj buffer)
+  const char *name;
+  unsigned int name_len;
+} Command;
 
 class LoadOption {
  public:
-  LoadOption() : req_num_threads(-1), triangulate(true), verbose(false) {}
+  LoadOption()
+      : req_num_threads(-1),
+        chunk_size(64 * 1024),
+        triangulate(true),
+        verbose(false) {}
 
   int req_num_threads;
+  size_t chunk_size;  // Size of a chunk of .obj text scheduled to a thread.
   bool triangulate;
   bool verbose;
 };
@@ -1043,6 +1079,8 @@ class LoadOption {
 /// Parse wavefront .obj(.obj string data is expanded to linear char array
 /// `buf')
 /// -1 to req_num_threads use the number of HW threads in the running system.
+/// The buffer is processed in chunks of `chunk_size` bytes by a pool of
+/// threads with work stealing.
 bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
               std::vector<material_t> *materials, const char *buf, size_t len,
               const LoadOption &option);
@@ -1055,11 +1093,55 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
 namespace tinyobj_opt {
 
-static bool parseLine(Command *command, const char *p, size_t p_len,
+// Parsed lines of a chunk. Vertex attributes and face indices are appended to
+// flat arrays in the order of lines, and `commands` records the order of
+// lines, so the merge can copy them in bulk.
+struct CommandBuffer {
+  std::vector<float> vertices;   // 3 per `v`
+  std::vector<float> normals;    // 3 per `vn`
+  std::vector<float> texcoords;  // 2 per `vt`
+  std::vector<index_t> indices;  // raw(not resolved) indices of `f`
+  std::vector<int> face_num_verts;
+  std::vector<Command> commands;
+
+  // Adds `count` elements of v, vn, vt or f. Merged into the last command if
+  // it has the same type.
+  void Append(CommandType type, unsigned int count) {
+    if (!commands.empty() && (commands.back().type == type)) {
+      commands.back().count += count;
+      return;
+    }
+    Command command;
+    command.type = type;
+    command.count = count;
+    command.name = NULL;
+    command.name_len = 0;
+    commands.push_back(command);
+  }
+
+  // Adds g, o, usemtl or mtllib.
+  void AppendName(CommandType type, const char *name, unsigned int name_len) {
+    Command command;
+    command.type = type;
+    command.count = 1;
+    command.name = name;
+    command.name_len = name_len;
+    commands.push_back(command);
+  }
+};
+
+static bool parseLine(CommandBuffer *buffer, const char *p, size_t p_len,
                       bool triangulate = true) {
   // @todo { operate directly on pointer `p'. to do that, add range check for
   // string operatoion against `p', since `p' is not null-terminated at p[p_len]
   // }
+  // Skip leading space.
+  size_t s = static_cast<size_t>(
+      tinyobj::ScanBytes(p, p + p_len, ' ', '\t', '\t', /* match */ false) -
+      p);
+  p += s;
+  p_len -= s;
+
   char linebuf[4096];
   assert(p_len < 4095);
   memcpy(linebuf, p, p_len);
@@ -1067,11 +1149,6 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
 
   const char *token = linebuf;
 
-  command->type = COMMAND_EMPTY;
-
-  // Skip leading space.
-  skip_space(&token);
-
   assert(token);
   if (token[0] == '\0') {  // empty line
     return false;
@@ -1086,10 +1163,10 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 2;
     float x = 0.0f, y = 0.0f, z = 0.0f;
     parseFloat3(&x, &y, &z, &token);
-    command->vx = x;
-    command->vy = y;
-    command->vz = z;
-    command->type = COMMAND_V;
+    buffer->vertices.push_back(x);
+    buffer->vertices.push_back(y);
+    buffer->vertices.push_back(z);
+    buffer->Append(COMMAND_V, 1);
     return true;
   }
 
@@ -1098,10 +1175,10 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 3;
     float x = 0.0f, y = 0.0f, z = 0.0f;
     parseFloat3(&x, &y, &z, &token);
-    command->nx = x;
-    command->ny = y;
-    command->nz = z;
-    command->type = COMMAND_VN;
+    buffer->normals.push_back(x);
+    buffer->normals.push_back(y);
+    buffer->normals.push_back(z);
+    buffer->Append(COMMAND_VN, 1);
     return true;
   }
 
@@ -1110,9 +1187,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 3;
     float x = 0.0f, y = 0.0f;
     parseFloat2(&x, &y, &token);
-    command->tx = x;
-    command->ty = y;
-    command->type = COMMAND_VT;
+    buffer->texcoords.push_back(x);
+    buffer->texcoords.push_back(y);
+    buffer->Append(COMMAND_VT, 1);
     return true;
   }
 
@@ -1124,14 +1201,13 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     StackVector<index_t, 8> f;
 
     while (!IS_NEW_LINE(token[0])) {
-      index_t vi = parseRawTriple(&token);
+      index_t vi = parseRawTriple(&token, linebuf + p_len);
       skip_space_and_cr(&token);
 
       f->push_back(vi);
     }
 
-    command->type = COMMAND_F;
-
+    unsigned int num_faces = 0;
     if (triangulate) {
       index_t i0 = f[0];
       index_t i1(-1);
@@ -1140,19 +1216,25 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
       for (size_t k = 2; k < f->size(); k++) {
         i1 = i2;
         i2 = f[k];
-        command->f.emplace_back(i0);
-        command->f.emplace_back(i1);
-        command->f.emplace_back(i2);
+        buffer->indices.push_back(i0);
+        buffer->indices.push_back(i1);
+        buffer->indices.push_back(i2);
 
-        command->f_num_verts.emplace_back(3);
+        buffer->face_num_verts.push_back(3);
+        num_faces++;
       }
 
     } else {
       for (size_t k = 0; k < f->size(); k++) {
-        command->f.emplace_back(f[k]);
+        buffer->indices.push_back(f[k]);
       }
 
-      command->f_num_verts.emplace_back(f->size());
+      buffer->face_num_verts.push_back(static_cast<int>(f->size()));
+      num_faces++;
+    }
+
+    if (num_faces > 0) {
+      buffer->Append(COMMAND_F, num_faces);
     }
 
     return true;
@@ -1177,10 +1259,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // namebuf + strlen(namebuf));
     // command->material_name->push_back('\0');
     skip_space(&token);
-    command->material_name = p + (token - linebuf);
-    command->material_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_USEMTL;
+    buffer->AppendName(
+        COMMAND_USEMTL, p + (token - linebuf),
+        length_until_newline(token, p_len - (token - linebuf)) + 1);
 
     return true;
   }
@@ -1191,10 +1272,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 7;
 
     skip_space(&token);
-    command->mtllib_name = p + (token - linebuf);
-    command->mtllib_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_MTLLIB;
+    buffer->AppendName(
+        COMMAND_MTLLIB, p + (token - linebuf),
+        length_until_newline(token, p_len - (token - linebuf)) + 1);
 
     return true;
   }
@@ -1204,10 +1284,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // @todo { multiple group name. }
     token += 2;
 
-    command->group_name = p + (token - linebuf);
-    command->group_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_G;
+    buffer->AppendName(
+        COMMAND_G, p + (token - linebuf),
+        length_until_newline(token, p_len - (token - linebuf)) + 1);
 
     return true;
   }
@@ -1217,10 +1296,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // @todo { multiple object name? }
     token += 2;
 
-    command->object_name = p + (token - linebuf);
-    command->object_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_O;
+    buffer->AppendName(
+        COMMAND_O, p + (token - linebuf),
+        length_until_newline(token, p_len - (token - linebuf)) + 1);
 
     return true;
   }
@@ -1238,10 +1316,169 @@ typedef struct {
 // 2. find newline(\n, \r\n, \r) and list of line data.
 // 3. Do parallel parsing for each line.
 // 4. Reconstruct final mesh data structure.
+//
+// The buffer is split into small fixed-size chunks(`LoadOption::chunk_size`),
+// and each step is done per chunk by a pool of worker threads. Chunks are
+// first distributed evenly, and a worker which finished its own chunks steals
+// chunks from others, so threads are kept busy even when the cost of chunks
+// varies(e.g. a large `v` block followed by a large `f` block).
+
+// Range of task indices [begin, end) owned by a worker, packed into 64 bits
+// so that both the owner(from the front) and thieves(from the back) can take
+// a task with a single CAS. Padded to a cache line to avoid false sharing.
+struct TaskRange {
+  std::atomic<uint64_t> range;
+  char pad[64 - sizeof(std::atomic<uint64_t>)];
+
+  TaskRange() : range(0) {}
+
+  void Set(uint32_t begin, uint32_t end) {
+    range.store((uint64_t(begin) << 32) | end, std::memory_order_relaxed);
+  }
+
+  bool PopFront(size_t *task) {
+    uint64_t r = range.load(std::memory_order_relaxed);
+    for (;;) {
+      uint32_t begin = uint32_t(r >> 32);
+      uint32_t end = uint32_t(r);
+      if (begin >= end) return false;
+      uint64_t next = (uint64_t(begin + 1) << 32) | end;
+      if (range.compare_exchange_weak(r, next, std::memory_order_acq_rel)) {
+        (*task) = begin;
+        return true;
+      }
+    }
+  }
+
+  bool PopBack(size_t *task) {
+    uint64_t r = range.load(std::memory_order_relaxed);
+    for (;;) {
+      uint32_t begin = uint32_t(r >> 32);
+      uint32_t end = uint32_t(r);
+      if (begin >= end) return false;
+      uint64_t next = (uint64_t(begin) << 32) | (end - 1);
+      if (range.compare_exchange_weak(r, next, std::memory_order_acq_rel)) {
+        (*task) = end - 1;
+        return true;
+      }
+    }
+  }
+};
+
+// Persistent worker threads with work stealing. The calling thread works as
+// worker 0, so `num_threads` - 1 threads are created.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads)
+      : queues_((std::max)(size_t(1), num_threads)),
+        num_queues_(queues_.size()),
+        job_(nullptr),
+        generation_(0),
+        num_running_(0),
+        stop_(false) {
+    for (size_t i = 1; i < num_queues_; i++) {
+      threads_.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++) {
+      threads_[i].join();
+    }
+  }
+
+  size_t size() const { return num_queues_; }
+
+  // Calls `fn(task)` for each task in [0, num_tasks) and waits for all.
+  void ParallelFor(size_t num_tasks, const std::function<void(size_t)> &fn) {
+    for (size_t i = 0; i < num_queues_; i++) {
+      queues_[i].Set(uint32_t((num_tasks * i) / num_queues_),
+                     uint32_t((num_tasks * (i + 1)) / num_queues_));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &fn;
+      num_running_ = threads_.size();
+      generation_++;
+    }
+    cond_.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this]() { return num_running_ == 0; });
+    job_ = nullptr;
+  }
+
+ private:
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void RunTasks(size_t id) {
+    const std::function<void(size_t)> &fn = *job_;
+    size_t task;
+    while (queues_[id].PopFront(&task)) {
+      fn(task);
+    }
+
+    // Steal from other workers until all queues are empty.
+    for (size_t k = 1; k < num_queues_; k++) {
+      size_t victim = (id + k) % num_queues_;
+      while (queues_[victim].PopBack(&task)) {
+        fn(task);
+      }
+    }
+  }
+
+  void WorkerLoop(size_t id) {
+    uint64_t generation = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&]() { return stop_ || (generation_ != generation); });
+        if (stop_) return;
+        generation = generation_;
+      }
+
+      RunTasks(id);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        num_running_--;
+        if (num_running_ == 0) {
+          done_cond_.notify_one();
+        }
+      }
+    }
+  }
 
-// Raise # of max threads if you have more CPU cores...
-// In 2018, 32 cores are getting common in high-end workstaion PC.
-#define kMaxThreads (32)
+  std::vector<TaskRange> queues_;
+  size_t num_queues_;
+  std::vector<std::thread> threads_;
+
+  const std::function<void(size_t)> *job_;
+  uint64_t generation_;
+  size_t num_running_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::condition_variable done_cond_;
+};
+
+// Returns the first index in [i, end_i) which may be a line ending('\0', '\n'
+// or '\r'), or `end_i`. Use `is_line_ending` to check it.
+static inline size_t find_line_ending_candidate(const char *p, size_t i,
+                                                size_t end_i) {
+  return static_cast<size_t>(tinyobj::ScanBytes(p + i, p + end_i, '\n', '\r',
+                                                '\0', /* match */ true) -
+                             p);
+}
 
 static inline bool is_line_ending(const char *p, size_t i, size_t end_i) {
   if (p[i] == '\0') return true;
@@ -1267,25 +1504,25 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   if (len < 1) return false;
 
-  auto num_threads = (option.req_num_threads < 0)
-                         ? std::thread::hardware_concurrency()
-                         : option.req_num_threads;
-  num_threads =
-      (std::max)(1, (std::min)(static_cast<int>(num_threads), kMaxThreads));
+  size_t num_threads = (option.req_num_threads < 0)
+                           ? std::thread::hardware_concurrency()
+                           : size_t(option.req_num_threads);
+  num_threads = (std::max)(size_t(1), num_threads);
+
+  const size_t chunk_size = (std::max)(size_t(1), option.chunk_size);
+  const size_t num_chunks = (len + chunk_size - 1) / chunk_size;
 
   if (option.verbose) {
     std::cout << "# of threads = " << num_threads << std::endl;
+    std::cout << "# of chunks = " << num_chunks << std::endl;
   }
 
   auto t1 = std::chrono::high_resolution_clock::now();
 
-  std::vector<LineInfo, lfpAlloc::lfpAllocator<LineInfo> >
-      line_infos[kMaxThreads];
-  for (size_t t = 0; t < static_cast<size_t>(num_threads); t++) {
-    // Pre allocate enough memory. len / 128 / num_threads is just a heuristic
-    // value.
-    line_infos[t].reserve(len / 128 / num_threads);
-  }
+  ThreadPool pool(num_threads);
+
+  std::vector<std::vector<LineInfo, lfpAlloc::lfpAllocator<LineInfo> > >
+      line_infos(num_chunks);
 
   std::chrono::duration<double, std::milli> ms_linedetection;
   std::chrono::duration<double, std::milli> ms_alloc;
@@ -1296,69 +1533,73 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   // 1. Find '\n' and create line data.
   {
-    StackVector<std::thread, 16> workers;
-
     auto start_time = std::chrono::high_resolution_clock::now();
-    auto chunk_size = len / num_threads;
-
-    for (size_t t = 0; t < static_cast<size_t>(num_threads); t++) {
-      workers->push_back(std::thread([&, t]() {
-        auto start_idx = (t + 0) * chunk_size;
-        auto end_idx = (std::min)((t + 1) * chunk_size, len - 1);
-        if (t == static_cast<size_t>((num_threads - 1))) {
-          end_idx = len - 1;
+
+    pool.ParallelFor(num_chunks, [&](size_t t) {
+      auto start_idx = (t + 0) * chunk_size;
+      auto end_idx = (std::min)((t + 1) * chunk_size, len - 1);
+      if (t == (num_chunks - 1)) {
+        end_idx = len - 1;
+      }
+
+      // Pre allocate enough memory. 1 line per 128 bytes is just a
+      // heuristic value.
+      line_infos[t].reserve((end_idx - start_idx) / 128);
+
+      // true if the line currently read must be added to the current line
+      // info
+      bool new_line_found =
+          (t == 0) || is_line_ending(buf, start_idx - 1, end_idx);
+
+      size_t prev_pos = start_idx;
+      for (size_t i = start_idx; i < end_idx; i++) {
+        i = find_line_ending_candidate(buf, i, end_idx);
+        if (i >= end_idx) {
+          break;
         }
+        if (is_line_ending(buf, i, end_idx)) {
+          if (!new_line_found) {
+            // first linebreak found in (chunk > 0), and a line before this
+            // linebreak belongs to previous chunk, so skip it.
+            prev_pos = i + 1;
+            new_line_found = true;
+          } else {
+            LineInfo info;
+            info.pos = prev_pos;
+            info.len = i - prev_pos;
 
-        // true if the line currently read must be added to the current line
-        // info
-        bool new_line_found =
-            (t == 0) || is_line_ending(buf, start_idx - 1, end_idx);
-
-        size_t prev_pos = start_idx;
-        for (size_t i = start_idx; i < end_idx; i++) {
-          if (is_line_ending(buf, i, end_idx)) {
-            if (!new_line_found) {
-              // first linebreak found in (chunk > 0), and a line before this
-              // linebreak belongs to previous chunk, so skip it.
-              prev_pos = i + 1;
-              new_line_found = true;
-            } else {
-              LineInfo info;
-              info.pos = prev_pos;
-              info.len = i - prev_pos;
-
-              if (info.len > 0) {
-                line_infos[t].push_back(info);
-              }
-
-              prev_pos = i + 1;
+            if (info.len > 0) {
+              line_infos[t].push_back(info);
             }
+
+            prev_pos = i + 1;
           }
         }
+      }
 
-        // If at least one line started in this chunk, find where it ends in the
-        // rest of the buffer
-        if (new_line_found && (t < num_threads) && (buf[end_idx - 1] != '\n')) {
-          for (size_t i = end_idx; i < len; i++) {
-            if (is_line_ending(buf, i, len)) {
-              LineInfo info;
-              info.pos = prev_pos;
-              info.len = i - prev_pos;
-
-              if (info.len > 0) {
-                line_infos[t].push_back(info);
-              }
+      // If at least one line started in this chunk, find where it ends in the
+      // rest of the buffer
+      if (new_line_found && (end_idx > start_idx) &&
+          (buf[end_idx - 1] != '\n')) {
+        for (size_t i = end_idx; i < len; i++) {
+          i = find_line_ending_candidate(buf, i, len);
+          if (i >= len) {
+            break;
+          }
+          if (is_line_ending(buf, i, len)) {
+            LineInfo info;
+            info.pos = prev_pos;
+            info.len = i - prev_pos;
 
-              break;
+            if (info.len > 0) {
+              line_infos[t].push_back(info);
             }
+
+            break;
           }
         }
-      }));
-    }
-
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
-    }
+      }
+    });
 
     auto end_time = std::chrono::high_resolution_clock::now();
 
@@ -1366,68 +1607,47 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   }
 
   auto line_sum = 0;
-  for (size_t t = 0; t < num_threads; t++) {
+  for (size_t t = 0; t < num_chunks; t++) {
     // std::cout << t << ": # of lines = " << line_infos[t].size() << std::endl;
     line_sum += line_infos[t].size();
   }
   // std::cout << "# of lines = " << line_sum << std::endl;
 
-  std::vector<Command> commands[kMaxThreads];
-
   // 2. allocate buffer
   auto t_alloc_start = std::chrono::high_resolution_clock::now();
-  {
-    for (size_t t = 0; t < num_threads; t++) {
-      commands[t].reserve(line_infos[t].size());
-    }
-  }
+  std::vector<CommandBuffer> buffers(num_chunks);
 
-  CommandCount command_count[kMaxThreads];
-  // Array index to `mtllib` line. According to wavefront .obj spec, `mtllib'
-  // should appear only once in .obj.
-  int mtllib_t_index = -1;
-  int mtllib_i_index = -1;
+  // Array index to `mtllib` line in each chunk. According to wavefront .obj
+  // spec, `mtllib' should appear only once in .obj.
+  std::vector<int> mtllib_indices(num_chunks, -1);
+  // Array index to the last `usemtl` line(with a name) in each chunk.
+  std::vector<int> usemtl_indices(num_chunks, -1);
 
   ms_alloc = std::chrono::high_resolution_clock::now() - t_alloc_start;
 
   // 2. parse each line in parallel.
   {
-    StackVector<std::thread, 16> workers;
     auto t_start = std::chrono::high_resolution_clock::now();
 
-    for (size_t t = 0; t < num_threads; t++) {
-      workers->push_back(std::thread([&, t]() {
-        for (size_t i = 0; i < line_infos[t].size(); i++) {
-          Command command;
-          bool ret = parseLine(&command, &buf[line_infos[t][i].pos],
-                               line_infos[t][i].len, option.triangulate);
-          if (ret) {
-            if (command.type == COMMAND_V) {
-              command_count[t].num_v++;
-            } else if (command.type == COMMAND_VN) {
-              command_count[t].num_vn++;
-            } else if (command.type == COMMAND_VT) {
-              command_count[t].num_vt++;
-            } else if (command.type == COMMAND_F) {
-              command_count[t].num_f += command.f.size();
-              command_count[t].num_indices += command.f_num_verts.size();
-            }
-
-            if (command.type == COMMAND_MTLLIB) {
-              // Save the indices of the `mtllib` command in `commands` to easily find it later
-              mtllib_t_index = t;
-              mtllib_i_index = commands[t].size();
-            }
+    pool.ParallelFor(num_chunks, [&](size_t t) {
+      CommandBuffer &buffer = buffers[t];
+      for (size_t i = 0; i < line_infos[t].size(); i++) {
+        parseLine(&buffer, &buf[line_infos[t][i].pos], line_infos[t][i].len,
+                  option.triangulate);
+      }
 
-            commands[t].emplace_back(std::move(command));
-          }
+      // Save the indices of `mtllib` and `usemtl` in `commands` to easily
+      // find them later
+      for (size_t i = 0; i < buffer.commands.size(); i++) {
+        const Command &command = buffer.commands[i];
+        if (command.type == COMMAND_MTLLIB) {
+          mtllib_indices[t] = static_cast<int>(i);
+        } else if ((command.type == COMMAND_USEMTL) && command.name &&
+                   (command.name_len > 0)) {
+          usemtl_indices[t] = static_cast<int>(i);
         }
-      }));
-    }
-
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
-    }
+      }
+    });
 
     auto t_end = std::chrono::high_resolution_clock::now();
 
@@ -1436,13 +1656,23 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   std::map<std::string, int> material_map;
 
+  // Use the last `mtllib` line.
+  int mtllib_t_index = -1;
+  int mtllib_i_index = -1;
+  for (size_t t = 0; t < num_chunks; t++) {
+    if (mtllib_indices[t] >= 0) {
+      mtllib_t_index = static_cast<int>(t);
+      mtllib_i_index = mtllib_indices[t];
+    }
+  }
+
   // Load material(if exits)
   if (mtllib_i_index >= 0 && mtllib_t_index >= 0 &&
-      commands[mtllib_t_index][mtllib_i_index].mtllib_name &&
-      commands[mtllib_t_index][mtllib_i_index].mtllib_name_len > 0) {
+      buffers[mtllib_t_index].commands[mtllib_i_index].name &&
+      buffers[mtllib_t_index].commands[mtllib_i_index].name_len > 0) {
+    const Command &mtllib = buffers[mtllib_t_index].commands[mtllib_i_index];
     std::string material_filename =
-        std::string(commands[mtllib_t_index][mtllib_i_index].mtllib_name,
-                    commands[mtllib_t_index][mtllib_i_index].mtllib_name_len);
+        std::string(mtllib.name, mtllib.name_len);
     // std::cout << "mtllib :" << material_filename << std::endl;
 
     auto t1 = std::chrono::high_resolution_clock::now();
@@ -1464,10 +1694,10 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   }
 
   auto command_sum = 0;
-  for (size_t t = 0; t < num_threads; t++) {
-    // std::cout << t << ": # of commands = " << commands[t].size() <<
+  for (size_t t = 0; t < num_chunks; t++) {
+    // std::cout << t << ": # of commands = " << buffers[t].commands.size() <<
     // std::endl;
-    command_sum += commands[t].size();
+    command_sum += buffers[t].commands.size();
   }
   // std::cout << "# of commands = " << command_sum << std::endl;
 
@@ -1476,12 +1706,12 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   size_t num_vt = 0;
   size_t num_f = 0;
   size_t num_indices = 0;
-  for (size_t t = 0; t < num_threads; t++) {
-    num_v += command_count[t].num_v;
-    num_vn += command_count[t].num_vn;
-    num_vt += command_count[t].num_vt;
-    num_f += command_count[t].num_f;
-    num_indices += command_count[t].num_indices;
+  for (size_t t = 0; t < num_chunks; t++) {
+    num_v += buffers[t].vertices.size() / 3;
+    num_vn += buffers[t].normals.size() / 3;
+    num_vt += buffers[t].texcoords.size() / 2;
+    num_f += buffers[t].indices.size();
+    num_indices += buffers[t].face_num_verts.size();
   }
 
   // std::cout << "# v " << num_v << std::endl;
@@ -1489,8 +1719,41 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   // std::cout << "# vt " << num_vt << std::endl;
   // std::cout << "# f " << num_f << std::endl;
 
+  // Material ID of `usemtl` command. -2 for an unknown material, to prevent
+  // following faces from being assigned a valid material.
+  auto usemtl_material_id = [&material_map](const Command &command) -> int {
+    std::string material_name(command.name, command.name_len);
+    std::map<std::string, int>::const_iterator it =
+        material_map.find(material_name);
+    return (it != material_map.end()) ? it->second : -2;
+  };
+
+  // Material ID at the beginning of each chunk(= the last `usemtl` in the
+  // preceding chunks, -1 if none).
+  std::vector<int> chunk_material_ids(num_chunks);
+  {
+    int material_id = -1;
+    for (size_t t = 0; t < num_chunks; t++) {
+      chunk_material_ids[t] = material_id;
+      if (usemtl_indices[t] >= 0) {
+        material_id =
+            usemtl_material_id(buffers[t].commands[usemtl_indices[t]]);
+      }
+    }
+  }
+
+  // `o` or `g` command and its position in faces, collected for each chunk.
+  struct ShapeBoundary {
+    size_t face_offset;
+    const Command *command;
+  };
+  std::vector<std::vector<ShapeBoundary> > shape_boundaries(num_chunks);
+
   // 4. merge
-  // @todo { parallelize merge. }
+  // Each chunk is written to the final offsets(prefix sums of the counts of
+  // the preceding chunks) in parallel. Faces keep raw indices until here, so
+  // relative(negative) indices are resolved against the global counts: the
+  // offset of the chunk + the number of elements in the chunk so far.
   {
     auto t_start = std::chrono::high_resolution_clock::now();
 
@@ -1499,13 +1762,13 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     attrib->texcoords.resize(num_vt * 2);
     attrib->indices.resize(num_f);
     attrib->face_num_verts.resize(num_indices);
-    attrib->material_ids.resize(num_indices, -1);
+    attrib->material_ids.resize(num_indices);
 
-    size_t v_offsets[kMaxThreads];
-    size_t n_offsets[kMaxThreads];
-    size_t t_offsets[kMaxThreads];
-    size_t f_offsets[kMaxThreads];
-    size_t face_offsets[kMaxThreads];
+    std::vector<size_t> v_offsets(num_chunks);
+    std::vector<size_t> n_offsets(num_chunks);
+    std::vector<size_t> t_offsets(num_chunks);
+    std::vector<size_t> f_offsets(num_chunks);
+    std::vector<size_t> face_offsets(num_chunks);
 
     v_offsets[0] = 0;
     n_offsets[0] = 0;
@@ -1513,109 +1776,81 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     f_offsets[0] = 0;
     face_offsets[0] = 0;
 
-    for (size_t t = 1; t < num_threads; t++) {
-      v_offsets[t] = v_offsets[t - 1] + command_count[t - 1].num_v;
-      n_offsets[t] = n_offsets[t - 1] + command_count[t - 1].num_vn;
-      t_offsets[t] = t_offsets[t - 1] + command_count[t - 1].num_vt;
-      f_offsets[t] = f_offsets[t - 1] + command_count[t - 1].num_f;
-      face_offsets[t] = face_offsets[t - 1] + command_count[t - 1].num_indices;
-    }
-
-    StackVector<std::thread, 16> workers;
-
-    for (size_t t = 0; t < num_threads; t++) {
-      workers->push_back(std::thread([&, t]() {
-        size_t v_count = v_offsets[t];
-        size_t n_count = n_offsets[t];
-        size_t t_count = t_offsets[t];
-        size_t f_count = f_offsets[t];
-        size_t face_count = face_offsets[t];
-
-        for (size_t i = 0; i < commands[t].size(); i++) {
-          if (commands[t][i].type == COMMAND_EMPTY) {
-            continue;
-          } else if (commands[t][i].type == COMMAND_USEMTL) {
-            if (commands[t][i].material_name &&
-                commands[t][i].material_name_len > 0 &&
-                // check if there are still faces after this command
-                face_count < num_indices) {
-              // Find next face
-              bool found = false;
-              size_t i_start = i + 1, t_next, i_next;
-              for (t_next = t; t_next < num_threads; t_next++) {
-                for (i_next = i_start; i_next < commands[t_next].size();
-                     i_next++) {
-                  if (commands[t_next][i_next].type == COMMAND_F) {
-                    found = true;
-                    break;
-                  }
-                }
-                if (found) break;
-                i_start = 0;
-              }
-              // Assign material to this face
-              if (found) {
-                std::string material_name(commands[t][i].material_name,
-                                          commands[t][i].material_name_len);
-                for (size_t k = 0;
-                     k < commands[t_next][i_next].f_num_verts.size(); k++) {
-                  if (material_map.find(material_name) != material_map.end()) {
-                    attrib->material_ids[face_count + k] =
-                        material_map[material_name];
-                  } else {
-                    // Assign invalid material ID
-                    // Set a different value than the default, to
-                    // prevent following faces from being assigned a valid
-                    // material
-                    attrib->material_ids[face_count + k] = -2;
-                  }
-                }
-              }
-            }
-          } else if (commands[t][i].type == COMMAND_V) {
-            attrib->vertices[3 * v_count + 0] = commands[t][i].vx;
-            attrib->vertices[3 * v_count + 1] = commands[t][i].vy;
-            attrib->vertices[3 * v_count + 2] = commands[t][i].vz;
-            v_count++;
-          } else if (commands[t][i].type == COMMAND_VN) {
-            attrib->normals[3 * n_count + 0] = commands[t][i].nx;
-            attrib->normals[3 * n_count + 1] = commands[t][i].ny;
-            attrib->normals[3 * n_count + 2] = commands[t][i].nz;
-            n_count++;
-          } else if (commands[t][i].type == COMMAND_VT) {
-            attrib->texcoords[2 * t_count + 0] = commands[t][i].tx;
-            attrib->texcoords[2 * t_count + 1] = commands[t][i].ty;
-            t_count++;
-          } else if (commands[t][i].type == COMMAND_F) {
-            for (size_t k = 0; k < commands[t][i].f.size(); k++) {
-              index_t &vi = commands[t][i].f[k];
-              int vertex_index = fixIndex(vi.vertex_index, v_count);
-              int texcoord_index = fixIndex(vi.texcoord_index, t_count);
-              int normal_index = fixIndex(vi.normal_index, n_count);
-              attrib->indices[f_count + k] =
-                  index_t(vertex_index, texcoord_index, normal_index);
-            }
-            for (size_t k = 0; k < commands[t][i].f_num_verts.size(); k++) {
-              attrib->face_num_verts[face_count + k] =
-                  commands[t][i].f_num_verts[k];
-            }
-
-            f_count += commands[t][i].f.size();
-            face_count += commands[t][i].f_num_verts.size();
-          }
-        }
-      }));
+    for (size_t t = 1; t < num_chunks; t++) {
+      v_offsets[t] = v_offsets[t - 1] + buffers[t - 1].vertices.size() / 3;
+      n_offsets[t] = n_offsets[t - 1] + buffers[t - 1].normals.size() / 3;
+      t_offsets[t] = t_offsets[t - 1] + buffers[t - 1].texcoords.size() / 2;
+      f_offsets[t] = f_offsets[t - 1] + buffers[t - 1].indices.size();
+      face_offsets[t] =
+          face_offsets[t - 1] + buffers[t - 1].face_num_verts.size();
     }
 
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
-    }
+    pool.ParallelFor(num_chunks, [&](size_t t) {
+      const CommandBuffer &buffer = buffers[t];
 
-    // To each face with uninitialized material id,
-    // assign the material id of the last face preceding it that has one
-    for (size_t face_count = 1; face_count < num_indices; ++face_count)
-      if (attrib->material_ids[face_count] == -1)
-        attrib->material_ids[face_count] = attrib->material_ids[face_count - 1];
+      // Vertex attributes and face sizes of a chunk are contiguous in the
+      // output.
+      if (!buffer.vertices.empty()) {
+        memcpy(&attrib->vertices[3 * v_offsets[t]], buffer.vertices.data(),
+               buffer.vertices.size() * sizeof(float));
+      }
+      if (!buffer.normals.empty()) {
+        memcpy(&attrib->normals[3 * n_offsets[t]], buffer.normals.data(),
+               buffer.normals.size() * sizeof(float));
+      }
+      if (!buffer.texcoords.empty()) {
+        memcpy(&attrib->texcoords[2 * t_offsets[t]], buffer.texcoords.data(),
+               buffer.texcoords.size() * sizeof(float));
+      }
+      if (!buffer.face_num_verts.empty()) {
+        memcpy(&attrib->face_num_verts[face_offsets[t]],
+               buffer.face_num_verts.data(),
+               buffer.face_num_verts.size() * sizeof(int));
+      }
+
+      // Resolve indices with the number of elements defined before each face.
+      int v_count = static_cast<int>(v_offsets[t]);
+      int n_count = static_cast<int>(n_offsets[t]);
+      int t_count = static_cast<int>(t_offsets[t]);
+      size_t f_count = f_offsets[t];
+      size_t face_count = face_offsets[t];
+      const index_t *src = buffer.indices.data();
+      const int *num_verts = buffer.face_num_verts.data();
+      int material_id = chunk_material_ids[t];
+
+      for (size_t i = 0; i < buffer.commands.size(); i++) {
+        const Command &command = buffer.commands[i];
+        if (command.type == COMMAND_V) {
+          v_count += static_cast<int>(command.count);
+        } else if (command.type == COMMAND_VN) {
+          n_count += static_cast<int>(command.count);
+        } else if (command.type == COMMAND_VT) {
+          t_count += static_cast<int>(command.count);
+        } else if (command.type == COMMAND_USEMTL) {
+          if (command.name && command.name_len > 0) {
+            material_id = usemtl_material_id(command);
+          }
+        } else if ((command.type == COMMAND_O) ||
+                   (command.type == COMMAND_G)) {
+          ShapeBoundary boundary;
+          boundary.face_offset = face_count;
+          boundary.command = &command;
+          shape_boundaries[t].push_back(boundary);
+        } else if (command.type == COMMAND_F) {
+          for (unsigned int k = 0; k < command.count; k++) {
+            const int n = *num_verts++;
+            for (int j = 0; j < n; j++) {
+              const index_t &vi = *src++;
+              attrib->indices[f_count++] =
+                  index_t(fixIndex(vi.vertex_index, v_count),
+                          fixIndex(vi.texcoord_index, t_count),
+                          fixIndex(vi.normal_index, n_count));
+            }
+            attrib->material_ids[face_count++] = material_id;
+          }
+        }
+      }
+    });
 
     auto t_end = std::chrono::high_resolution_clock::now();
     ms_merge = t_end - t_start;
@@ -1624,72 +1859,35 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   auto t4 = std::chrono::high_resolution_clock::now();
 
   // 5. Construct shape information.
+  // A shape spans the faces from an `o` or `g` to the next one. Only the
+  // boundaries collected in the merge are visited, not all commands.
   {
     auto t_start = std::chrono::high_resolution_clock::now();
 
-    // @todo { Can we boost the performance by multi-threaded execution? }
-    int face_count = 0;
     shape_t shape;
     shape.face_offset = 0;
     shape.length = 0;
-    int face_prev_offset = 0;
-    for (size_t t = 0; t < num_threads; t++) {
-      for (size_t i = 0; i < commands[t].size(); i++) {
-        if (commands[t][i].type == COMMAND_O ||
-            commands[t][i].type == COMMAND_G) {
-          std::string name;
-          if (commands[t][i].type == COMMAND_O) {
-            name = std::string(commands[t][i].object_name,
-                               commands[t][i].object_name_len);
-          } else {
-            name = std::string(commands[t][i].group_name,
-                               commands[t][i].group_name_len);
-          }
-
-          if (face_count == 0) {
-            // 'o' or 'g' appears before any 'f'
-            shape.name = name;
-            shape.face_offset = face_count;
-            face_prev_offset = face_count;
-          } else {
-            if (shapes->size() == 0) {
-              // 'o' or 'g' after some 'v' lines.
-              // create a shape with null name
-              shape.length = face_count - face_prev_offset;
-              face_prev_offset = face_count;
-
-              shapes->push_back(shape);
-
-            } else {
-              if ((face_count - face_prev_offset) > 0) {
-                // push previous shape
-                shape.length = face_count - face_prev_offset;
-                shapes->push_back(shape);
-                face_prev_offset = face_count;
-              }
-            }
-
-            // redefine shape.
-            shape.name = name;
-            shape.face_offset = face_count;
-            shape.length = 0;
-          }
-        }
-        if (commands[t][i].type == COMMAND_F) {
-          // Consider generation of multiple faces per `f` line by triangulation
-          face_count += commands[t][i].f_num_verts.size();
+    for (size_t t = 0; t < num_chunks; t++) {
+      for (size_t i = 0; i < shape_boundaries[t].size(); i++) {
+        const ShapeBoundary &boundary = shape_boundaries[t][i];
+        const Command &command = *boundary.command;
+
+        // Faces before this `o` or `g`. Shapes without faces are discarded.
+        if (boundary.face_offset > shape.face_offset) {
+          shape.length =
+              static_cast<unsigned int>(boundary.face_offset - shape.face_offset);
+          shapes->push_back(shape);
         }
+
+        shape.name = std::string(command.name, command.name_len);
+        shape.face_offset = static_cast<unsigned int>(boundary.face_offset);
+        shape.length = 0;
       }
     }
 
-    if ((face_count - face_prev_offset) > 0) {
-      shape.length = face_count - shape.face_offset;
-      if (shape.length > 0) {
-        shapes->push_back(shape);
-      }
-    } else {
-      // Guess no 'v' line occurrence after 'o' or 'g', so discards current
-      // shape information.
+    if (num_indices > shape.face_offset) {
+      shape.length = static_cast<unsigned int>(num_indices - shape.face_offset);
+      shapes->push_back(shape);
     }
 
     auto t_end = std::chrono::high_resolution_clock::now();
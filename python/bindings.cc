@@ -21,7 +21,8 @@ PYBIND11_MODULE(tinyobjloader, tobj_module)
   // register struct
   py::class_<ObjReaderConfig>(tobj_module, "ObjReaderConfig")
     .def(py::init<>())
-    .def_readwrite("triangulate", &ObjReaderConfig::triangulate);
+    .def_readwrite("triangulate", &ObjReaderConfig::triangulate)
+    .def_readwrite("num_threads", &ObjReaderConfig::num_threads);
 
   // py::init<>() for default constructor
   py::class_<ObjReader>(tobj_module, "ObjReader")
@@ -1,6 +1,66 @@
+#ifdef TINYOBJLOADER_TEST_ALLOCATOR
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts allocations of the arrays of the loader. Build with
+// `make tester_allocator` to run all tests with this allocator.
+static size_t gTestAllocatorCount = 0;
+
+template <typename T>
+struct test_allocator {
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  template <typename U>
+  struct rebind {
+    typedef test_allocator<U> other;
+  };
+
+  test_allocator() {}
+  template <typename U>
+  test_allocator(const test_allocator<U>&) {}
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+  pointer allocate(size_type n, const void* = 0) {
+    gTestAllocatorCount++;
+    void* p = malloc(n * sizeof(T) + 1);
+    if (!p) throw std::bad_alloc();
+    return static_cast<pointer>(p);
+  }
+  void deallocate(pointer p, size_type) { free(p); }
+  size_type max_size() const { return size_type(-1) / sizeof(T); }
+  void construct(pointer p, const T& v) { new (p) T(v); }
+  void destroy(pointer p) { p->~T(); }
+};
+
+template <typename T, typename U>
+bool operator==(const test_allocator<T>&, const test_allocator<U>&) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const test_allocator<T>&, const test_allocator<U>&) {
+  return false;
+}
+
+#define TINYOBJLOADER_ALLOCATOR test_allocator
+#endif
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "../tiny_obj_loader.h"
 
+// `parseObj` of experimental/tinyobj_loader_opt.h(C++11) is compared with
+// `LoadObj`. Build with `make tester_cxx11`.
+#ifdef TINYOBJLOADER_TEST_OPT_LOADER
+#define TINYOBJ_LOADER_OPT_IMPLEMENTATION
+#include "../experimental/tinyobj_loader_opt.h"
+#endif
+
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Weverything"
@@ -23,13 +83,21 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 template <typename T>
 static bool FloatEquals(const T& a, const T& b) {
   // Edit eps value as you wish.
@@ -1163,6 +1231,17 @@ void test_colorspace_issue184() {
   TEST_CHECK(0 == materials[0].diffuse_texopt.colorspace.compare("sRGB"));
   TEST_CHECK(0 == materials[0].specular_texopt.colorspace.size());
   TEST_CHECK(0 == materials[0].bump_texopt.colorspace.compare("linear"));
+
+  // colorspace is not inherited from the previous material.
+  std::stringstream mtl_ss(
+      "newmtl a\nmap_Kd -colorspace sRGB a.png\nnewmtl b\nmap_Kd b.png\n");
+  std::map<std::string, int> material_map;
+  materials.clear();
+  tinyobj::LoadMtl(&material_map, &materials, &mtl_ss, &warn, &err);
+  TEST_CHECK(2 == materials.size());
+  TEST_CHECK(0 == materials[0].diffuse_texopt.colorspace.compare("sRGB"));
+  TEST_CHECK(0 == materials[1].diffuse_texopt.colorspace.size());
+  TEST_CHECK(0 == materials[1].diffuse_texname.compare("b.png"));
 }
 
 void test_leading_decimal_dots_issue201() {
@@ -1408,6 +1487,1844 @@ void test_face_missing_issue295() {
   TEST_CHECK((3 * 28) == shapes[0].mesh.indices.size()); // 28 triangle faces x 3
 }
 
+// Compare the whole parse result bit by bit. `a` and `b` may have different
+// allocators.
+template <typename RealArray0, typename RealArray1>
+static bool SameReals(const RealArray0& a, const RealArray1& b) {
+  if (a.size() != b.size()) return false;
+  if (a.empty()) return true;
+  return 0 == memcmp(&a.at(0), &b.at(0), sizeof(tinyobj::real_t) * a.size());
+}
+
+template <typename IndexArray0, typename IndexArray1>
+static bool SameIndices(const IndexArray0& a, const IndexArray1& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if ((a[i].vertex_index != b[i].vertex_index) ||
+        (a[i].normal_index != b[i].normal_index) ||
+        (a[i].texcoord_index != b[i].texcoord_index)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool SameLoadResult(const tinyobj::attrib_t& attrib0,
+                           const std::vector<tinyobj::shape_t>& shapes0,
+                           const std::vector<tinyobj::material_t>& materials0,
+                           const tinyobj::attrib_t& attrib1,
+                           const std::vector<tinyobj::shape_t>& shapes1,
+                           const std::vector<tinyobj::material_t>& materials1) {
+  if (!SameReals(attrib0.vertices, attrib1.vertices)) return false;
+  if (!SameReals(attrib0.vertex_weights, attrib1.vertex_weights)) return false;
+  if (!SameReals(attrib0.normals, attrib1.normals)) return false;
+  if (!SameReals(attrib0.texcoords, attrib1.texcoords)) return false;
+  if (!SameReals(attrib0.texcoord_ws, attrib1.texcoord_ws)) return false;
+  if (!SameReals(attrib0.colors, attrib1.colors)) return false;
+  if (attrib0.skin_weights.size() != attrib1.skin_weights.size()) return false;
+
+  if (shapes0.size() != shapes1.size()) return false;
+  for (size_t i = 0; i < shapes0.size(); i++) {
+    const tinyobj::shape_t& s0 = shapes0[i];
+    const tinyobj::shape_t& s1 = shapes1[i];
+    if (s0.name != s1.name) return false;
+    if (!SameIndices(s0.mesh.indices, s1.mesh.indices)) return false;
+    if (s0.mesh.num_face_vertices != s1.mesh.num_face_vertices) return false;
+    if (s0.mesh.material_ids != s1.mesh.material_ids) return false;
+    if (s0.mesh.smoothing_group_ids != s1.mesh.smoothing_group_ids)
+      return false;
+    if (s0.mesh.tags.size() != s1.mesh.tags.size()) return false;
+    if (!SameIndices(s0.lines.indices, s1.lines.indices)) return false;
+    if (s0.lines.num_line_vertices != s1.lines.num_line_vertices) return false;
+    if (!SameIndices(s0.points.indices, s1.points.indices)) return false;
+  }
+
+  if (materials0.size() != materials1.size()) return false;
+  for (size_t i = 0; i < materials0.size(); i++) {
+    if (materials0[i].name != materials1[i].name) return false;
+  }
+
+  return true;
+}
+
+static const char* gCompareModels[] = {
+    "../models/cornell_box.obj",
+    "../models/catmark_torus_creases0.obj",
+    "../models/cube-vertexcol.obj",
+    "../models/cube-vertex-w-component.obj",
+    "../models/issue-138.obj",
+    "../models/issue-162-smoothing-group.obj",
+    "../models/issue-235-usemtl-then-o.obj",
+    "../models/issue-295-trianguation-failure.obj",
+    "../models/line-prim.obj",
+    "../models/points-prim.obj",
+    "../models/skin-weight.obj",
+    "../models/smoothing-normal.obj",
+    "../models/usemtl-issue-104.obj",
+    "../models/invalid-relative-vertex-index.obj",
+    NULL};
+
+// Data passed to callback functions. Indices are resolved as `LoadObj`
+// does.
+struct CallbackResult {
+  std::vector<tinyobj::real_t> vertices;
+  std::vector<tinyobj::real_t> normals;
+  std::vector<tinyobj::real_t> texcoords;
+  std::vector<tinyobj::index_t> indices;
+  std::vector<unsigned int> num_face_vertices;
+  std::vector<tinyobj::index_t> line_indices;
+  std::vector<unsigned int> num_line_vertices;
+  std::vector<tinyobj::index_t> point_indices;
+};
+
+static int ResolveIndex(int idx, size_t n) {
+  if (idx > 0) return idx - 1;
+  if (idx < 0) return static_cast<int>(n) + idx;
+  return -1;
+}
+
+static void result_vertex_cb(void* user_data, tinyobj::real_t x,
+                             tinyobj::real_t y, tinyobj::real_t z,
+                             tinyobj::real_t w) {
+  (void)w;
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  result->vertices.push_back(x);
+  result->vertices.push_back(y);
+  result->vertices.push_back(z);
+}
+
+static void result_normal_cb(void* user_data, tinyobj::real_t x,
+                             tinyobj::real_t y, tinyobj::real_t z) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  result->normals.push_back(x);
+  result->normals.push_back(y);
+  result->normals.push_back(z);
+}
+
+static void result_texcoord_cb(void* user_data, tinyobj::real_t x,
+                               tinyobj::real_t y, tinyobj::real_t z) {
+  (void)z;
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  result->texcoords.push_back(x);
+  result->texcoords.push_back(y);
+}
+
+static void result_index_cb(void* user_data, tinyobj::index_t* indices,
+                            int num_indices) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  for (int i = 0; i < num_indices; i++) {
+    tinyobj::index_t idx;
+    idx.vertex_index =
+        ResolveIndex(indices[i].vertex_index, result->vertices.size() / 3);
+    idx.normal_index =
+        ResolveIndex(indices[i].normal_index, result->normals.size() / 3);
+    idx.texcoord_index =
+        ResolveIndex(indices[i].texcoord_index, result->texcoords.size() / 2);
+    result->indices.push_back(idx);
+  }
+  result->num_face_vertices.push_back(static_cast<unsigned int>(num_indices));
+}
+
+void test_callback_same_as_load_obj() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    const char* filename = gCompareModels[m];
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename,
+                          gMtlBasePath, /* triangulate */ false)) {
+      continue;
+    }
+
+    std::vector<tinyobj::index_t> indices;
+    std::vector<unsigned int> num_face_vertices;
+    for (size_t s = 0; s < shapes.size(); s++) {
+      indices.insert(indices.end(), shapes[s].mesh.indices.begin(),
+                     shapes[s].mesh.indices.end());
+      num_face_vertices.insert(num_face_vertices.end(),
+                               shapes[s].mesh.num_face_vertices.begin(),
+                               shapes[s].mesh.num_face_vertices.end());
+    }
+
+    tinyobj::callback_t callback;
+    callback.vertex_cb = result_vertex_cb;
+    callback.normal_cb = result_normal_cb;
+    callback.texcoord_cb = result_texcoord_cb;
+    callback.index_cb = result_index_cb;
+
+    CallbackResult result;
+    std::ifstream ifs(filename);
+    TEST_CHECK(tinyobj::LoadObjWithCallback(ifs, callback, &result));
+
+    TEST_CHECK(SameReals(attrib.vertices, result.vertices));
+    TEST_CHECK(SameReals(attrib.normals, result.normals));
+    TEST_CHECK(SameReals(attrib.texcoords, result.texcoords));
+    TEST_CHECK(SameIndices(indices, result.indices));
+    TEST_CHECK(num_face_vertices == result.num_face_vertices);
+    TEST_MSG("file: %s", filename);
+  }
+}
+
+static void vertex_w_cb(void* user_data, tinyobj::real_t x, tinyobj::real_t y,
+                        tinyobj::real_t z, tinyobj::real_t w) {
+  (void)x;
+  (void)y;
+  (void)z;
+  reinterpret_cast<std::vector<tinyobj::real_t>*>(user_data)->push_back(w);
+}
+
+static void vertex_color_nop_cb(void*, tinyobj::real_t, tinyobj::real_t,
+                                tinyobj::real_t, tinyobj::real_t,
+                                tinyobj::real_t, tinyobj::real_t, bool) {}
+
+void test_callback_vertex_w() {
+  // `vertex_cb` gets w(or red of `v` with a color), and the same value with
+  // or without `vertex_color_cb`.
+  std::string obj_text =
+      "v 1 2 3\n"
+      "v 1 2 3 0.5\n"
+      "v 1 2 3 0.25 0.6 0.7\n"
+      "v 1 2 3 0.5 abc\n"
+      "v 1 2 3 0.5 0.6 abc\n";
+  const tinyobj::real_t expected[] = {1.0f, 0.5f, 0.25f, 0.5f, 1.0f};
+
+  for (int with_color = 0; with_color < 2; with_color++) {
+    tinyobj::callback_t callback;
+    callback.vertex_cb = vertex_w_cb;
+    if (with_color) {
+      callback.vertex_color_cb = vertex_color_nop_cb;
+    }
+
+    std::vector<tinyobj::real_t> ws;
+    std::istringstream iss(obj_text);
+    TEST_CHECK(tinyobj::LoadObjWithCallback(iss, callback, &ws));
+    TEST_CHECK(5 == ws.size());
+    for (size_t i = 0; i < ws.size() && i < 5; i++) {
+      TEST_CHECK(expected[i] == ws[i]);
+      TEST_MSG("with_color: %d, v[%d]: %f", with_color, int(i), double(ws[i]));
+    }
+  }
+}
+
+static void batch_vertex_cb(void* user_data, const tinyobj::real_t* xyz,
+                            const tinyobj::real_t* w, size_t count) {
+  (void)w;
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  result->vertices.insert(result->vertices.end(), xyz, xyz + 3 * count);
+}
+
+static void batch_normal_cb(void* user_data, const tinyobj::real_t* xyz,
+                            size_t count) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  result->normals.insert(result->normals.end(), xyz, xyz + 3 * count);
+}
+
+static void batch_texcoord_cb(void* user_data, const tinyobj::real_t* uvw,
+                              size_t count) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  for (size_t i = 0; i < count; i++) {
+    result->texcoords.push_back(uvw[3 * i + 0]);
+    result->texcoords.push_back(uvw[3 * i + 1]);
+  }
+}
+
+static void AppendPrimitives(std::vector<tinyobj::index_t>* out_indices,
+                             std::vector<unsigned int>* out_num_vertices,
+                             const tinyobj::index_t* indices,
+                             const unsigned int* num_vertices, size_t count) {
+  size_t num_indices = 0;
+  for (size_t i = 0; i < count; i++) {
+    num_indices += num_vertices[i];
+  }
+  out_indices->insert(out_indices->end(), indices, indices + num_indices);
+  out_num_vertices->insert(out_num_vertices->end(), num_vertices,
+                           num_vertices + count);
+}
+
+static void batch_face_cb(void* user_data, const tinyobj::index_t* indices,
+                          const unsigned int* num_vertices, size_t count) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  AppendPrimitives(&result->indices, &result->num_face_vertices, indices,
+                   num_vertices, count);
+}
+
+static void batch_line_cb(void* user_data, const tinyobj::index_t* indices,
+                          const unsigned int* num_vertices, size_t count) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  AppendPrimitives(&result->line_indices, &result->num_line_vertices, indices,
+                   num_vertices, count);
+}
+
+static void batch_point_cb(void* user_data, const tinyobj::index_t* indices,
+                           const unsigned int* num_vertices, size_t count) {
+  CallbackResult* result = reinterpret_cast<CallbackResult*>(user_data);
+  std::vector<unsigned int> num_point_vertices;
+  AppendPrimitives(&result->point_indices, &num_point_vertices, indices,
+                   num_vertices, count);
+}
+
+void test_batch_callback_same_as_load_obj() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    const char* filename = gCompareModels[m];
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                                filename, gMtlBasePath,
+                                /* triangulate */ false);
+
+    CallbackResult expected;
+    for (size_t s = 0; s < shapes.size(); s++) {
+      const tinyobj::shape_t& shape = shapes[s];
+      expected.indices.insert(expected.indices.end(),
+                              shape.mesh.indices.begin(),
+                              shape.mesh.indices.end());
+      expected.num_face_vertices.insert(expected.num_face_vertices.end(),
+                                        shape.mesh.num_face_vertices.begin(),
+                                        shape.mesh.num_face_vertices.end());
+      expected.line_indices.insert(expected.line_indices.end(),
+                                   shape.lines.indices.begin(),
+                                   shape.lines.indices.end());
+      expected.num_line_vertices.insert(
+          expected.num_line_vertices.end(),
+          shape.lines.num_line_vertices.begin(),
+          shape.lines.num_line_vertices.end());
+      expected.point_indices.insert(expected.point_indices.end(),
+                                    shape.points.indices.begin(),
+                                    shape.points.indices.end());
+    }
+
+    tinyobj::batch_callback_t callback;
+    callback.vertex_cb = batch_vertex_cb;
+    callback.normal_cb = batch_normal_cb;
+    callback.texcoord_cb = batch_texcoord_cb;
+    callback.face_cb = batch_face_cb;
+    callback.line_cb = batch_line_cb;
+    callback.point_cb = batch_point_cb;
+    callback.batch_size = 3;  // split models into many batches
+
+    CallbackResult result;
+    std::ifstream ifs(filename);
+    TEST_CHECK(ret == tinyobj::LoadObjWithBatchCallback(ifs, callback,
+                                                        &result));
+    TEST_MSG("file: %s", filename);
+    if (!ret) {
+      continue;
+    }
+
+    TEST_CHECK(SameReals(attrib.vertices, result.vertices));
+    TEST_CHECK(SameReals(attrib.normals, result.normals));
+    TEST_CHECK(SameReals(attrib.texcoords, result.texcoords));
+    TEST_CHECK(SameIndices(expected.indices, result.indices));
+    TEST_CHECK(expected.num_face_vertices == result.num_face_vertices);
+    TEST_CHECK(SameIndices(expected.line_indices, result.line_indices));
+    TEST_CHECK(expected.num_line_vertices == result.num_line_vertices);
+    TEST_CHECK(SameIndices(expected.point_indices, result.point_indices));
+    TEST_MSG("file: %s", filename);
+  }
+}
+
+void test_parse_multithreaded() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    tinyobj::ObjReaderConfig config;
+    tinyobj::ObjReader serial_reader;
+    bool serial_ret = serial_reader.ParseFromFile(gCompareModels[m], config);
+
+    for (int num_threads = 2; num_threads <= 8; num_threads *= 2) {
+      config.num_threads = num_threads;
+      tinyobj::ObjReader reader;
+      bool ret = reader.ParseFromFile(gCompareModels[m], config);
+
+      TEST_CHECK(serial_ret == ret);
+      TEST_CHECK(serial_reader.Warning() == reader.Warning());
+      TEST_CHECK(serial_reader.Error() == reader.Error());
+      TEST_CHECK(SameLoadResult(
+          serial_reader.GetAttrib(), serial_reader.GetShapes(),
+          serial_reader.GetMaterials(), reader.GetAttrib(), reader.GetShapes(),
+          reader.GetMaterials()));
+      TEST_MSG("model: %s, threads: %d", gCompareModels[m], num_threads);
+    }
+  }
+
+  // Large groups of polygons are triangulated in parallel.
+  {
+    std::stringstream ss;
+    const int n = 128;
+    for (int y = 0; y <= n; y++) {
+      for (int x = 0; x <= n; x++) {
+        ss << "v " << x << " " << y << " " << ((x * y) % 7) * 0.1 << "\n";
+      }
+    }
+    for (int g = 0; g < 2; g++) {
+      ss << "g group" << g << "\n";
+      for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+          int i0 = y * (n + 1) + x + 1;
+          int i1 = i0 + 1;
+          int i2 = i0 + n + 2;
+          int i3 = i0 + n + 1;
+          if (((x + y) % 3) == 0) {
+            ss << "f " << i0 << " " << i1 << " " << i2 << " " << i3 << "\n";
+          } else if (((x + y) % 3) == 1) {
+            // concave pentagon
+            ss << "f " << i0 << " " << i1 << " " << i2 << " " << i3 << " "
+               << (i1 + n + 1) << "\n";
+          } else {
+            ss << "f " << i0 << " " << i2 << " " << i3 << "\n";
+          }
+        }
+      }
+    }
+    std::string obj_text = ss.str();
+
+    tinyobj::ObjReaderConfig config;
+    tinyobj::ObjReader serial_reader;
+    TEST_CHECK(serial_reader.ParseFromString(obj_text, "", config));
+
+    config.num_threads = 4;
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromString(obj_text, "", config));
+    TEST_CHECK(serial_reader.Warning() == reader.Warning());
+    TEST_CHECK(SameLoadResult(
+        serial_reader.GetAttrib(), serial_reader.GetShapes(),
+        serial_reader.GetMaterials(), reader.GetAttrib(), reader.GetShapes(),
+        reader.GetMaterials()));
+    TEST_CHECK(2 == reader.GetShapes().size());
+  }
+}
+
+// Chunks are parsed on threads and merged in line order. Relative indices,
+// faces which are parsed again and other lines across chunk boundaries must
+// give the same result as the serial parse.
+static std::string GenerateChunkTestObj(int n, bool invalid_index) {
+  std::stringstream ss;
+  int num_v = 0;
+  for (int i = 0; i < n; i++) {
+    if ((i % 97) == 0) {
+      ss << "# comment " << i << "\n";
+      ss << "o object" << i << "\n";
+      ss << "mtllib missing.mtl\n";
+    }
+    if ((i % 31) == 0) {
+      ss << "g group" << i << "\n";
+      ss << "usemtl mat" << (i % 3) << "\n";
+      ss << "s " << (i % 2) << "\n";
+    }
+    if ((i % 5) == 0) {
+      ss << "v " << i << " 1 2 0.5\r\n";  // w
+    } else if ((i % 5) == 1) {
+      ss << "v " << i << " 1 2 0.1 0.2 0.3\n";  // color
+    } else {
+      ss << "v " << i << " " << (i * 0.25) << " -" << i << "\n";
+    }
+    num_v++;
+    ss << "vt " << (i * 0.01) << " 0.5\n";
+    ss << "vn 0 0 1\n";
+
+    if (num_v >= 3) {
+      if ((i % 4) == 0) {
+        ss << "f -3/-3/-3 -2/-2/-2 -1/-1/-1\n";
+      } else if ((i % 4) == 1) {
+        ss << "f " << (num_v - 2) << "/" << (num_v - 2) << " " << (num_v - 1)
+           << "/" << (num_v - 1) << " " << num_v << "/" << num_v << "\n";
+      } else if ((i % 4) == 2) {
+        // Mixed formats are parsed again by `ObjLineParser`.
+        ss << "f " << (num_v - 2) << "/" << (num_v - 2) << " -2 " << num_v
+           << "//" << num_v << "\n";
+      } else {
+        ss << "f 1 2 3\n";  // short line
+      }
+    }
+    if ((i % 13) == 0) {
+      ss << "l 1 2\n";
+      ss << "p -1\n";
+    }
+    if (invalid_index && (i == (n / 2))) {
+      ss << "f -1 -2 -" << (num_v + 1) << "\n";
+    }
+  }
+  return ss.str();
+}
+
+void test_parse_multithreaded_chunks() {
+  for (int c = 0; c < 4; c++) {
+    const std::string obj_text = GenerateChunkTestObj(2000, c == 3);
+
+    tinyobj::ObjReaderConfig config;
+    if (c == 1) {
+      config.vertex_color = false;
+      config.attribute_mask = 0;
+    } else if (c == 2) {
+      config.attribute_mask = tinyobj::ATTRIBUTE_TEXCOORD;
+    }
+
+    tinyobj::ObjReader serial_reader;
+    bool serial_ret = serial_reader.ParseFromString(obj_text, "", config);
+    TEST_CHECK(serial_ret == (c != 3));
+
+    for (int num_threads = 2; num_threads <= 8; num_threads++) {
+      config.num_threads = num_threads;
+      tinyobj::ObjReader reader;
+      bool ret = reader.ParseFromString(obj_text, "", config);
+
+      TEST_CHECK(serial_ret == ret);
+      TEST_CHECK(serial_reader.Warning() == reader.Warning());
+      TEST_CHECK(serial_reader.Error() == reader.Error());
+      if (serial_ret) {
+        TEST_CHECK(SameLoadResult(
+            serial_reader.GetAttrib(), serial_reader.GetShapes(),
+            serial_reader.GetMaterials(), reader.GetAttrib(),
+            reader.GetShapes(), reader.GetMaterials()));
+      }
+      TEST_MSG("case: %d, threads: %d", c, num_threads);
+    }
+  }
+}
+
+void test_parse_from_memory() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                                gCompareModels[m], gMtlBasePath);
+
+    for (int use_mmap = 0; use_mmap < 2; use_mmap++) {
+      tinyobj::ObjReaderConfig config;
+      config.use_mmap = (use_mmap == 1);
+      tinyobj::ObjReader reader;
+      TEST_CHECK(ret == reader.ParseFromFile(gCompareModels[m], config));
+      TEST_CHECK(warn == reader.Warning());
+      TEST_CHECK(SameLoadResult(attrib, shapes, materials, reader.GetAttrib(),
+                                reader.GetShapes(), reader.GetMaterials()));
+      TEST_MSG("model: %s, use_mmap: %d", gCompareModels[m], use_mmap);
+    }
+  }
+
+  // Line endings, no line ending at the end of buffer.
+  const char* texts[] = {
+      "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n",
+      "v 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\nf 1 2 3\r\n",
+      "v 0 0 0\rv 1 0 0\rv 0 1 0\rf 1 2 3\r",
+      "v 0 0 0\nv 1 0 0\r\nv 0 1 0\rf 1 2 3", NULL};
+
+  for (size_t i = 0; texts[i]; i++) {
+    std::string obj_text(texts[i]);
+
+    tinyobj::ObjReader str_reader;
+    TEST_CHECK(str_reader.ParseFromString(obj_text, ""));
+
+    // Not terminated by '\0'
+    std::vector<char> buf(obj_text.begin(), obj_text.end());
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromMemory(&buf.at(0), buf.size(), NULL, 0));
+    TEST_CHECK(9 == reader.GetAttrib().vertices.size());
+    TEST_CHECK(1 == reader.GetShapes().size());
+    TEST_CHECK(3 == reader.GetShapes()[0].mesh.indices.size());
+    TEST_CHECK(SameLoadResult(
+        str_reader.GetAttrib(), str_reader.GetShapes(),
+        str_reader.GetMaterials(), reader.GetAttrib(), reader.GetShapes(),
+        reader.GetMaterials()));
+  }
+
+  {
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromMemory(NULL, 0, NULL, 0));
+    TEST_CHECK(reader.GetShapes().empty());
+  }
+
+  // Long lines and leading spaces(longer than SIMD blocks).
+  const char* line_endings[] = {"\n", "\r\n", "\r", NULL};
+  for (size_t i = 0; line_endings[i]; i++) {
+    std::string nl(line_endings[i]);
+    std::string spaces(" \t                                \t    ");
+    std::string obj_text = "# " + std::string(100, 'x') + nl;
+    obj_text += spaces + "v 0 0 0" + nl;
+    obj_text += "v 1.00000000000000000000000000000000000 0 0" + nl + nl;
+    obj_text += spaces + spaces + "v 0 1 0" + spaces + nl;
+    obj_text += "f 1 2 3" + spaces + spaces;
+
+    std::stringstream obj_ss(obj_text);
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    TEST_CHECK(tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                                &obj_ss));
+
+    tinyobj::ObjReader reader;
+    TEST_CHECK(
+        reader.ParseFromMemory(obj_text.data(), obj_text.size(), NULL, 0));
+    TEST_CHECK(9 == reader.GetAttrib().vertices.size());
+    TEST_CHECK(1 == reader.GetShapes().size());
+    TEST_CHECK(SameLoadResult(attrib, shapes, materials, reader.GetAttrib(),
+                              reader.GetShapes(), reader.GetMaterials()));
+    TEST_MSG("line ending: %d", int(i));
+  }
+}
+
+// `ParseFromMemory` parses `v`, `vn`, `vt` and `f` lines in place in the
+// buffer. Each line is placed at the end of a buffer which is not terminated
+// by '\0', and the result is compared with `LoadObj`('\0' terminated lines).
+// `ParseFromFile` reads a pipe(whose size is unknown) until EOF, and fails for
+// a directory.
+void test_parse_from_file_non_seekable() {
+  for (int use_mmap = 0; use_mmap < 2; use_mmap++) {
+    tinyobj::ObjReaderConfig config;
+    config.use_mmap = (use_mmap == 1);
+
+    tinyobj::ObjReader reader;
+    TEST_CHECK(false == reader.ParseFromFile("../models", config));
+    TEST_CHECK(!reader.Error().empty());
+    TEST_MSG("use_mmap: %d", use_mmap);
+  }
+
+#ifndef _WIN32
+  // Larger than the pipe buffer and the read size of `FileData`.
+  std::stringstream ss;
+  const int n = 20000;
+  for (int i = 0; i < n; i++) {
+    ss << "v " << i << " 1.5 -2.25\n";
+  }
+  ss << "f 1 2 3\n";
+  const std::string obj_text = ss.str();
+
+  tinyobj::ObjReader str_reader;
+  TEST_CHECK(str_reader.ParseFromString(obj_text, ""));
+
+  for (int use_mmap = 0; use_mmap < 2; use_mmap++) {
+    int fds[2];
+    if (!TEST_CHECK(pipe(fds) == 0)) {
+      return;
+    }
+
+    pid_t pid = fork();
+    if (!TEST_CHECK(pid >= 0)) {
+      close(fds[0]);
+      close(fds[1]);
+      return;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      const char* p = obj_text.data();
+      size_t len = obj_text.size();
+      while (len > 0) {
+        ssize_t written = write(fds[1], p, len);
+        if (written <= 0) _exit(1);
+        p += written;
+        len -= size_t(written);
+      }
+      close(fds[1]);
+      _exit(0);
+    }
+    close(fds[1]);
+
+    std::stringstream filename;
+    filename << "/dev/fd/" << fds[0];
+
+    tinyobj::ObjReaderConfig config;
+    config.use_mmap = (use_mmap == 1);
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile(filename.str(), config));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    TEST_CHECK(size_t(3 * n) == reader.GetAttrib().vertices.size());
+    TEST_CHECK(SameLoadResult(
+        str_reader.GetAttrib(), str_reader.GetShapes(),
+        str_reader.GetMaterials(), reader.GetAttrib(), reader.GetShapes(),
+        reader.GetMaterials()));
+    TEST_MSG("use_mmap: %d", use_mmap);
+  }
+#endif
+}
+
+void test_parse_lines_in_place() {
+  const char* header =
+      "v 0 0 0\nv 1 0 0\nv 0 1 0 0.5\nv 1 1 0 0.1 0.2 0.3\n"
+      "vt 0 0\nvt 1 0\nvt 0 1\nvn 0 0 1\nvn 0 1 0\n";
+  const char* lines[] = {"v 1 2 3",
+                         "v 1 2 3 0.5",
+                         "v 1 2 3 0.5 0.6 0.7",
+                         "v 1 2 3 0.5 abc",
+                         "v 1e3 -2.5E-2 +3.",
+                         "v 1",
+                         "v",
+                         "vn 0.5 0.25 0.125",
+                         "vn 1 ",
+                         "vt 0.5 0.25",
+                         "vt 0.5",
+                         "f 1 2 3",
+                         "f 1 2 3 4",
+                         "f 1/1 2/2 3/3",
+                         "f 1//1 2//2 3//2",
+                         "f 1/1/1 2/2/1 3/3/2",
+                         "f -1 -2 -3",
+                         "f -1/-1/-1 -2/-2/-1 -3/-3/-2",
+                         "f 1/1 2 3/3",
+                         "f 1 2/2 3",
+                         "f 1//1 2/2/2 3//2 ",
+                         "f 1 2 123456789",
+                         "f 1 2 3\t\t",
+                         "f  1  2  3",
+                         "f 1 2",
+                         "f 1 2 0",
+                         "l 1 2",
+                         "p 1",
+                         "g group",
+                         "o object",
+                         "usemtl",
+                         "s 1",
+                         "f",
+                         "v",
+                         "#",
+                         "   ",
+                         "x 1 2 3",
+                         NULL};
+
+  for (size_t i = 0; lines[i]; i++) {
+    std::string obj_text = std::string(header) + lines[i] + "\n" + lines[i];
+
+    std::stringstream obj_ss(obj_text);
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                                &obj_ss, NULL, false);
+
+    // Not terminated by '\0'
+    std::vector<char> buf(obj_text.begin(), obj_text.end());
+    tinyobj::ObjReaderConfig config;
+    config.triangulate = false;
+    config.num_threads = 1;
+    tinyobj::ObjReader reader;
+    TEST_CHECK(ret == reader.ParseFromMemory(&buf.at(0), buf.size(), NULL, 0,
+                                             config));
+    TEST_CHECK(warn == reader.Warning());
+    TEST_CHECK(err == reader.Error());
+    TEST_CHECK(SameLoadResult(attrib, shapes, materials, reader.GetAttrib(),
+                              reader.GetShapes(), reader.GetMaterials()));
+    TEST_MSG("line: `%s`", lines[i]);
+  }
+}
+
+void test_parse_with_prescan() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    tinyobj::ObjReaderConfig config;
+    tinyobj::ObjReader reader;
+    bool ret = reader.ParseFromFile(gCompareModels[m], config);
+
+    config.prescan = true;
+    tinyobj::ObjReader prescan_reader;
+    TEST_CHECK(ret == prescan_reader.ParseFromFile(gCompareModels[m], config));
+    TEST_CHECK(reader.Warning() == prescan_reader.Warning());
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(),
+                              prescan_reader.GetAttrib(),
+                              prescan_reader.GetShapes(),
+                              prescan_reader.GetMaterials()));
+    TEST_MSG("model: %s", gCompareModels[m]);
+
+    // Arrays are reserved with the exact size.
+    const tinyobj::attrib_t& attrib = prescan_reader.GetAttrib();
+    TEST_CHECK(attrib.vertices.capacity() == attrib.vertices.size());
+    TEST_CHECK(attrib.normals.capacity() == attrib.normals.size());
+    TEST_CHECK(attrib.texcoords.capacity() == attrib.texcoords.size());
+  }
+}
+
+void test_stream_reader() {
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    tinyobj::ObjReader reader;
+    bool ret = reader.ParseFromFile(gCompareModels[m]);
+
+    tinyobj::ObjStreamReader stream_reader;
+    TEST_CHECK(stream_reader.Open(gCompareModels[m]));
+
+    std::vector<tinyobj::shape_t> shapes;
+    tinyobj::shape_t shape;
+    while (stream_reader.ReadShape(&shape)) {
+      shapes.push_back(shape);
+    }
+    TEST_CHECK(stream_reader.Finished());
+    TEST_CHECK(ret == stream_reader.Valid());
+    TEST_CHECK(reader.Warning() == stream_reader.Warning());
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), stream_reader.GetAttrib(),
+                              shapes, stream_reader.GetMaterials()));
+    TEST_MSG("model: %s", gCompareModels[m]);
+  }
+
+  // A shape is returned before the rest of .obj is parsed.
+  std::string obj_text =
+      "o a\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"
+      "o b\nv 0 0 1\nf 1 2 4\n";
+  std::stringstream obj_ss(obj_text);
+
+  tinyobj::ObjStreamReader stream_reader;
+  TEST_CHECK(stream_reader.Open(&obj_ss));
+
+  tinyobj::shape_t shape;
+  TEST_CHECK(stream_reader.ReadShape(&shape));
+  TEST_CHECK(shape.name == "a");
+  TEST_CHECK(3 == shape.mesh.indices.size());
+  TEST_CHECK(9 == stream_reader.GetVertices().size());
+  TEST_CHECK(!stream_reader.Finished());
+
+  TEST_CHECK(stream_reader.ReadShape(&shape));
+  TEST_CHECK(shape.name == "b");
+  TEST_CHECK(3 == shape.mesh.indices.size());
+
+  TEST_CHECK(!stream_reader.ReadShape(&shape));
+  TEST_CHECK(stream_reader.Valid());
+  TEST_CHECK(12 == stream_reader.GetAttrib().vertices.size());
+}
+
+// Feeds `text` to `parser` in chunks of `chunk_size` bytes.
+static bool FeedInChunks(tinyobj::ObjIncrementalParser* parser,
+                         const std::string& text, size_t chunk_size) {
+  for (size_t i = 0; i < text.size(); i += chunk_size) {
+    size_t len = std::min(chunk_size, text.size() - i);
+    if (!parser->Feed(text.data() + i, len)) {
+      return false;
+    }
+  }
+  return parser->Finish();
+}
+
+void test_incremental_parser() {
+  const size_t chunk_sizes[] = {1, 7, 4096};
+
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    tinyobj::ObjReader reader;
+    bool ret = reader.ParseFromFile(gCompareModels[m]);
+
+    std::string obj_text;
+    {
+      std::ifstream ifs(gCompareModels[m], std::ios::binary);
+      std::stringstream ss;
+      ss << ifs.rdbuf();
+      obj_text = ss.str();
+    }
+
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+      tinyobj::MaterialFileReader mtl_reader(gMtlBasePath);
+      tinyobj::ObjIncrementalParser parser;
+      TEST_CHECK(parser.Start(&mtl_reader));
+
+      TEST_CHECK(ret == FeedInChunks(&parser, obj_text, chunk_sizes[c]));
+      TEST_CHECK(ret == parser.Valid());
+      TEST_CHECK(reader.Warning() == parser.Warning());
+      TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                                reader.GetMaterials(), parser.GetAttrib(),
+                                parser.GetShapes(), parser.GetMaterials()));
+      TEST_MSG("model: %s, chunk size: %d", gCompareModels[m],
+               int(chunk_sizes[c]));
+    }
+  }
+
+  // Line endings split across chunks, and the last line without line ending.
+  std::string obj_text =
+      "v 0 0 0\r\nv 1 0 0\rv 0 1 0\n\r\nf 1 2 3\r\n"
+      "o b\r\nv 0 0 1\r\nf 1 2 4";
+  tinyobj::ObjReader reader;
+  TEST_CHECK(reader.ParseFromString(obj_text, ""));
+  for (size_t chunk_size = 1; chunk_size < obj_text.size(); chunk_size++) {
+    tinyobj::ObjIncrementalParser parser;
+    TEST_CHECK(parser.Start());
+    TEST_CHECK(FeedInChunks(&parser, obj_text, chunk_size));
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), parser.GetAttrib(),
+                              parser.GetShapes(), parser.GetMaterials()));
+    TEST_MSG("chunk size: %d", int(chunk_size));
+  }
+  TEST_CHECK(2 == reader.GetShapes().size());
+  TEST_CHECK(12 == reader.GetAttrib().vertices.size());
+}
+
+static std::string ReadBinaryFile(const char* filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+// `filename` is cube.obj compressed(with the .mtl also compressed), and is
+// loaded only when `supported`. `format` is in the error messages.
+static void CheckCompressedCube(const char* filename, bool supported,
+                                const char* format, const char* define) {
+  tinyobj::ObjReader reader;
+  TEST_CHECK(reader.ParseFromFile("../models/cube.obj"));
+
+  tinyobj::ObjReader compressed_reader;
+  bool ret = compressed_reader.ParseFromFile(filename);
+  if (!supported) {
+    TEST_CHECK(!ret);
+    TEST_CHECK(compressed_reader.Error().find(define) != std::string::npos);
+    TEST_MSG("%s", compressed_reader.Error().c_str());
+    return;
+  }
+
+  TEST_CHECK(ret);
+  TEST_MSG("%s", compressed_reader.Error().c_str());
+  TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                            reader.GetMaterials(),
+                            compressed_reader.GetAttrib(),
+                            compressed_reader.GetShapes(),
+                            compressed_reader.GetMaterials()));
+  TEST_CHECK(!compressed_reader.GetMaterials().empty());
+
+  {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    TEST_CHECK(tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                                filename, gMtlBasePath));
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), attrib, shapes,
+                              materials));
+  }
+
+  {
+    tinyobj::ObjStreamReader stream_reader;
+    TEST_CHECK(stream_reader.Open(filename));
+    std::vector<tinyobj::shape_t> shapes;
+    tinyobj::shape_t shape;
+    while (stream_reader.ReadShape(&shape)) {
+      shapes.push_back(shape);
+    }
+    TEST_CHECK(stream_reader.Valid());
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), stream_reader.GetAttrib(),
+                              shapes, stream_reader.GetMaterials()));
+  }
+
+  // Truncated data.
+  std::string compressed_text = ReadBinaryFile(filename);
+  tinyobj::ObjReader truncated_reader;
+  TEST_CHECK(!truncated_reader.ParseFromString(
+      compressed_text.substr(0, compressed_text.size() / 2), ""));
+  TEST_CHECK(truncated_reader.Error().find(format) != std::string::npos);
+  TEST_MSG("%s", truncated_reader.Error().c_str());
+}
+
+void test_gzip_compressed_obj() {
+  // cube-gzip.obj.gz = cube.obj with `mtllib cube-gzip.mtl.gz`.
+#ifdef TINYOBJLOADER_USE_ZLIB
+  CheckCompressedCube("../models/cube-gzip.obj.gz", true, "gzip",
+                      "TINYOBJLOADER_USE_ZLIB");
+#else
+  CheckCompressedCube("../models/cube-gzip.obj.gz", false, "gzip",
+                      "TINYOBJLOADER_USE_ZLIB");
+#endif
+}
+
+void test_zstd_compressed_obj() {
+  // cube-zstd.obj.zst = cube.obj with `mtllib cube-zstd.mtl.zst`.
+#ifdef TINYOBJLOADER_USE_ZSTD
+  CheckCompressedCube("../models/cube-zstd.obj.zst", true, "zstd",
+                      "TINYOBJLOADER_USE_ZSTD");
+
+  // Concatenated frames are decompressed as one .obj.
+  std::string obj_text = ReadBinaryFile("../models/cube.obj");
+  size_t half = obj_text.find('\n', obj_text.size() / 2) + 1;
+  std::string zst_text;
+  for (int i = 0; i < 2; i++) {
+    std::string part = (i == 0) ? obj_text.substr(0, half)
+                                : obj_text.substr(half);
+    std::vector<char> frame(ZSTD_compressBound(part.size()));
+    size_t n = ZSTD_compress(&frame.at(0), frame.size(), part.data(),
+                             part.size(), 1);
+    TEST_CHECK(!ZSTD_isError(n));
+    zst_text.append(&frame.at(0), n);
+  }
+  tinyobj::ObjReader reader;
+  TEST_CHECK(reader.ParseFromString(obj_text, ""));
+  tinyobj::ObjReader frames_reader;
+  TEST_CHECK(frames_reader.ParseFromString(zst_text, ""));
+  TEST_MSG("%s", frames_reader.Error().c_str());
+  TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                            reader.GetMaterials(), frames_reader.GetAttrib(),
+                            frames_reader.GetShapes(),
+                            frames_reader.GetMaterials()));
+#else
+  CheckCompressedCube("../models/cube-zstd.obj.zst", false, "zstd",
+                      "TINYOBJLOADER_USE_ZSTD");
+#endif
+}
+
+#ifdef TINYOBJLOADER_TEST_OPT_LOADER
+// Vertex attributes interleaved with faces whose indices are absolute,
+// relative or not specified(`f 1 2 3` has no texcoord and normal index).
+static std::string GenerateMixedIndexObj() {
+  std::stringstream ss;
+  srand(3);
+  int nv = 0;
+  int nn = 0;
+  for (int i = 0; i < 3000; i++) {
+    ss << "v " << i << " " << (i % 7) << " 0\nvt 0." << i << " 0.5\n";
+    nv++;
+    if ((i % 3) == 0) {
+      ss << "vn 0 0 1\n";
+      nn++;
+    }
+    if ((i % 500) == 0) {
+      ss << "g group_" << i << "\n";
+    }
+    if ((nv < 4) || (nn < 1)) {
+      continue;
+    }
+    int num_verts = 3 + (rand() % 3);
+    int form = rand() % 4;
+    ss << "f";
+    for (int k = 0; k < num_verts; k++) {
+      int v = -(1 + (rand() % 4));
+      int vt = -(1 + (rand() % 4));
+      int vn = (rand() % 2) ? -1 : nn;
+      if (rand() % 2) v = nv + v + 1;  // absolute
+      if (form == 0) {
+        ss << " " << v;
+      } else if (form == 1) {
+        ss << " " << v << "/" << vt;
+      } else if (form == 2) {
+        ss << " " << v << "//" << vn;
+      } else {
+        ss << " " << v << "/" << vt << "/" << vn;
+      }
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+void test_opt_loader_same_as_load_obj() {
+  std::string obj_text = GenerateMixedIndexObj();
+
+  tinyobj::ObjReaderConfig config;
+  config.triangulate = false;
+  tinyobj::ObjReader reader;
+  TEST_CHECK(reader.ParseFromString(obj_text, "", config));
+  const tinyobj::attrib_t& attrib = reader.GetAttrib();
+  const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
+
+  std::vector<tinyobj::index_t> indices;
+  std::vector<int> num_face_vertices;
+  for (size_t s = 0; s < shapes.size(); s++) {
+    indices.insert(indices.end(), shapes[s].mesh.indices.begin(),
+                   shapes[s].mesh.indices.end());
+    num_face_vertices.insert(num_face_vertices.end(),
+                             shapes[s].mesh.num_face_vertices.begin(),
+                             shapes[s].mesh.num_face_vertices.end());
+  }
+
+  // `parseObj` expects a '\0' terminated buffer.
+  std::vector<char> buf(obj_text.begin(), obj_text.end());
+  buf.push_back('\0');
+
+  // Small chunks put chunk boundaries in the middle of lines and of runs of
+  // relative indices, and give the threads many chunks to steal.
+  const size_t kChunkSizes[] = {1, 7, 64 * 1024};
+  const int kNumThreads[] = {1, 2, 4};
+  for (size_t c = 0; c < 3; c++) {
+    for (size_t t = 0; t < 3; t++) {
+      tinyobj_opt::LoadOption option;
+      option.req_num_threads = kNumThreads[t];
+      option.chunk_size = kChunkSizes[c];
+      option.triangulate = false;
+      option.verbose = false;
+
+      tinyobj_opt::attrib_t opt_attrib;
+      std::vector<tinyobj_opt::shape_t> opt_shapes;
+      std::vector<tinyobj_opt::material_t> opt_materials;
+      TEST_CHECK(tinyobj_opt::parseObj(&opt_attrib, &opt_shapes,
+                                       &opt_materials, &buf.at(0), buf.size(),
+                                       option));
+
+      TEST_CHECK(std::equal(attrib.vertices.begin(), attrib.vertices.end(),
+                            opt_attrib.vertices.begin()) &&
+                 (attrib.vertices.size() == opt_attrib.vertices.size()));
+      TEST_CHECK(std::equal(attrib.normals.begin(), attrib.normals.end(),
+                            opt_attrib.normals.begin()) &&
+                 (attrib.normals.size() == opt_attrib.normals.size()));
+      TEST_CHECK(std::equal(attrib.texcoords.begin(), attrib.texcoords.end(),
+                            opt_attrib.texcoords.begin()) &&
+                 (attrib.texcoords.size() == opt_attrib.texcoords.size()));
+
+      bool same_indices = (indices.size() == opt_attrib.indices.size());
+      for (size_t i = 0; same_indices && (i < indices.size()); i++) {
+        same_indices =
+            (indices[i].vertex_index == opt_attrib.indices[i].vertex_index) &&
+            (indices[i].texcoord_index ==
+             opt_attrib.indices[i].texcoord_index) &&
+            (indices[i].normal_index == opt_attrib.indices[i].normal_index);
+      }
+      TEST_CHECK(same_indices);
+      TEST_CHECK(std::equal(num_face_vertices.begin(), num_face_vertices.end(),
+                            opt_attrib.face_num_verts.begin()) &&
+                 (num_face_vertices.size() ==
+                  opt_attrib.face_num_verts.size()));
+
+      // Faces of each group.
+      bool same_shapes = (shapes.size() == opt_shapes.size());
+      for (size_t s = 0; same_shapes && (s < shapes.size()); s++) {
+        same_shapes =
+            (shapes[s].name == opt_shapes[s].name) &&
+            (shapes[s].mesh.num_face_vertices.size() == opt_shapes[s].length);
+      }
+      TEST_CHECK(same_shapes);
+      TEST_MSG("chunk_size: %d, threads: %d", int(kChunkSizes[c]),
+               kNumThreads[t]);
+    }
+  }
+}
+#endif
+
+void test_custom_allocator() {
+  tinyobj::ObjReader reader;
+#ifdef TINYOBJLOADER_TEST_ALLOCATOR
+  gTestAllocatorCount = 0;
+  TEST_CHECK(reader.ParseFromFile("../models/cornell_box.obj"));
+  // Output arrays and internal buffers are allocated by `test_allocator`.
+  TEST_CHECK(gTestAllocatorCount > 0);
+  TEST_MSG("%d allocations", int(gTestAllocatorCount));
+#else
+  TEST_CHECK(reader.ParseFromFile("../models/cornell_box.obj"));
+  // `vector_of<T>::type` is `std::vector<T>` by default.
+  const std::vector<tinyobj::real_t>& vertices = reader.GetAttrib().vertices;
+  const std::vector<tinyobj::index_t>& indices =
+      reader.GetShapes()[0].mesh.indices;
+  TEST_CHECK(!vertices.empty());
+  TEST_CHECK(!indices.empty());
+#endif
+}
+
+static bool SameMaterial(const tinyobj::material_t& m0,
+                         const tinyobj::material_t& m1) {
+  return (m0.name == m1.name) &&
+         (0 == memcmp(m0.diffuse, m1.diffuse, sizeof(m0.diffuse))) &&
+         (m0.illum == m1.illum) && (m0.roughness == m1.roughness) &&
+         (m0.diffuse_texname == m1.diffuse_texname) &&
+         (m0.bump_texname == m1.bump_texname) &&
+         (m0.bump_texopt.bump_multiplier == m1.bump_texopt.bump_multiplier) &&
+         (m0.bump_texopt.imfchan == m1.bump_texopt.imfchan) &&
+         (m0.diffuse_texopt.clamp == m1.diffuse_texopt.clamp) &&
+         (m0.diffuse_texopt.colorspace == m1.diffuse_texopt.colorspace) &&
+         (0 == memcmp(m0.diffuse_texopt.scale, m1.diffuse_texopt.scale,
+                      sizeof(m0.diffuse_texopt.scale))) &&
+         (m0.unknown_parameter == m1.unknown_parameter);
+}
+
+void test_parse_face_index_same_as_parse_triple() {
+  const char* indices[] = {"1",         "7",         "10",       "42",
+                           "-1",        "-123",      "999",      "1000",
+                           "65535",     "123456",    "1000000",  "9999999",
+                           "12345678",  "99999999",  "-99999999", "100000000",
+                           "123456789", "0",         "00",       "-0",
+                           "+5",        "-",         "1a",       "-100000001",
+                           NULL};
+  const char* trailers[] = {"", " ", "\t", "\r", " 1/1/1 2/2/2 3/3/3", NULL};
+  const int vsize = 100000000;
+
+  std::string warn;
+  tinyobj::warning_context context;
+  context.warn = &warn;
+  context.line_number = 1;
+
+  for (size_t i = 0; indices[i]; i++) {
+    for (size_t t = 0; trailers[t]; t++) {
+      // `i/i/i` and `i` with short and long remaining strings.
+      std::string texts[2];
+      texts[0] = std::string(indices[i]) + "/" + indices[i] + "/" +
+                 indices[i] + trailers[t];
+      texts[1] = std::string(indices[i]) + trailers[t];
+      for (size_t k = 0; k < 2; k++) {
+        const char* text = texts[k].c_str();
+        const char* end = text + texts[k].size();
+
+        tinyobj::vertex_index_t expected;
+        const char* expected_token = text;
+        bool expected_ret = tinyobj::parseTriple(
+            &expected_token, vsize, vsize, vsize, &expected, context);
+
+        tinyobj::vertex_index_t vi;
+        const char* token = text;
+        bool ret =
+            (k == 0) ? tinyobj::parseTripleAs<tinyobj::FACE_PATTERN_V_VT_VN>(
+                           &token, end, vsize, vsize, vsize, &vi)
+                     : tinyobj::parseTripleAs<tinyobj::FACE_PATTERN_V>(
+                           &token, end, vsize, vsize, vsize, &vi);
+
+        // `parseTripleAs` may reject an index, but must not accept a
+        // different one.
+        if (ret) {
+          TEST_CHECK(expected_ret);
+          TEST_CHECK(expected_token == token);
+          TEST_CHECK(expected.v_idx == vi.v_idx);
+          TEST_CHECK(expected.vt_idx == vi.vt_idx);
+          TEST_CHECK(expected.vn_idx == vi.vn_idx);
+        } else {
+          TEST_CHECK(token == text);
+        }
+        TEST_MSG("text: `%s`", text);
+      }
+    }
+  }
+
+  // Indices of 1 to 8 digits are always accepted.
+  for (size_t i = 0; i < 13; i++) {
+    for (size_t t = 0; trailers[t]; t++) {
+      std::string text = std::string(indices[i]) + trailers[t];
+      tinyobj::vertex_index_t vi;
+      const char* token = text.c_str();
+      TEST_CHECK(tinyobj::parseTripleAs<tinyobj::FACE_PATTERN_V>(
+          &token, text.c_str() + text.size(), vsize, vsize, vsize, &vi));
+      TEST_MSG("text: `%s`", text.c_str());
+    }
+  }
+}
+
+void test_classify_line() {
+  struct {
+    const char* line;
+    tinyobj::MtlKeyword keyword;
+  } mtl_lines[] = {{"newmtl a", tinyobj::MTL_KEYWORD_NEWMTL},
+                   {"Ka 1 1 1", tinyobj::MTL_KEYWORD_KA},
+                   {"Kd\t1 1 1", tinyobj::MTL_KEYWORD_KD},
+                   {"Tf 1 1 1", tinyobj::MTL_KEYWORD_KT},
+                   {"Kt 1 1 1", tinyobj::MTL_KEYWORD_KT},
+                   {"Tr 0.5", tinyobj::MTL_KEYWORD_TR},
+                   {"d 0.5", tinyobj::MTL_KEYWORD_D},
+                   {"Pc 0.5", tinyobj::MTL_KEYWORD_PC},
+                   {"Pcr 0.5", tinyobj::MTL_KEYWORD_PCR},
+                   {"aniso 0.5", tinyobj::MTL_KEYWORD_ANISO},
+                   {"anisor 0.5", tinyobj::MTL_KEYWORD_ANISOR},
+                   {"map_d a.png", tinyobj::MTL_KEYWORD_MAP_D},
+                   {"map_Ke a.png", tinyobj::MTL_KEYWORD_MAP_KE},
+                   {"map_Ps a.png", tinyobj::MTL_KEYWORD_MAP_PS},
+                   {"map_Bump a.png", tinyobj::MTL_KEYWORD_MAP_BUMP},
+                   {"map_disp a.png", tinyobj::MTL_KEYWORD_MAP_DISP},
+                   {"disp a.png", tinyobj::MTL_KEYWORD_DISP},
+                   {"norm a.png", tinyobj::MTL_KEYWORD_NORM},
+                   {"Ka", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"Kab 1", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"dd 1", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"map_ a.png", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"map_Kx a.png", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"map_bumpy a.png", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {"mapXKd a.png", tinyobj::MTL_KEYWORD_UNKNOWN},
+                   {NULL, tinyobj::MTL_KEYWORD_UNKNOWN}};
+  for (size_t i = 0; mtl_lines[i].line; i++) {
+    TEST_CHECK(mtl_lines[i].keyword ==
+               tinyobj::classifyMtlKeyword(mtl_lines[i].line));
+    TEST_MSG("line: `%s`", mtl_lines[i].line);
+  }
+
+  struct {
+    const char* line;
+    tinyobj::ObjLineType type;
+  } obj_lines[] = {{"v 1 2 3", tinyobj::OBJ_LINE_V},
+                   {"vn 1 2 3", tinyobj::OBJ_LINE_VN},
+                   {"vt\t1 2", tinyobj::OBJ_LINE_VT},
+                   {"vw 0 0 1", tinyobj::OBJ_LINE_VW},
+                   {"f 1 2 3", tinyobj::OBJ_LINE_F},
+                   {"s off", tinyobj::OBJ_LINE_S},
+                   {"usemtl a", tinyobj::OBJ_LINE_USEMTL},
+                   {"usemtl", tinyobj::OBJ_LINE_USEMTL},
+                   {"mtllib a.mtl", tinyobj::OBJ_LINE_MTLLIB},
+                   {"v", tinyobj::OBJ_LINE_UNKNOWN},
+                   {"vx 1", tinyobj::OBJ_LINE_UNKNOWN},
+                   {"vn", tinyobj::OBJ_LINE_UNKNOWN},
+                   {"fo 1", tinyobj::OBJ_LINE_UNKNOWN},
+                   {"mtllib", tinyobj::OBJ_LINE_UNKNOWN},
+                   {"curv 0 1", tinyobj::OBJ_LINE_UNKNOWN},
+                   {NULL, tinyobj::OBJ_LINE_UNKNOWN}};
+  for (size_t i = 0; obj_lines[i].line; i++) {
+    TEST_CHECK(obj_lines[i].type ==
+               tinyobj::classifyObjLine(obj_lines[i].line));
+    TEST_MSG("line: `%s`", obj_lines[i].line);
+  }
+}
+
+void test_binary_cache() {
+  const char* cache_filename = "tinyobj_test_cache.bin";
+
+  std::vector<const char*> models;
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    models.push_back(gCompareModels[m]);
+  }
+  models.push_back("../models/texture-options-issue-85.obj");
+  models.push_back("../models/pbr-mat-ext.obj");
+
+  for (size_t m = 0; m < models.size(); m++) {
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(models[m])) {
+      continue;
+    }
+    TEST_CHECK(reader.SaveCache(cache_filename));
+
+    tinyobj::ObjReader cache_reader;
+    TEST_CHECK(cache_reader.LoadCache(cache_filename, models[m]));
+    TEST_CHECK(cache_reader.Valid());
+    TEST_CHECK(reader.Warning() == cache_reader.Warning());
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), cache_reader.GetAttrib(),
+                              cache_reader.GetShapes(),
+                              cache_reader.GetMaterials()));
+    for (size_t i = 0; i < reader.GetMaterials().size(); i++) {
+      TEST_CHECK(SameMaterial(reader.GetMaterials()[i],
+                              cache_reader.GetMaterials()[i]));
+    }
+    const tinyobj::vector_of<tinyobj::skin_weight_t>::type& sw0 =
+        reader.GetAttrib().skin_weights;
+    const tinyobj::vector_of<tinyobj::skin_weight_t>::type& sw1 =
+        cache_reader.GetAttrib().skin_weights;
+    for (size_t i = 0; i < sw0.size(); i++) {
+      TEST_CHECK(sw0[i].vertex_id == sw1[i].vertex_id);
+      TEST_CHECK(sw0[i].weightValues.size() == sw1[i].weightValues.size());
+    }
+    for (size_t i = 0; i < reader.GetShapes().size(); i++) {
+      const tinyobj::vector_of<tinyobj::tag_t>::type& tags0 =
+          reader.GetShapes()[i].mesh.tags;
+      const tinyobj::vector_of<tinyobj::tag_t>::type& tags1 =
+          cache_reader.GetShapes()[i].mesh.tags;
+      for (size_t k = 0; k < tags0.size(); k++) {
+        TEST_CHECK(tags0[k].name == tags1[k].name);
+        TEST_CHECK(tags0[k].intValues == tags1[k].intValues);
+        TEST_CHECK(tags0[k].stringValues == tags1[k].stringValues);
+      }
+    }
+    TEST_MSG("model: %s", models[m]);
+
+    // Validation against a different .obj fails.
+    tinyobj::ObjReader other_reader;
+    TEST_CHECK(
+        !other_reader.LoadCache(cache_filename, "../models/cube.obj"));
+    TEST_CHECK(!other_reader.Valid());
+  }
+
+  // Outdated cache.
+  {
+    const char* obj_filename = "tinyobj_test_cache.obj";
+    {
+      std::ofstream ofs(obj_filename);
+      ofs << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+    }
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile(obj_filename));
+    TEST_CHECK(reader.SaveCache(cache_filename));
+    TEST_CHECK(reader.LoadCache(cache_filename, obj_filename));
+    {
+      std::ofstream ofs(obj_filename, std::ios::app);
+      ofs << "f 3 2 1\n";
+    }
+    TEST_CHECK(!reader.LoadCache(cache_filename, obj_filename));
+    // No validation.
+    TEST_CHECK(reader.LoadCache(cache_filename));
+    TEST_CHECK(1 == reader.GetShapes().size());
+    remove(obj_filename);
+  }
+
+  // A failed parse is not cached, and does not overwrite the cache.
+  {
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile("../models/cube.obj"));
+    TEST_CHECK(reader.SaveCache(cache_filename));
+
+    tinyobj::ObjReader failed_reader;
+    TEST_CHECK(
+        !failed_reader.ParseFromFile("../models/issue-140-zero-face-idx.obj"));
+    TEST_CHECK(!failed_reader.SaveCache(cache_filename));
+    TEST_CHECK(failed_reader.Error().find("Cannot save cache") !=
+               std::string::npos);
+
+    tinyobj::ObjReader cache_reader;
+    TEST_CHECK(cache_reader.LoadCache(cache_filename, "../models/cube.obj"));
+    TEST_CHECK(SameLoadResult(reader.GetAttrib(), reader.GetShapes(),
+                              reader.GetMaterials(), cache_reader.GetAttrib(),
+                              cache_reader.GetShapes(),
+                              cache_reader.GetMaterials()));
+
+    // Nothing parsed.
+    tinyobj::ObjReader empty_reader;
+    TEST_CHECK(!empty_reader.SaveCache(cache_filename));
+  }
+
+  // Broken cache.
+  {
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile("../models/cornell_box.obj"));
+    TEST_CHECK(reader.SaveCache(cache_filename));
+
+    std::string cache_data;
+    {
+      std::ifstream ifs(cache_filename, std::ios::binary);
+      std::stringstream ss;
+      ss << ifs.rdbuf();
+      cache_data = ss.str();
+    }
+    {
+      // Truncated
+      std::ofstream ofs(cache_filename, std::ios::binary);
+      ofs << cache_data.substr(0, cache_data.size() / 2);
+    }
+    TEST_CHECK(!reader.LoadCache(cache_filename));
+    TEST_CHECK(!reader.Valid());
+    TEST_CHECK(!reader.LoadCache("../models/cube.obj"));
+  }
+
+  remove(cache_filename);
+}
+
+// `tryParseDouble` must be correctly rounded(same as `strtod`, or `strtof` for
+// float) when the fast path is taken, and be close to `strtod` otherwise.
+static bool ParsesSameAsStrtod(const std::string& str) {
+  const char* s = str.c_str();
+  const char* s_end = s + str.size();
+
+  char* strtod_end = NULL;
+  double expected = strtod(s, &strtod_end);
+  if (strtod_end != s_end) {
+    return true;  // Not a number accepted by both.
+  }
+  if ((expected != expected) ||
+      (fabs(expected) > std::numeric_limits<double>::max())) {
+    return true;  // nan and inf are not parsed by `tryParseDouble`.
+  }
+
+  double val = 0.0;
+  if (!tinyobj::tryParseDouble(s, s_end, &val)) {
+    return false;
+  }
+
+  // `(float)strtod(...)` may round twice, so float is compared with `strtof`.
+  tinyobj::real_t expected_real = static_cast<tinyobj::real_t>(expected);
+  if (sizeof(tinyobj::real_t) == sizeof(float)) {
+    expected_real = static_cast<tinyobj::real_t>(strtof(s, NULL));
+  }
+
+  double fast_val = 0.0;
+  if (tinyobj::tryParseDoubleFast<tinyobj::real_t>(s, s_end, &fast_val)) {
+    return (val == fast_val) &&
+           (static_cast<tinyobj::real_t>(val) == expected_real);
+  }
+
+  return fabs(val - expected) <= 1.0e-12 * fabs(expected);
+}
+
+void test_parse_real_same_as_strtod() {
+  const char* numbers[] = {"0",
+                           "-0",
+                           "1",
+                           "+1",
+                           "-1.5",
+                           "0.1",
+                           ".5",
+                           "-.5",
+                           "5.",
+                           "0.000001",
+                           "1.0e-7",
+                           "1e22",
+                           "1e23",
+                           "-2.5E+10",
+                           "3.4028235e38",
+                           "1.17549435e-38",
+                           "123456789012345678",
+                           "1234567890123456789",
+                           "12345678901234567890",
+                           "0.12345678901234567",
+                           "0.33333333333333333333",
+                           "16777217",
+                           "9007199254740993",
+                           "0.30000001192092896",
+                           "1.00000005960464477539",
+                           // double is halfway between two floats
+                           "0.5336968004703522",
+                           "0.953559547662735",
+                           "2.18841283788031e+24",
+                           "3.129468232130261e+28",
+                           NULL};
+  for (size_t i = 0; numbers[i]; i++) {
+    TEST_CHECK(ParsesSameAsStrtod(numbers[i]));
+    TEST_MSG("number: %s", numbers[i]);
+  }
+
+  std::vector<const char*> models;
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    models.push_back(gCompareModels[m]);
+  }
+  models.push_back("../models/leading-decimal-dot-issue-201.obj");
+  models.push_back("../models/leading-zero-in-exponent-notation-issue-210.obj");
+  models.push_back("../models/test-nan.obj");
+
+  for (size_t m = 0; m < models.size(); m++) {
+    const char* filename = models[m];
+    std::ifstream ifs(filename);
+    TEST_CHECK(ifs.good());
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+      std::stringstream ss(line);
+      std::string command;
+      ss >> command;
+      if ((command != "v") && (command != "vn") && (command != "vt")) {
+        continue;
+      }
+
+      std::string number;
+      while (ss >> number) {
+        TEST_CHECK(ParsesSameAsStrtod(number));
+        TEST_MSG("model: %s, number: %s", filename, number.c_str());
+      }
+    }
+  }
+}
+
+void test_default_vertex_attribs() {
+  tinyobj::ObjReaderConfig config;
+  config.default_vertex_attribs = false;
+
+  // No `w` and vertex color.
+  {
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile("../models/cube.obj", config));
+    const tinyobj::attrib_t& attrib = reader.GetAttrib();
+    TEST_CHECK(24 == attrib.vertices.size());
+    TEST_CHECK(attrib.vertex_weights.empty());
+    TEST_CHECK(attrib.colors.empty());
+    TEST_CHECK(1.0f == attrib.GetVertexWeight(7));
+    tinyobj::real_t r = 0, g = 0, b = 0;
+    attrib.GetVertexColor(7, &r, &g, &b);
+    TEST_CHECK((1.0f == r) && (1.0f == g) && (1.0f == b));
+
+    tinyobj::ObjReader default_reader;
+    TEST_CHECK(default_reader.ParseFromFile("../models/cube.obj"));
+    TEST_CHECK(8 == default_reader.GetAttrib().vertex_weights.size());
+    TEST_CHECK(24 == default_reader.GetAttrib().colors.size());
+  }
+
+  // Arrays are created at the first vertex with the data.
+  {
+    std::string obj_text =
+        "v 0 0 0\nv 1 0 0 0.5\nv 0 1 0\nv 0 0 1 0.2 0.3 0.4\nv 1 1 1\n"
+        "f 1 2 3\n";
+    for (int prescan = 0; prescan < 2; prescan++) {
+      for (int num_threads = 1; num_threads <= 2; num_threads++) {
+        config.prescan = (prescan == 1);
+        config.num_threads = num_threads;
+        tinyobj::ObjReader reader;
+        TEST_CHECK(reader.ParseFromString(obj_text, "", config));
+        const tinyobj::attrib_t& attrib = reader.GetAttrib();
+        TEST_CHECK(5 == attrib.vertex_weights.size());
+        TEST_CHECK(15 == attrib.colors.size());
+        TEST_CHECK(1.0f == attrib.GetVertexWeight(0));
+        TEST_CHECK(0.5f == attrib.GetVertexWeight(1));
+        TEST_CHECK(1.0f == attrib.GetVertexWeight(3));
+        tinyobj::real_t r = 0, g = 0, b = 0;
+        attrib.GetVertexColor(1, &r, &g, &b);
+        TEST_CHECK((1.0f == r) && (1.0f == g) && (1.0f == b));
+        attrib.GetVertexColor(3, &r, &g, &b);
+        TEST_CHECK(FloatEquals(0.2f, r) && FloatEquals(0.3f, g) &&
+                   FloatEquals(0.4f, b));
+        attrib.GetVertexColor(4, &r, &g, &b);
+        TEST_CHECK((1.0f == r) && (1.0f == g) && (1.0f == b));
+        TEST_MSG("prescan: %d, threads: %d", prescan, num_threads);
+      }
+    }
+  }
+
+  // Vertex color is still cleared when not all vertices have it and
+  // `vertex_color` is false.
+  {
+    config.vertex_color = false;
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromString("v 0 0 0 1 0 0\nv 1 0 0\n", "", config));
+    TEST_CHECK(reader.GetAttrib().colors.empty());
+  }
+}
+
+void test_attribute_mask() {
+  // Relative indices refer to the `vn`/`vt` lines even when they are skipped.
+  std::string obj_text =
+      "v 0 0 0 1 0 0\nv 1 0 0 0.5 0 0\nv 0 1 0 0 0 1\n"
+      "vn 0 0 1\nvt 0 0\nvt 1 0\nvw 0 0 0.5\nt crease 2/1/0 1 2 0.5\n"
+      "f 1/-2/-1 2/-1/-1 3//1\n"
+      "vt 0 1\nvn 0 1 0\n"
+      "f 1/3/2 2/-3/-2 3/-2/2\n";
+
+  tinyobj::ObjReaderConfig config;
+  for (int prescan = 0; prescan < 2; prescan++) {
+    for (int num_threads = 1; num_threads <= 2; num_threads++) {
+      config.prescan = (prescan == 1);
+      config.num_threads = num_threads;
+
+      config.attribute_mask = tinyobj::ATTRIBUTE_ALL;
+      tinyobj::ObjReader full_reader;
+      TEST_CHECK(full_reader.ParseFromString(obj_text, "", config));
+
+      config.attribute_mask =
+          tinyobj::ATTRIBUTE_TEXCOORD | tinyobj::ATTRIBUTE_SKIN_WEIGHT;
+      tinyobj::ObjReader reader;
+      TEST_CHECK(reader.ParseFromString(obj_text, "", config));
+      TEST_CHECK(reader.Warning().empty());
+      TEST_MSG("prescan: %d, threads: %d, warning: %s", prescan, num_threads,
+               reader.Warning().c_str());
+
+      const tinyobj::attrib_t& attrib = reader.GetAttrib();
+      TEST_CHECK(full_reader.GetAttrib().vertices == attrib.vertices);
+      TEST_CHECK(full_reader.GetAttrib().texcoords == attrib.texcoords);
+      TEST_CHECK(attrib.normals.empty());
+      TEST_CHECK(attrib.colors.empty());
+      TEST_CHECK(1 == attrib.skin_weights.size());
+      TEST_CHECK(reader.GetShapes()[0].mesh.tags.empty());
+      TEST_CHECK(1 == full_reader.GetShapes()[0].mesh.tags.size());
+
+      const tinyobj::vector_of<tinyobj::index_t>::type& indices =
+          reader.GetShapes()[0].mesh.indices;
+      const tinyobj::vector_of<tinyobj::index_t>::type& full_indices =
+          full_reader.GetShapes()[0].mesh.indices;
+      TEST_CHECK(6 == indices.size());
+      for (size_t i = 0; i < indices.size(); i++) {
+        TEST_CHECK(full_indices[i].vertex_index == indices[i].vertex_index);
+        TEST_CHECK(full_indices[i].texcoord_index ==
+                   indices[i].texcoord_index);
+        TEST_CHECK(-1 == indices[i].normal_index);
+      }
+      TEST_MSG("prescan: %d, threads: %d", prescan, num_threads);
+    }
+  }
+
+  // `w` is still loaded when colors are excluded.
+  config.attribute_mask = 0;
+  tinyobj::ObjReader reader;
+  TEST_CHECK(
+      reader.ParseFromString("v 0 0 0 0.5\nv 1 0 0 1 0 0\nv 0 1 0\n", "",
+                             config));
+  const tinyobj::attrib_t& attrib = reader.GetAttrib();
+  TEST_CHECK(9 == attrib.vertices.size());
+  TEST_CHECK(attrib.colors.empty());
+  TEST_CHECK(0.5f == attrib.GetVertexWeight(0));
+  TEST_CHECK(1.0f == attrib.GetVertexWeight(2));
+
+  // Excluding colors does not change how the other components are parsed:
+  // `0.5 abc` is w, `0.5 0.6 abc` is ignored(xyz).
+  const char* kInvalidColors[] = {"v 1 2 3 0.5 abc\n",
+                                  "v 1 2 3 0.5 0.6 abc\n"};
+  for (size_t i = 0; i < 2; i++) {
+    for (int num_threads = 1; num_threads <= 2; num_threads++) {
+      config.num_threads = num_threads;
+      config.attribute_mask = tinyobj::ATTRIBUTE_ALL;
+      tinyobj::ObjReader full_reader;
+      TEST_CHECK(full_reader.ParseFromString(kInvalidColors[i], "", config));
+      config.attribute_mask = ~tinyobj::ATTRIBUTE_COLOR;
+      tinyobj::ObjReader masked_reader;
+      TEST_CHECK(masked_reader.ParseFromString(kInvalidColors[i], "", config));
+
+      const tinyobj::attrib_t& full = full_reader.GetAttrib();
+      const tinyobj::attrib_t& masked = masked_reader.GetAttrib();
+      TEST_CHECK(full.vertices == masked.vertices);
+      TEST_CHECK(((i == 0) ? 0.5f : 1.0f) == full.GetVertexWeight(0));
+      TEST_CHECK(full.GetVertexWeight(0) == masked.GetVertexWeight(0));
+      TEST_CHECK(masked.colors.empty());
+      TEST_MSG("line: %s threads: %d", kInvalidColors[i], num_threads);
+    }
+  }
+}
+
+void test_face_patterns() {
+  // The index layout changes between(and within) faces.
+  std::string obj_text =
+      "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvn 0 0 1\n"
+      "f 1/1/1 2/2/1 3/2/1\n"
+      "f 1//1 2//1 -1//-1\n"
+      "f -3/-2/1 2/2 3/1/1\n"
+      "f 1 2 3\n"
+      "f 1/1 2/2 3/1/0\n"
+      "f 1\t2/1 +3\n";
+  const int expected[][3] = {
+      {0, 0, 0},  {1, 1, 0},   {2, 1, 0},   {0, -1, 0}, {1, -1, 0},
+      {2, -1, 0}, {0, 0, 0},   {1, 1, -1},  {2, 0, 0},  {0, -1, -1},
+      {1, -1, -1}, {2, -1, -1}, {0, 0, -1}, {1, 1, -1}, {2, 0, -1},
+      {0, -1, -1}, {1, 0, -1},  {2, -1, -1}};
+
+  tinyobj::ObjReader reader;
+  TEST_CHECK(reader.ParseFromString(obj_text, ""));
+  // `3/1/0` has a zero normal index.
+  TEST_CHECK(std::string::npos != reader.Warning().find("zero value index"));
+
+  const tinyobj::vector_of<tinyobj::index_t>::type& indices =
+      reader.GetShapes()[0].mesh.indices;
+  TEST_CHECK(18 == indices.size());
+  for (size_t i = 0; (i < indices.size()) && (i < 18); i++) {
+    TEST_CHECK(expected[i][0] == indices[i].vertex_index);
+    TEST_CHECK(expected[i][1] == indices[i].texcoord_index);
+    TEST_CHECK(expected[i][2] == indices[i].normal_index);
+    TEST_MSG("index %d: %d/%d/%d", int(i), indices[i].vertex_index,
+             indices[i].texcoord_index, indices[i].normal_index);
+  }
+
+  // Invalid indices are still reported after faces of the same layout.
+  tinyobj::ObjReader invalid_reader;
+  TEST_CHECK(false == invalid_reader.ParseFromString(
+                          "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nf 1 2 -4\n",
+                          ""));
+  TEST_CHECK(std::string::npos != invalid_reader.Error().find("Line 5"));
+  TEST_CHECK(false == invalid_reader.ParseFromString(
+                          "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nf 1 0 3\n",
+                          ""));
+}
+
+// Checks that `vtx` holds the attributes of face vertex `idx`.
+static bool SameIndexedVertex(const tinyobj::indexed_vertex_t& vtx,
+                              const tinyobj::attrib_t& attrib,
+                              const tinyobj::index_t& idx) {
+  for (size_t k = 0; k < 3; k++) {
+    if (vtx.position[k] != attrib.vertices[3 * size_t(idx.vertex_index) + k]) {
+      return false;
+    }
+    tinyobj::real_t normal =
+        ((idx.normal_index < 0) ||
+         (3 * size_t(idx.normal_index) >= attrib.normals.size()))
+            ? tinyobj::real_t(0.0)
+            : attrib.normals[3 * size_t(idx.normal_index) + k];
+    if (vtx.normal[k] != normal) {
+      return false;
+    }
+  }
+  for (size_t k = 0; k < 2; k++) {
+    tinyobj::real_t texcoord =
+        ((idx.texcoord_index < 0) ||
+         (2 * size_t(idx.texcoord_index) >= attrib.texcoords.size()))
+            ? tinyobj::real_t(0.0)
+            : attrib.texcoords[2 * size_t(idx.texcoord_index) + k];
+    if (vtx.texcoord[k] != texcoord) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void test_indexed_mesh() {
+  tinyobj::ObjReaderConfig config;
+  config.indexed_mesh = true;
+
+  // Each shape of cube.obj is a quad of distinct vertices.
+  {
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromFile("../models/cube.obj", config));
+    const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
+    const std::vector<tinyobj::indexed_mesh_t>& meshes =
+        reader.GetIndexedMeshes();
+    TEST_CHECK(6 == meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+      TEST_CHECK(4 == meshes[i].vertices.size());
+      TEST_CHECK(6 == meshes[i].indices.size());
+      TEST_CHECK(1 == meshes[i].submeshes.size());
+      TEST_CHECK(shapes[i].mesh.material_ids[0] ==
+                 meshes[i].submeshes[0].material_id);
+      TEST_CHECK(1.0f == meshes[i].vertices[0].color[0]);
+    }
+
+    tinyobj::ObjReader no_indexed_reader;
+    TEST_CHECK(no_indexed_reader.ParseFromFile("../models/cube.obj"));
+    TEST_CHECK(no_indexed_reader.GetIndexedMeshes().empty());
+  }
+
+  // Shared face vertices are merged, and materials are sorted.
+  {
+    std::string obj_text =
+        "mtllib a.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvn 0 0 1\n"
+        "usemtl a\nf 1//1 2//1 3//1\nusemtl b\nf 1 3 4\n"
+        "usemtl a\nf 1//1 3//1 4//1\n";
+    std::string mtl_text = "newmtl a\nnewmtl b\n";
+    tinyobj::ObjReader reader;
+    TEST_CHECK(reader.ParseFromString(obj_text, mtl_text, config));
+    const tinyobj::indexed_mesh_t& mesh = reader.GetIndexedMeshes()[0];
+    TEST_CHECK(7 == mesh.vertices.size());
+    TEST_CHECK(9 == mesh.indices.size());
+    TEST_CHECK(2 == mesh.submeshes.size());
+    TEST_CHECK(0 == mesh.submeshes[0].material_id);
+    TEST_CHECK(0 == mesh.submeshes[0].index_offset);
+    TEST_CHECK(6 == mesh.submeshes[0].num_indices);
+    TEST_CHECK(1 == mesh.submeshes[1].material_id);
+    TEST_CHECK(6 == mesh.submeshes[1].index_offset);
+    TEST_CHECK(3 == mesh.submeshes[1].num_indices);
+    TEST_CHECK(mesh.indices[0] == mesh.indices[3]);
+    TEST_CHECK(mesh.indices[2] == mesh.indices[4]);
+  }
+
+  // Triangles reproduce the faces of each material in order.
+  for (size_t m = 0; gCompareModels[m]; m++) {
+    config.triangulate = false;
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(gCompareModels[m], config)) {
+      continue;
+    }
+    const tinyobj::attrib_t& attrib = reader.GetAttrib();
+    for (size_t i = 0; i < reader.GetShapes().size(); i++) {
+      const tinyobj::mesh_t& shape_mesh = reader.GetShapes()[i].mesh;
+      const tinyobj::indexed_mesh_t& mesh = reader.GetIndexedMeshes()[i];
+      TEST_CHECK(mesh.vertices.size() <= shape_mesh.indices.size());
+
+      for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+        size_t dst = mesh.submeshes[s].index_offset;
+        size_t index_offset = 0;
+        for (size_t f = 0; f < shape_mesh.num_face_vertices.size(); f++) {
+          size_t nv = shape_mesh.num_face_vertices[f];
+          if (shape_mesh.material_ids[f] == mesh.submeshes[s].material_id) {
+            for (size_t k = 2; k < nv; k++) {
+              const tinyobj::index_t& i0 = shape_mesh.indices[index_offset];
+              const tinyobj::index_t& i1 =
+                  shape_mesh.indices[index_offset + k - 1];
+              const tinyobj::index_t& i2 = shape_mesh.indices[index_offset + k];
+              TEST_CHECK(SameIndexedVertex(
+                  mesh.vertices[mesh.indices[dst++]], attrib, i0));
+              TEST_CHECK(SameIndexedVertex(
+                  mesh.vertices[mesh.indices[dst++]], attrib, i1));
+              TEST_CHECK(SameIndexedVertex(
+                  mesh.vertices[mesh.indices[dst++]], attrib, i2));
+            }
+          }
+          index_offset += nv;
+        }
+        TEST_CHECK(dst == size_t(mesh.submeshes[s].index_offset +
+                                 mesh.submeshes[s].num_indices));
+      }
+    }
+    TEST_MSG("model: %s", gCompareModels[m]);
+
+    // Indexed meshes are saved in the cache.
+    const char* cache_filename = "tinyobj_test_cache.bin";
+    TEST_CHECK(reader.SaveCache(cache_filename));
+    tinyobj::ObjReader cache_reader;
+    TEST_CHECK(cache_reader.LoadCache(cache_filename));
+    TEST_CHECK(reader.GetIndexedMeshes().size() ==
+               cache_reader.GetIndexedMeshes().size());
+    for (size_t i = 0; i < reader.GetIndexedMeshes().size(); i++) {
+      const tinyobj::indexed_mesh_t& mesh0 = reader.GetIndexedMeshes()[i];
+      const tinyobj::indexed_mesh_t& mesh1 =
+          cache_reader.GetIndexedMeshes()[i];
+      TEST_CHECK(mesh0.indices == mesh1.indices);
+      TEST_CHECK(mesh0.vertices.size() == mesh1.vertices.size());
+      TEST_CHECK(mesh0.submeshes.size() == mesh1.submeshes.size());
+    }
+    remove(cache_filename);
+  }
+}
+
 // Fuzzer test.
 // Just check if it does not crash.
 // Disable by default since Windows filesystem can't create filename of afl
@@ -1515,4 +3432,52 @@ TEST_LIST = {
      test_invalid_relative_vertex_index},
     {"test_invalid_texture_vertex_index",
      test_invalid_texture_vertex_index},
+    {"test_parse_multithreaded",
+     test_parse_multithreaded},
+    {"test_parse_multithreaded_chunks",
+     test_parse_multithreaded_chunks},
+    {"test_parse_from_memory",
+     test_parse_from_memory},
+    {"test_parse_from_file_non_seekable",
+     test_parse_from_file_non_seekable},
+    {"test_parse_lines_in_place",
+     test_parse_lines_in_place},
+    {"test_parse_with_prescan",
+     test_parse_with_prescan},
+    {"test_stream_reader",
+     test_stream_reader},
+    {"test_incremental_parser",
+     test_incremental_parser},
+    {"test_gzip_compressed_obj",
+     test_gzip_compressed_obj},
+    {"test_zstd_compressed_obj",
+     test_zstd_compressed_obj},
+    {"test_custom_allocator",
+     test_custom_allocator},
+#ifdef TINYOBJLOADER_TEST_OPT_LOADER
+    {"test_opt_loader_same_as_load_obj",
+     test_opt_loader_same_as_load_obj},
+#endif
+    {"test_parse_real_same_as_strtod",
+     test_parse_real_same_as_strtod},
+    {"test_parse_face_index_same_as_parse_triple",
+     test_parse_face_index_same_as_parse_triple},
+    {"test_classify_line",
+     test_classify_line},
+    {"test_binary_cache",
+     test_binary_cache},
+    {"test_indexed_mesh",
+     test_indexed_mesh},
+    {"test_default_vertex_attribs",
+     test_default_vertex_attribs},
+    {"test_attribute_mask",
+     test_attribute_mask},
+    {"test_face_patterns",
+     test_face_patterns},
+    {"test_callback_same_as_load_obj",
+     test_callback_same_as_load_obj},
+    {"test_callback_vertex_w",
+     test_callback_vertex_w},
+    {"test_batch_callback_same_as_load_obj",
+     test_batch_callback_same_as_load_obj},
     {NULL, NULL}};
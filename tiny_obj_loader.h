@@ -64,10 +64,20 @@ THE SOFTWARE.
 #ifndef TINY_OBJ_LOADER_H_
 #define TINY_OBJ_LOADER_H_
 
+#include <stdint.h>
+
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+// Header which defines the allocator template of TINYOBJLOADER_ALLOCATOR(e.g.
+// -DTINYOBJLOADER_ALLOCATOR_HEADER='"my_allocator.h"'), so both can be given
+// from the command line(CMake: TINYOBJLOADER_ALLOCATOR_HEADER).
+#ifdef TINYOBJLOADER_ALLOCATOR_HEADER
+#include TINYOBJLOADER_ALLOCATOR_HEADER
+#endif
+
 namespace tinyobj {
 
 // TODO(syoyo): Better C++11 detection for older compiler
@@ -150,6 +160,27 @@ typedef double real_t;
 typedef float real_t;
 #endif
 
+// Allocator of the arrays of vertex attributes, indices and internal buffers.
+// Define TINYOBJLOADER_ALLOCATOR to the name of an allocator template(e.g. an
+// arena, huge-page or shared-memory allocator) before including this file.
+// The allocator is default-constructed.
+// It changes the layout of `attrib_t`, `shape_t` etc., so every translation
+// unit which includes this file must see the same TINYOBJLOADER_ALLOCATOR
+// (One Definition Rule). Mixing them is undefined behavior and is not detected
+// at link time.
+#ifndef TINYOBJLOADER_ALLOCATOR
+#define TINYOBJLOADER_ALLOCATOR std::allocator
+#endif
+
+///
+/// `std::vector` with TINYOBJLOADER_ALLOCATOR. `vector_of<T>::type` is
+/// `std::vector<T>` unless TINYOBJLOADER_ALLOCATOR is defined.
+///
+template <typename T>
+struct vector_of {
+  typedef std::vector<T, TINYOBJLOADER_ALLOCATOR<T> > type;
+};
+
 typedef enum {
   TEXTURE_TYPE_NONE,  // default
   TEXTURE_TYPE_SPHERE,
@@ -329,8 +360,8 @@ struct material_t {
 struct tag_t {
   std::string name;
 
-  std::vector<int> intValues;
-  std::vector<real_t> floatValues;
+  vector_of<int>::type intValues;
+  vector_of<real_t>::type floatValues;
   std::vector<std::string> stringValues;
 };
 
@@ -343,7 +374,7 @@ struct skin_weight_t {
   int vertex_id;  // Corresponding vertex index in `attrib_t::vertices`.
                   // Compared to `index_t`, this index must be positive and
                   // start with 0(does not allow relative indexing)
-  std::vector<joint_and_weight_t> weightValues;
+  vector_of<joint_and_weight_t>::type weightValues;
 };
 
 // Index struct to support different indices for vtx/normal/texcoord.
@@ -355,29 +386,29 @@ struct index_t {
 };
 
 struct mesh_t {
-  std::vector<index_t> indices;
-  std::vector<unsigned int>
+  vector_of<index_t>::type indices;
+  vector_of<unsigned int>::type
       num_face_vertices;          // The number of vertices per
                                   // face. 3 = triangle, 4 = quad, ...
-  std::vector<int> material_ids;  // per-face material ID
-  std::vector<unsigned int> smoothing_group_ids;  // per-face smoothing group
+  vector_of<int>::type material_ids;  // per-face material ID
+  vector_of<unsigned int>::type smoothing_group_ids;  // per-face smoothing group
                                                   // ID(0 = off. positive value
                                                   // = group id)
-  std::vector<tag_t> tags;                        // SubD tag
+  vector_of<tag_t>::type tags;                        // SubD tag
 };
 
 // struct path_t {
-//  std::vector<int> indices;  // pairs of indices for lines
+//  vector_of<int>::type indices;  // pairs of indices for lines
 //};
 
 struct lines_t {
   // Linear flattened indices.
-  std::vector<index_t> indices;        // indices for vertices(poly lines)
-  std::vector<int> num_line_vertices;  // The number of vertices per line.
+  vector_of<index_t>::type indices;        // indices for vertices(poly lines)
+  vector_of<int>::type num_line_vertices;  // The number of vertices per line.
 };
 
 struct points_t {
-  std::vector<index_t> indices;  // indices for points
+  vector_of<index_t>::type indices;  // indices for points
 };
 
 struct shape_t {
@@ -389,17 +420,17 @@ struct shape_t {
 
 // Vertex attributes
 struct attrib_t {
-  std::vector<real_t> vertices;  // 'v'(xyz)
+  vector_of<real_t>::type vertices;  // 'v'(xyz)
 
   // For backward compatibility, we store vertex weight in separate array.
-  std::vector<real_t> vertex_weights;  // 'v'(w)
-  std::vector<real_t> normals;         // 'vn'
-  std::vector<real_t> texcoords;       // 'vt'(uv)
+  vector_of<real_t>::type vertex_weights;  // 'v'(w)
+  vector_of<real_t>::type normals;         // 'vn'
+  vector_of<real_t>::type texcoords;       // 'vt'(uv)
 
   // For backward compatibility, we store texture coordinate 'w' in separate
   // array.
-  std::vector<real_t> texcoord_ws;  // 'vt'(w)
-  std::vector<real_t> colors;       // extension: vertex colors
+  vector_of<real_t>::type texcoord_ws;  // 'vt'(w)
+  vector_of<real_t>::type colors;       // extension: vertex colors
 
   //
   // TinyObj extension.
@@ -409,16 +440,64 @@ struct attrib_t {
   // To get a corresponding skin weight for a specific vertex id `vid`,
   // Need to reconstruct a look up table: `skin_weight_t::vertex_id` == `vid`
   // (e.g. using std::map, std::unordered_map)
-  std::vector<skin_weight_t> skin_weights;
+  vector_of<skin_weight_t>::type skin_weights;
 
   attrib_t() {}
 
   //
   // For pybind11
   //
-  const std::vector<real_t> &GetVertices() const { return vertices; }
+  const vector_of<real_t>::type &GetVertices() const { return vertices; }
+
+  const vector_of<real_t>::type &GetVertexWeights() const { return vertex_weights; }
+
+  //
+  // Accessors which also work when `vertex_weights` or `colors` is empty
+  // (see `ObjReaderConfig::default_vertex_attribs`).
+  //
+
+  // `w` of `i`th vertex. 1 when .obj has no `w`.
+  real_t GetVertexWeight(size_t i) const {
+    return (i < vertex_weights.size()) ? vertex_weights[i] : real_t(1.0);
+  }
 
-  const std::vector<real_t> &GetVertexWeights() const { return vertex_weights; }
+  // Color of `i`th vertex. (1, 1, 1) when .obj has no vertex color.
+  void GetVertexColor(size_t i, real_t *r, real_t *g, real_t *b) const {
+    if ((3 * i + 2) < colors.size()) {
+      (*r) = colors[3 * i + 0];
+      (*g) = colors[3 * i + 1];
+      (*b) = colors[3 * i + 2];
+    } else {
+      (*r) = (*g) = (*b) = real_t(1.0);
+    }
+  }
+};
+
+// Interleaved vertex of `indexed_mesh_t`.
+struct indexed_vertex_t {
+  real_t position[3];
+  real_t normal[3];    // (0, 0, 0) when the face vertex has no normal.
+  real_t texcoord[2];  // (0, 0) when the face vertex has no texcoord.
+  real_t color[3];     // (1, 1, 1) when .obj has no vertex color.
+};
+
+// Range of `indexed_mesh_t::indices` drawn with the same material.
+struct indexed_submesh_t {
+  int material_id;  // -1 = no material
+  uint32_t index_offset;
+  uint32_t num_indices;
+};
+
+// Single-indexed triangle mesh of a shape, which can be directly uploaded to
+// GPU as a vertex buffer and an index buffer.
+// Face vertices with the same (vertex, normal, texcoord) index are merged
+// into one vertex. Triangles are sorted by material(in the order of the first
+// appearance in the shape) so that each material is drawn with a single
+// `submeshes` range.
+struct indexed_mesh_t {
+  vector_of<indexed_vertex_t>::type vertices;
+  vector_of<uint32_t>::type indices;  // 3 indices per triangle
+  vector_of<indexed_submesh_t>::type submeshes;
 };
 
 struct callback_t {
@@ -459,6 +538,60 @@ struct callback_t {
         object_cb(NULL) {}
 };
 
+///
+/// Callbacks of `LoadObjWithBatchCallback`. Vertex attributes and primitives
+/// are passed as arrays of up to `batch_size` elements, instead of one call
+/// per element.
+///
+/// Indices are 0-based and resolved(relative indices are converted) like
+/// `LoadObj`. -1 = not specified(or the attribute has no callback).
+/// Pending batches are passed before `usemtl_cb`, `mtllib_cb`, `group_cb`,
+/// `object_cb` are called, and at the end of the file.
+///
+struct batch_callback_t {
+  // `xyz`: x, y, z of `count` vertices. `w`: w of them(1 if not given).
+  void (*vertex_cb)(void *user_data, const real_t *xyz, const real_t *w,
+                    size_t count);
+  // `rgb`: r, g, b of the same vertices as `vertex_cb`. 1 if not given.
+  void (*vertex_color_cb)(void *user_data, const real_t *rgb, size_t count);
+  void (*normal_cb)(void *user_data, const real_t *xyz, size_t count);
+  // `uvw`: u, v, w of `count` texcoords. v and w are 0 if not given.
+  void (*texcoord_cb)(void *user_data, const real_t *uvw, size_t count);
+
+  // `num_vertices[i]` is the number of vertices of i-th primitive, and
+  // `indices` are the vertices of all `count` primitives.
+  void (*face_cb)(void *user_data, const index_t *indices,
+                  const unsigned int *num_vertices, size_t count);  // `f`
+  void (*line_cb)(void *user_data, const index_t *indices,
+                  const unsigned int *num_vertices, size_t count);  // `l`
+  void (*point_cb)(void *user_data, const index_t *indices,
+                   const unsigned int *num_vertices, size_t count);  // `p`
+
+  // Same as `callback_t`.
+  void (*usemtl_cb)(void *user_data, const char *name, int material_id);
+  void (*mtllib_cb)(void *user_data, const material_t *materials,
+                    int num_materials);
+  void (*group_cb)(void *user_data, const char **names, int num_names);
+  void (*object_cb)(void *user_data, const char *name);
+
+  // The maximum number of elements(vertices, faces, ...) in a batch.
+  size_t batch_size;
+
+  batch_callback_t()
+      : vertex_cb(NULL),
+        vertex_color_cb(NULL),
+        normal_cb(NULL),
+        texcoord_cb(NULL),
+        face_cb(NULL),
+        line_cb(NULL),
+        point_cb(NULL),
+        usemtl_cb(NULL),
+        mtllib_cb(NULL),
+        group_cb(NULL),
+        object_cb(NULL),
+        batch_size(4096) {}
+};
+
 class MaterialReader {
  public:
   MaterialReader() {}
@@ -506,6 +639,17 @@ class MaterialStreamReader : public MaterialReader {
 };
 
 // v2 API
+
+// Flags of `ObjReaderConfig::attribute_mask`.
+typedef enum {
+  ATTRIBUTE_NORMAL = 1 << 0,       // `vn` lines and normal indices
+  ATTRIBUTE_TEXCOORD = 1 << 1,     // `vt` lines and texcoord indices
+  ATTRIBUTE_COLOR = 1 << 2,        // vertex color in `v` lines
+  ATTRIBUTE_SKIN_WEIGHT = 1 << 3,  // `vw` lines
+  ATTRIBUTE_TAG = 1 << 4,          // `t` lines
+  ATTRIBUTE_ALL = (1 << 5) - 1
+} attribute_flag_t;
+
 struct ObjReaderConfig {
   bool triangulate;  // triangulate polygon?
 
@@ -527,8 +671,63 @@ struct ObjReaderConfig {
   ///
   std::string mtl_search_path;
 
+  ///
+  /// The number of threads used to parse .obj in `ObjReader::ParseFromFile`.
+  /// 1 = single-threaded(default). 0 or negative = use the number of hardware
+  /// threads. The result is identical to the single-threaded parse.
+  /// Requires C++11 <thread>, otherwise ignored.
+  ///
+  int num_threads;
+
+  ///
+  /// Memory map the .obj file in `ObjReader::ParseFromFile` instead of
+  /// reading it into memory. Falls back to reading when mmap is not
+  /// available or the file is not a regular file(e.g. a pipe, which is read
+  /// until EOF).
+  ///
+  bool use_mmap;
+
+  ///
+  /// Scan .obj once before parsing to count `v`, `vn`, `vt` and `f` lines,
+  /// and reserve output arrays with the exact size. Avoids reallocation(and
+  /// the peak memory of it) while parsing at the cost of an extra scan.
+  ///
+  bool prescan;
+
+  ///
+  /// Build `indexed_mesh_t` of each shape after parsing.
+  /// See `ObjReader::GetIndexedMeshes`.
+  ///
+  bool indexed_mesh;
+
+  ///
+  /// Fill `attrib_t::vertex_weights`(and `attrib_t::colors` when
+  /// `vertex_color` is true) for every vertex, even when .obj has no `w` or
+  /// vertex color(default. same layout as the v1 API).
+  /// false = leave these arrays empty unless some `v` line has the data.
+  /// `attrib_t::GetVertexWeight` and `attrib_t::GetVertexColor` return the
+  /// default values for empty arrays.
+  ///
+  bool default_vertex_attribs;
+
+  ///
+  /// Attributes to load(bitwise OR of `attribute_flag_t`). Default = all.
+  /// Lines of excluded attributes are skipped without parsing the values.
+  /// Indices of excluded normals and texcoords are set to -1.
+  /// e.g. `0` loads only positions and primitives.
+  ///
+  unsigned int attribute_mask;
+
   ObjReaderConfig()
-      : triangulate(true), triangulation_method("simple"), vertex_color(true) {}
+      : triangulate(true),
+        triangulation_method("simple"),
+        vertex_color(true),
+        num_threads(1),
+        use_mmap(true),
+        prescan(false),
+        indexed_mesh(false),
+        default_vertex_attribs(true),
+        attribute_mask(ATTRIBUTE_ALL) {}
 };
 
 ///
@@ -536,10 +735,12 @@ struct ObjReaderConfig {
 ///
 class ObjReader {
  public:
-  ObjReader() : valid_(false) {}
+  ObjReader() : valid_(false), obj_file_size_(0), obj_file_mtime_(0) {}
 
   ///
   /// Load .obj and .mtl from a file.
+  /// gzip/zstd compressed .obj is decompressed while parsing when
+  /// TINYOBJLOADER_USE_ZLIB/TINYOBJLOADER_USE_ZSTD is defined.
   ///
   /// @param[in] filename wavefront .obj filename
   /// @param[in] config Reader configuration
@@ -559,6 +760,47 @@ class ObjReader {
   bool ParseFromString(const std::string &obj_text, const std::string &mtl_text,
                        const ObjReaderConfig &config = ObjReaderConfig());
 
+  ///
+  /// Parse .obj from a memory block. `obj_buf` need not be terminated by '\0'.
+  /// Need to supply .mtl text by `mtl_buf`(may be NULL).
+  /// This function ignores `mtllib` line in .obj text.
+  ///
+  /// @param[in] obj_buf wavefront .obj text
+  /// @param[in] obj_len byte length of `obj_buf`
+  /// @param[in] mtl_buf wavefront .mtl text
+  /// @param[in] mtl_len byte length of `mtl_buf`
+  /// @param[in] config Reader configuration
+  ///
+  bool ParseFromMemory(const char *obj_buf, size_t obj_len,
+                       const char *mtl_buf, size_t mtl_len,
+                       const ObjReaderConfig &config = ObjReaderConfig());
+
+  ///
+  /// Save the parsed result(attrib, shapes, materials and warning) to a
+  /// binary cache file, which `LoadCache` loads much faster than parsing .obj
+  /// text. When .obj was loaded by `ParseFromFile`, the size and modification
+  /// time of the .obj file are recorded in the cache.
+  /// Fails when the last parse failed(`Valid()` is false).
+  ///
+  /// @param[in] cache_filename Cache filename to write
+  ///
+  bool SaveCache(const std::string &cache_filename);
+
+  ///
+  /// Load a binary cache file saved by `SaveCache`. The result is the same as
+  /// the parse which created the cache(including `ObjReaderConfig`).
+  /// When `obj_filename` is not empty, fails if the cache was not created from
+  /// `obj_filename` of the same size and modification time, i.e. .obj has
+  /// been modified after the cache was saved. .mtl files are not checked, so
+  /// a cache is still loaded after only .mtl has been modified.
+  /// A cache file can only be loaded by the same `real_t` and byte order.
+  ///
+  /// @param[in] cache_filename Cache filename to load
+  /// @param[in] obj_filename .obj filename to validate the cache against
+  ///
+  bool LoadCache(const std::string &cache_filename,
+                 const std::string &obj_filename = std::string());
+
   ///
   /// .obj was loaded or parsed correctly.
   ///
@@ -570,6 +812,14 @@ class ObjReader {
 
   const std::vector<material_t> &GetMaterials() const { return materials_; }
 
+  ///
+  /// Single-indexed mesh of each shape(same order as `GetShapes`).
+  /// Empty unless `ObjReaderConfig::indexed_mesh` is set.
+  ///
+  const std::vector<indexed_mesh_t> &GetIndexedMeshes() const {
+    return indexed_meshes_;
+  }
+
   ///
   /// Warning message(may be filled after `Load` or `Parse`)
   ///
@@ -586,6 +836,226 @@ class ObjReader {
   attrib_t attrib_;
   std::vector<shape_t> shapes_;
   std::vector<material_t> materials_;
+  std::vector<indexed_mesh_t> indexed_meshes_;
+
+  std::string warning_;
+  std::string error_;
+
+  // .obj file loaded by `ParseFromFile`. Recorded in the cache file.
+  uint64_t obj_file_size_;
+  int64_t obj_file_mtime_;
+};
+
+///
+/// Build single-indexed triangle mesh from faces of `shape`(as
+/// `ObjReaderConfig::indexed_mesh` does for each shape).
+/// Polygons are triangulated as a triangle fan. Lines and points are not
+/// included.
+///
+/// @param[out] indexed_mesh Built mesh
+/// @param[in] attrib Vertex attributes of `shape`
+/// @param[in] shape Input shape
+///
+void BuildIndexedMesh(indexed_mesh_t *indexed_mesh, const attrib_t &attrib,
+                      const shape_t &shape);
+
+class ObjParser;
+class DecompressStreamBuf;
+
+///
+/// Streaming .obj reader class(v2 API)
+///
+/// Reads .obj line by line and returns each shape as soon as it is completed
+/// (at `g`, `o` or the end of file), so that a shape can be processed(e.g.
+/// uploaded to GPU) while the rest of the file is being parsed. Face data of
+/// a shape is released from the reader once it is returned. Vertex attributes
+/// are accumulated until the end of file.
+/// Shapes are identical to the ones of `ObjReader`.
+///
+class ObjStreamReader {
+ public:
+  ObjStreamReader();
+  ~ObjStreamReader();
+
+  ///
+  /// Open .obj file. .mtl files are loaded when `mtllib` line is parsed.
+  /// `num_threads`, `use_mmap` and `prescan` in `config` are not used.
+  ///
+  /// @param[in] filename wavefront .obj filename
+  /// @param[in] config Reader configuration
+  ///
+  bool Open(const std::string &filename,
+            const ObjReaderConfig &config = ObjReaderConfig());
+
+  ///
+  /// Read .obj from a stream. `inStream` and `readMatFn` must be alive until
+  /// all shapes are read.
+  ///
+  /// @param[in] inStream wavefront .obj stream
+  /// @param[in] readMatFn .mtl reader(may be NULL)
+  /// @param[in] config Reader configuration
+  ///
+  bool Open(std::istream *inStream, MaterialReader *readMatFn = NULL,
+            const ObjReaderConfig &config = ObjReaderConfig());
+
+  ///
+  /// Parse .obj until the next shape is completed and return it in `shape`.
+  /// Returns false when all shapes have been read or a parse error
+  /// occurred(`Valid()` is false in that case).
+  ///
+  bool ReadShape(shape_t *shape);
+
+  ///
+  /// .obj was read without error so far.
+  ///
+  bool Valid() const { return valid_; }
+
+  ///
+  /// All shapes have been read.
+  ///
+  bool Finished() const { return finished_; }
+
+  ///
+  /// Vertex attributes. Available after `ReadShape` returned false.
+  ///
+  const attrib_t &GetAttrib() const { return attrib_; }
+
+  ///
+  /// Vertex positions parsed so far. A shape returned by `ReadShape` only
+  /// refers to these vertices(when the .obj does not refer to a vertex
+  /// defined after the face).
+  ///
+  const vector_of<real_t>::type &GetVertices() const;
+
+  const std::vector<material_t> &GetMaterials() const { return materials_; }
+
+  ///
+  /// Warning message(may be filled while reading)
+  ///
+  const std::string &Warning() const { return warning_; }
+
+  ///
+  /// Error message(filled when reading failed)
+  ///
+  const std::string &Error() const { return error_; }
+
+ private:
+  // non-copyable
+  ObjStreamReader(const ObjStreamReader &);
+  ObjStreamReader &operator=(const ObjStreamReader &);
+
+  void Close();
+  bool Start(std::istream *inStream, MaterialReader *readMatFn,
+             const ObjReaderConfig &config);
+
+  bool valid_;
+  bool finished_;
+
+  std::istream *stream_;
+  std::ifstream *file_;              // owned. NULL when reading a stream.
+  MaterialReader *file_mat_reader_;  // owned. NULL when reading a stream.
+  DecompressStreamBuf *decompress_buf_;  // owned. NULL when not compressed.
+  std::istream *decompress_stream_;      // owned. NULL when not compressed.
+  ObjParser *parser_;                // owned.
+
+  std::string linebuf_;
+  std::vector<shape_t> completed_shapes_;
+  size_t completed_index_;
+
+  attrib_t attrib_;
+  std::vector<material_t> materials_;
+
+  std::string warning_;
+  std::string error_;
+};
+
+///
+/// Push-style .obj parser. .obj text is given in chunks of any size by `Feed`
+/// (e.g. as it is read from a storage), and each line is parsed as soon as it
+/// is complete. Only the incomplete last line of a chunk is buffered, so the
+/// whole .obj text is never held in memory.
+/// The result is the same as `ObjReader`.
+///
+class ObjIncrementalParser {
+ public:
+  ObjIncrementalParser();
+  ~ObjIncrementalParser();
+
+  ///
+  /// Start parsing a new .obj. .mtl files are loaded by `readMatFn` when
+  /// `mtllib` line is parsed. `readMatFn` must be alive until `Finish`.
+  /// `num_threads`, `use_mmap` and `prescan` in `config` are not used.
+  ///
+  /// @param[in] readMatFn .mtl reader(may be NULL)
+  /// @param[in] config Reader configuration
+  ///
+  bool Start(MaterialReader *readMatFn = NULL,
+             const ObjReaderConfig &config = ObjReaderConfig());
+
+  ///
+  /// Parse a chunk of .obj text. A line may be split across chunks.
+  /// Returns false when a parse error occurred(`Valid()` is false in that
+  /// case).
+  ///
+  /// @param[in] buf .obj text. need not be terminated by '\0'
+  /// @param[in] len byte length of `buf`
+  ///
+  bool Feed(const char *buf, size_t len);
+
+  ///
+  /// Parse the last line and complete the result. Call after all chunks are
+  /// fed.
+  ///
+  bool Finish();
+
+  ///
+  /// .obj was parsed without error so far.
+  ///
+  bool Valid() const { return valid_; }
+
+  ///
+  /// The results. Available after `Finish` returned true.
+  ///
+  const attrib_t &GetAttrib() const { return attrib_; }
+
+  const std::vector<shape_t> &GetShapes() const { return shapes_; }
+
+  const std::vector<material_t> &GetMaterials() const { return materials_; }
+
+  const std::vector<indexed_mesh_t> &GetIndexedMeshes() const {
+    return indexed_meshes_;
+  }
+
+  ///
+  /// Warning message(may be filled while parsing)
+  ///
+  const std::string &Warning() const { return warning_; }
+
+  ///
+  /// Error message(filled when parsing failed)
+  ///
+  const std::string &Error() const { return error_; }
+
+ private:
+  // non-copyable
+  ObjIncrementalParser(const ObjIncrementalParser &);
+  ObjIncrementalParser &operator=(const ObjIncrementalParser &);
+
+  void Close();
+
+  bool valid_;
+  bool finished_;
+  bool indexed_mesh_;
+
+  ObjParser *parser_;  // owned. NULL when not parsing.
+
+  std::string linebuf_;  // incomplete line at the end of the last chunk
+  bool skip_lf_;  // the last chunk ended with '\r', so skip '\n' of '\r\n'
+
+  attrib_t attrib_;
+  std::vector<shape_t> shapes_;
+  std::vector<material_t> materials_;
+  std::vector<indexed_mesh_t> indexed_meshes_;
 
   std::string warning_;
   std::string error_;
@@ -622,6 +1092,18 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
                          MaterialReader *readMatFn = NULL,
                          std::string *warn = NULL, std::string *err = NULL);
 
+/// Loads .obj from a file with batched user callback.
+/// Same as `LoadObjWithCallback`, but vertex attributes and primitives are
+/// passed to `callback` in arrays. See `batch_callback_t`.
+/// Returns false when a fatal parse error was found.
+/// See `examples/callback_api/` for how to use this function.
+bool LoadObjWithBatchCallback(std::istream &inStream,
+                              const batch_callback_t &callback,
+                              void *user_data = NULL,
+                              MaterialReader *readMatFn = NULL,
+                              std::string *warn = NULL,
+                              std::string *err = NULL);
+
 /// Loads object from a std::istream, uses `readMatFn` to retrieve
 /// std::istream for materials.
 /// Returns true when loading .obj become success.
@@ -654,63 +1136,499 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 
 #endif  // TINY_OBJ_LOADER_H_
 
-#ifdef TINYOBJLOADER_IMPLEMENTATION
-#include <cassert>
-#include <cctype>
-#include <cmath>
+// Number parsing and byte scanning helpers. They are also used by
+// experimental/tinyobj_loader_opt.h, which defines TINYOBJLOADER_PARSE_HELPERS
+// before including this file. All of them are static inline, so they may be
+// defined in any number of translation units.
+#if (defined(TINYOBJLOADER_IMPLEMENTATION) || \
+     defined(TINYOBJLOADER_PARSE_HELPERS)) && \
+    !defined(TINYOBJLOADER_PARSE_HELPERS_DEFINED_)
+#define TINYOBJLOADER_PARSE_HELPERS_DEFINED_
+
 #include <cstddef>
-#include <cstdlib>
 #include <cstring>
-#include <fstream>
-#include <limits>
-#include <set>
-#include <sstream>
-#include <utility>
 
-#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
-
-#ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
-// Assume earcut.hpp is included outside of tiny_obj_loader.h
-#else
+// Digits are converted 8 at once(SWAR) on little endian targets.
+// Define TINYOBJLOADER_DISABLE_SWAR to always convert digits one by one.
+#if !defined(TINYOBJLOADER_DISABLE_SWAR) &&                           \
+    (defined(__LITTLE_ENDIAN__) ||                                    \
+     (defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) &&  \
+      (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) ||                 \
+     defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM) ||        \
+     defined(_M_ARM64))
+#define TINYOBJLOADER_HAS_SWAR
+#endif
 
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Weverything"
+// SIMD(SSE2, AVX2) scanning of line endings and spaces.
+// Define TINYOBJLOADER_DISABLE_SIMD to always scan byte by byte.
+#if !defined(TINYOBJLOADER_DISABLE_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TINYOBJLOADER_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define TINYOBJLOADER_HAS_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && \
+    (defined(TINYOBJLOADER_HAS_SSE2) || defined(TINYOBJLOADER_HAS_AVX2))
+#include <intrin.h>
+#endif
 #endif
 
-#include <array>
+namespace tinyobj {
 
-#include "mapbox/earcut.hpp"
+static inline bool isDigit(char c) {
+  return static_cast<unsigned int>(c - '0') < static_cast<unsigned int>(10);
+}
 
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
+#ifdef TINYOBJLOADER_HAS_SWAR
+// Returns true when all 8 bytes of `val` are '0'...'9'.
+static inline bool isEightDigits(uint64_t val) {
+  return (((val & 0xF0F0F0F0F0F0F0F0ULL) |
+           (((val + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+          0x3333333333333333ULL);
+}
 
-#endif
+// Converts 8 digits loaded from memory(little endian) to the integer.
+static inline uint32_t parseEightDigits(uint64_t val) {
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL;  // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ULL;  // 1 + (10000 << 32)
+  val -= 0x3030303030303030ULL;
+  val = (val * 10) + (val >> 8);  // 2 digits in each 16 bits
+  val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+  return static_cast<uint32_t>(val);
+}
 
-#endif  // TINYOBJLOADER_USE_MAPBOX_EARCUT
+// Converts the leading digits of 8 bytes loaded from memory(little endian) to
+// the integer without a loop over digits. Returns the number of digits(0...8).
+static inline int parseLeadingDigits(uint64_t val, uint32_t *digits) {
+  // Nonzero bytes are not digits. Bytes after the first non-digit may be
+  // misclassified by the carry of `+ 0x06`, but they are not used.
+  const uint64_t non_digits =
+      ((val & 0xF0F0F0F0F0F0F0F0ULL) |
+       (((val + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ^
+      0x3333333333333333ULL;
+  // Bits below the lowest bit of the first non-digit(all bits when there is
+  // none). The top bit of each digit byte counts the digits.
+  const uint64_t below = (non_digits & (0 - non_digits)) - 1;
+  const int n = static_cast<int>(
+      (((below & 0x8080808080808080ULL) >> 7) * 0x0101010101010101ULL) >> 56);
+  if (n == 0) {
+    return 0;
+  }
 
-namespace tinyobj {
+  // Move the digits to the last bytes, and pad with '0' in front of them.
+  const int shift = 8 * (8 - n);
+  val = (val << shift) | (0x3030303030303030ULL & ~(~0ULL << shift));
+  (*digits) = parseEightDigits(val);
+  return n;
+}
+#endif
 
-MaterialReader::~MaterialReader() {}
+// Accumulates digits in [s, s_end) to `mantissa` and returns the end of
+// digits. `mantissa` wraps around when there are more than 19 digits in
+// total, so the caller must check the number of digits.
+static inline const char *parseDigits(const char *s, const char *s_end,
+                                      uint64_t *mantissa) {
+  const char *curr = s;
+  uint64_t m = *mantissa;
+#ifdef TINYOBJLOADER_HAS_SWAR
+  while ((s_end - curr) >= 8) {
+    uint64_t val;
+    memcpy(&val, curr, 8);
+    if (!isEightDigits(val)) {
+      break;
+    }
+    m = m * 100000000ULL + parseEightDigits(val);
+    curr += 8;
+  }
+#endif
+  while ((curr != s_end) && isDigit(*curr)) {
+    m = m * 10 + static_cast<uint64_t>(*curr - '0');
+    curr++;
+  }
+  *mantissa = m;
+  return curr;
+}
 
-struct vertex_index_t {
-  int v_idx, vt_idx, vn_idx;
-  vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
-  explicit vertex_index_t(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
-  vertex_index_t(int vidx, int vtidx, int vnidx)
-      : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+// 128-bit unsigned integer for `roundHalfwayToFloat`.
+struct uint128_parts {
+  uint64_t hi;
+  uint64_t lo;
 };
 
-// Internal data structure for face representation
-// index + smoothing group.
-struct face_t {
-  unsigned int
+static inline uint128_parts multiply64(uint64_t a, uint64_t b) {
+  const uint64_t a_lo = a & 0xFFFFFFFFULL;
+  const uint64_t a_hi = a >> 32;
+  const uint64_t b_lo = b & 0xFFFFFFFFULL;
+  const uint64_t b_hi = b >> 32;
+  const uint64_t ll = a_lo * b_lo;
+  const uint64_t lh = a_lo * b_hi;
+  const uint64_t hl = a_hi * b_lo;
+  const uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFFULL) + (hl & 0xFFFFFFFFULL);
+  uint128_parts r;
+  r.lo = (mid << 32) | (ll & 0xFFFFFFFFULL);
+  r.hi = (a_hi * b_hi) + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return r;
+}
+
+// `n` must be less than 128, and the result must fit in 128 bits.
+static inline uint128_parts shiftLeft128(uint128_parts v, int n) {
+  if (n >= 64) {
+    v.hi = v.lo << (n - 64);
+    v.lo = 0;
+  } else if (n > 0) {
+    v.hi = (v.hi << n) | (v.lo >> (64 - n));
+    v.lo <<= n;
+  }
+  return v;
+}
+
+// Converting `value`(`mantissa` * 10^`exponent` correctly rounded to double)
+// to float rounds twice, which is wrong when `value` is exactly halfway between
+// two floats but the decimal value is not. Moves such `value` by one double
+// toward the decimal value(compared exactly in integers), so that the
+// conversion rounds it to the correct float. `value` must be positive and in
+// the range of normal floats, and |`exponent`| <= 22.
+static inline double roundHalfwayToFloat(double value, uint64_t mantissa,
+                                         int exponent) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(double));
+  // The 29 bits below the 24-bit float significand are 100...0.
+  if ((bits & 0x1FFFFFFFULL) != 0x10000000ULL) {
+    return value;
+  }
+
+  // value = significand * 2^binary_exponent
+  const uint64_t significand = (bits & 0xFFFFFFFFFFFFFULL) | (1ULL << 52);
+  const int binary_exponent = static_cast<int>((bits >> 52) & 0x7FF) - 1075;
+
+  uint64_t pow5 = 1;
+  for (int i = 0; i < ((exponent < 0) ? -exponent : exponent); i++) {
+    pow5 *= 5;
+  }
+
+  // mantissa * 5^e vs significand * 2^(q - e) when e >= 0, and
+  // mantissa vs significand * 5^-e * 2^(q - e) when e < 0. Both sides are
+  // scaled to integers of about the same magnitude(< 2^106).
+  uint128_parts lhs = multiply64(mantissa, (exponent >= 0) ? pow5 : 1);
+  uint128_parts rhs = multiply64(significand, (exponent >= 0) ? 1 : pow5);
+  const int shift = binary_exponent - exponent;
+  if (shift >= 0) {
+    rhs = shiftLeft128(rhs, shift);
+  } else {
+    lhs = shiftLeft128(lhs, -shift);
+  }
+
+  if ((lhs.hi != rhs.hi) || (lhs.lo != rhs.lo)) {
+    const bool above = (lhs.hi != rhs.hi) ? (lhs.hi > rhs.hi) : (lhs.lo > rhs.lo);
+    bits = above ? (bits + 1) : (bits - 1);
+  }  // else exactly halfway: the conversion rounds to even.
+  memcpy(&value, &bits, sizeof(double));
+  return value;
+}
+
+// Fast path of `tryParseDouble` for the common case: [s, s_end) is exactly one
+// number of up to 19 digits with a small exponent. The value is computed with
+// one(exact) multiplication or division of integers represented exactly in
+// floating point, thus correctly rounded(Clinger's fast path). When `Real` is
+// float(the value is converted to float by the caller), the value is computed
+// in float when possible, otherwise the double is adjusted by
+// `roundHalfwayToFloat` so that it is not rounded twice. Returns false when
+// not applicable.
+template <typename Real>
+static inline bool tryParseDoubleFast(const char *s, const char *s_end,
+                                      double *result) {
+  static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *curr = s;
+  bool negative = false;
+  if ((curr != s_end) && ((*curr == '+') || (*curr == '-'))) {
+    negative = (*curr == '-');
+    curr++;
+  }
+
+  uint64_t mantissa = 0;
+  const char *digits_begin = curr;
+  curr = parseDigits(curr, s_end, &mantissa);
+  ptrdiff_t num_digits = curr - digits_begin;
+
+  int exponent = 0;
+  if ((curr != s_end) && (*curr == '.')) {
+    curr++;
+    const char *frac_begin = curr;
+    curr = parseDigits(curr, s_end, &mantissa);
+    exponent = -static_cast<int>(curr - frac_begin);
+    num_digits += curr - frac_begin;
+  }
+
+  // 19 digits always fit in uint64_t.
+  if ((num_digits == 0) || (num_digits > 19)) {
+    return false;
+  }
+
+  if ((curr != s_end) && ((*curr == 'e') || (*curr == 'E'))) {
+    curr++;
+    bool exp_negative = false;
+    if ((curr != s_end) && ((*curr == '+') || (*curr == '-'))) {
+      exp_negative = (*curr == '-');
+      curr++;
+    }
+    if ((curr == s_end) || !isDigit(*curr)) {
+      return false;
+    }
+    int exp_value = 0;
+    while ((curr != s_end) && isDigit(*curr)) {
+      if (exp_value > 9999) {
+        return false;
+      }
+      exp_value = exp_value * 10 + (*curr - '0');
+      curr++;
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+  if (curr != s_end) {
+    return false;
+  }
+
+  if (mantissa == 0) {
+    *result = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  static const float kPow10f[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                  1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+  if ((sizeof(Real) == sizeof(float)) && (mantissa <= (1ULL << 24)) &&
+      (exponent >= -10) && (exponent <= 10)) {
+    float value = static_cast<float>(mantissa);
+    if (exponent < 0) {
+      value /= kPow10f[-exponent];
+    } else {
+      value *= kPow10f[exponent];
+    }
+    *result = negative ? -double(value) : double(value);
+    return true;
+  }
+
+  if ((mantissa <= (1ULL << 53)) && (exponent >= -22) && (exponent <= 22)) {
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0) {
+      value /= kPow10[-exponent];
+    } else {
+      value *= kPow10[exponent];
+    }
+    if (sizeof(Real) == sizeof(float)) {
+      // 1e-22 <= value < 2^53 * 1e22, in the range of normal floats.
+      value = roundHalfwayToFloat(value, mantissa, exponent);
+    }
+    *result = negative ? -value : value;
+    return true;
+  }
+
+  return false;
+}
+
+#if defined(TINYOBJLOADER_HAS_SSE2) || defined(TINYOBJLOADER_HAS_AVX2)
+static inline int CountTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long idx;
+  _BitScanForward(&idx, mask);
+  return static_cast<int>(idx);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Returns the first position in [p, end) where the byte is one of `c0`, `c1`
+// and `c2`(`match` = true), or is none of them(`match` = false). Returns `end`
+// when not found. Compares 32 or 16 bytes at once when SIMD is available.
+static inline const char *ScanBytes(const char *p, const char *end, char c0,
+                                    char c1, char c2, bool match) {
+#ifdef TINYOBJLOADER_HAS_AVX2
+  {
+    const __m256i v0 = _mm256_set1_epi8(c0);
+    const __m256i v1 = _mm256_set1_epi8(c1);
+    const __m256i v2 = _mm256_set1_epi8(c2);
+    const unsigned int flip = match ? 0u : 0xFFFFFFFFu;
+    while ((end - p) >= 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i eq = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(block, v0),
+                          _mm256_cmpeq_epi8(block, v1)),
+          _mm256_cmpeq_epi8(block, v2));
+      unsigned int mask =
+          static_cast<unsigned int>(_mm256_movemask_epi8(eq)) ^ flip;
+      if (mask) {
+        return p + CountTrailingZeros(mask);
+      }
+      p += 32;
+    }
+  }
+#endif
+#ifdef TINYOBJLOADER_HAS_SSE2
+  {
+    const __m128i v0 = _mm_set1_epi8(c0);
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const unsigned int flip = match ? 0u : 0xFFFFu;
+    while ((end - p) >= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v0),
+                                             _mm_cmpeq_epi8(block, v1)),
+                                _mm_cmpeq_epi8(block, v2));
+      unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(eq)) ^
+                          flip;
+      if (mask) {
+        return p + CountTrailingZeros(mask);
+      }
+      p += 16;
+    }
+  }
+#endif
+  while ((p < end) &&
+         ((((*p) == c0) || ((*p) == c1) || ((*p) == c2)) != match)) {
+    p++;
+  }
+  return p;
+}
+
+}  // namespace tinyobj
+
+#endif  // TINYOBJLOADER_PARSE_HELPERS_DEFINED_
+
+// The implementation is defined once even when this file is included again
+// (e.g. by experimental/tinyobj_loader_opt.h).
+#if defined(TINYOBJLOADER_IMPLEMENTATION) && \
+    !defined(TINYOBJLOADER_IMPLEMENTATION_DEFINED_)
+#define TINYOBJLOADER_IMPLEMENTATION_DEFINED_
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Shapes, materials and tags are moved(instead of copied) to the output with
+// C++11.
+#if (__cplusplus > 199711L) || (defined(_MSC_VER) && (_MSC_VER >= 1900))
+#define TINYOBJLOADER_HAS_MOVE
+#endif
+
+// Multithreaded parsing requires C++11 <thread>.
+// Define TINYOBJLOADER_DISABLE_THREADS to always parse on a single thread.
+#if !defined(TINYOBJLOADER_DISABLE_THREADS) && \
+    ((__cplusplus > 199711L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define TINYOBJLOADER_HAS_THREADS
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+// Memory mapped file I/O for `ObjReader::ParseFromFile`.
+// Define TINYOBJLOADER_DISABLE_MMAP to always read a file with std::ifstream.
+#if !defined(TINYOBJLOADER_DISABLE_MMAP)
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define TINYOBJLOADER_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#define TINYOBJLOADER_UNDEF_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef TINYOBJLOADER_UNDEF_WIN32_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef TINYOBJLOADER_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifdef TINYOBJLOADER_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef TINYOBJLOADER_UNDEF_NOMINMAX
+#endif
+#define TINYOBJLOADER_HAS_MMAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TINYOBJLOADER_HAS_MMAP
+#endif
+#endif
+
+// gzip and zstd compressed .obj and .mtl(detected by the magic number).
+// Define TINYOBJLOADER_USE_ZLIB and/or TINYOBJLOADER_USE_ZSTD, and link zlib
+// and/or zstd.
+#ifdef TINYOBJLOADER_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TINYOBJLOADER_USE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+
+#ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
+// Assume earcut.hpp is included outside of tiny_obj_loader.h
+#else
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <array>
+
+#include "mapbox/earcut.hpp"
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#endif
+
+#endif  // TINYOBJLOADER_USE_MAPBOX_EARCUT
+
+namespace tinyobj {
+
+MaterialReader::~MaterialReader() {}
+
+struct vertex_index_t {
+  int v_idx, vt_idx, vn_idx;
+  vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
+  explicit vertex_index_t(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
+  vertex_index_t(int vidx, int vtidx, int vnidx)
+      : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+};
+
+// Internal data structure for face representation
+// index + smoothing group.
+// Face vertex indices are stored in `PrimGroup::faceIndices` so that parsing
+// a face does not allocate.
+struct face_t {
+  unsigned int
       smoothing_group_id;  // smoothing group id. 0 = smoothing groupd is off.
-  int pad_;
-  std::vector<vertex_index_t> vertex_indices;  // face vertex indices.
+  unsigned int num_vertices;  // the number of face vertices.
+  size_t vertex_offset;       // offset to `PrimGroup::faceIndices`.
 
-  face_t() : smoothing_group_id(0), pad_(0) {}
+  face_t() : smoothing_group_id(0), num_vertices(0), vertex_offset(0) {}
 };
 
 // Internal data structure for line representation
@@ -718,7 +1636,10 @@ struct __line_t {
   // l v1/vt1 v2/vt2 ...
   // In the specification, line primitrive does not have normal index, but
   // TinyObjLoader allow it
-  std::vector<vertex_index_t> vertex_indices;
+  unsigned int num_vertices;
+  size_t vertex_offset;  // offset to `PrimGroup::lineIndices`.
+
+  __line_t() : num_vertices(0), vertex_offset(0) {}
 };
 
 // Internal data structure for points representation
@@ -726,7 +1647,10 @@ struct __points_t {
   // p v1 v2 ...
   // In the specification, point primitrive does not have normal index and
   // texture coord index, but TinyObjLoader allow it.
-  std::vector<vertex_index_t> vertex_indices;
+  unsigned int num_vertices;
+  size_t vertex_offset;  // offset to `PrimGroup::pointsIndices`.
+
+  __points_t() : num_vertices(0), vertex_offset(0) {}
 };
 
 struct tag_sizes {
@@ -737,22 +1661,35 @@ struct tag_sizes {
 };
 
 struct obj_shape {
-  std::vector<real_t> v;
-  std::vector<real_t> vn;
-  std::vector<real_t> vt;
+  vector_of<real_t>::type v;
+  vector_of<real_t>::type vn;
+  vector_of<real_t>::type vt;
 };
 
 //
 // Manages group of primitives(face, line, points, ...)
 struct PrimGroup {
-  std::vector<face_t> faceGroup;
-  std::vector<__line_t> lineGroup;
-  std::vector<__points_t> pointsGroup;
+  vector_of<face_t>::type faceGroup;
+  vector_of<__line_t>::type lineGroup;
+  vector_of<__points_t>::type pointsGroup;
+
+  // Vertex indices of all primitives in the group, referenced by
+  // `vertex_offset` and `num_vertices` of each primitive.
+  vector_of<vertex_index_t>::type faceIndices;
+  vector_of<vertex_index_t>::type lineIndices;
+  vector_of<vertex_index_t>::type pointsIndices;
 
   void clear() {
-    faceGroup.clear();
+    clearFaces();
     lineGroup.clear();
+    lineIndices.clear();
     pointsGroup.clear();
+    pointsIndices.clear();
+  }
+
+  void clearFaces() {
+    faceGroup.clear();
+    faceIndices.clear();
   }
 
   bool IsEmpty() const {
@@ -899,6 +1836,10 @@ static bool tryParseDouble(const char *s, const char *s_end, double *result) {
     return false;
   }
 
+  if (tryParseDoubleFast<real_t>(s, s_end, result)) {
+    return true;
+  }
+
   double mantissa = 0.0;
   // This exponent is base 2 rather than 10.
   // However the exponent we parse is supposed to be one of ten,
@@ -1050,6 +1991,43 @@ static inline bool parseReal(const char **token, real_t *out) {
   return ret;
 }
 
+// `parseReal` of a line in [(*token), end), which need not be terminated by
+// '\0'. Used to parse lines in place in the input buffer.
+static inline bool parseReal(const char **token, const char *end,
+                             real_t *out) {
+  const char *p = (*token);
+  while ((p < end) && IS_SPACE((*p))) {
+    p++;
+  }
+  const char *s = p;
+  while ((p < end) && !IS_SPACE((*p)) && ((*p) != '\r') && ((*p) != '\0')) {
+    p++;
+  }
+  double val;
+  bool ret = tryParseDouble(s, p, &val);
+  if (ret) {
+    (*out) = static_cast<real_t>(val);
+  }
+  (*token) = p;
+  return ret;
+}
+
+static inline real_t parseReal(const char **token, const char *end,
+                               double default_value) {
+  real_t f;
+  if (!parseReal(token, end, &f)) {
+    f = static_cast<real_t>(default_value);
+  }
+  return f;
+}
+
+static inline void parseReal3(real_t *x, real_t *y, real_t *z,
+                              const char **token, const char *end) {
+  (*x) = parseReal(token, end, 0.0);
+  (*y) = parseReal(token, end, 0.0);
+  (*z) = parseReal(token, end, 0.0);
+}
+
 static inline void parseReal2(real_t *x, real_t *y, const char **token,
                               const double default_x = 0.0,
                               const double default_y = 0.0) {
@@ -1079,36 +2057,34 @@ static inline void parseV(real_t *x, real_t *y, real_t *z, real_t *w,
 }
 #endif
 
-// Extension: parse vertex with colors(6 items)
+// Extension: parse vertex with colors(6 items) in [(*token), end)
 // Return 3: xyz, 4: xyzw, 6: xyzrgb
 // `r`: red(case 6) or [w](case 4)
 static inline int parseVertexWithColor(real_t *x, real_t *y, real_t *z,
                                        real_t *r, real_t *g, real_t *b,
                                        const char **token,
-                                       const double default_x = 0.0,
-                                       const double default_y = 0.0,
-                                       const double default_z = 0.0) {
+                                       const char *end) {
   // TODO: Check error
-  (*x) = parseReal(token, default_x);
-  (*y) = parseReal(token, default_y);
-  (*z) = parseReal(token, default_z);
+  (*x) = parseReal(token, end, 0.0);
+  (*y) = parseReal(token, end, 0.0);
+  (*z) = parseReal(token, end, 0.0);
 
   // - 4 components(x, y, z, w) ot 6 components
-  bool has_r = parseReal(token, r);
+  bool has_r = parseReal(token, end, r);
 
   if (!has_r) {
     (*r) = (*g) = (*b) = 1.0;
     return 3;
   }
 
-  bool has_g = parseReal(token, g);
+  bool has_g = parseReal(token, end, g);
 
   if (!has_g) {
     (*g) = (*b) = 1.0;
     return 4;
   }
 
-  bool has_b = parseReal(token, b);
+  bool has_b = parseReal(token, end, b);
 
   if (!has_b) {
     (*r) = (*g) = (*b) = 1.0;
@@ -1118,6 +2094,32 @@ static inline int parseVertexWithColor(real_t *x, real_t *y, real_t *z,
   return 6;
 }
 
+// Same as `parseVertexWithColor`, but color values are only validated, not
+// stored. `r` is `w`(or red) as `parseVertexWithColor`.
+static inline int parseVertexWithoutColor(real_t *x, real_t *y, real_t *z,
+                                          real_t *r, const char **token,
+                                          const char *end) {
+  (*x) = parseReal(token, end, 0.0);
+  (*y) = parseReal(token, end, 0.0);
+  (*z) = parseReal(token, end, 0.0);
+
+  if (!parseReal(token, end, r)) {
+    (*r) = 1.0;
+    return 3;
+  }
+
+  // g and b must be numbers, as in `parseVertexWithColor`.
+  real_t unused;
+  if (!parseReal(token, end, &unused)) {
+    return 4;
+  }
+  if (!parseReal(token, end, &unused)) {
+    (*r) = 1.0;
+    return 3;  // treated as xyz
+  }
+  return 6;
+}
+
 static inline bool parseOnOff(const char **token, bool default_value = true) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
@@ -1238,6 +2240,182 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   return true;
 }
 
+// Index layout of `f` line vertices. Files almost always use a single layout,
+// so `ObjParser` detects it from the first vertex of a face and parses the
+// following vertices with `parseTripleAs`.
+enum FacePattern {
+  FACE_PATTERN_UNKNOWN = 0,
+  FACE_PATTERN_V,         // i
+  FACE_PATTERN_V_VT,      // i/j
+  FACE_PATTERN_V_VN,      // i//k
+  FACE_PATTERN_V_VT_VN    // i/j/k
+};
+
+// Skips an index of a face vertex in [p, end). Same as
+// `p += strcspn(p, "/ \t\r")` for a '\0' terminated line.
+static inline const char *skipFaceIndex(const char *p, const char *end) {
+  while ((p < end) && ((*p) != '/') && !IS_SPACE((*p)) && !IS_NEW_LINE((*p))) {
+    p++;
+  }
+  return p;
+}
+
+static FacePattern detectFacePattern(const char *token, const char *end) {
+  token = skipFaceIndex(token, end);
+  if ((token == end) || (token[0] != '/')) {
+    return FACE_PATTERN_V;
+  }
+  if (((token + 1) < end) && (token[1] == '/')) {
+    return FACE_PATTERN_V_VN;
+  }
+  token = skipFaceIndex(token + 1, end);
+  return ((token < end) && (token[0] == '/')) ? FACE_PATTERN_V_VT_VN
+                                              : FACE_PATTERN_V_VT;
+}
+
+// Parses a nonzero index(`[-]digits`) in [p, end) as written(negative =
+// relative). Returns the end of the digits, or NULL when the index needs
+// `fixIndex`(zero, too long or malformed).
+static inline const char *parseRawFaceIndex(const char *p, const char *end,
+                                            int *raw) {
+  if (p >= end) {
+    return NULL;
+  }
+  const bool negative = (p[0] == '-');
+  if (negative) {
+    p++;
+  }
+
+  int val = 0;
+#ifdef TINYOBJLOADER_HAS_SWAR
+  if ((end - p) >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    uint32_t digits;
+    const int num_digits = parseLeadingDigits(word, &digits);
+    p += num_digits;
+    // Up to 8 digits. Longer ones are left to `fixIndex`.
+    if ((num_digits == 0) || ((p < end) && IS_DIGIT(p[0])) || (digits == 0)) {
+      return NULL;
+    }
+    val = static_cast<int>(digits);
+  } else
+#endif
+  {
+    const char *digits = p;
+    while ((p < end) && IS_DIGIT(p[0])) {
+      val = val * 10 + (p[0] - '0');
+      p++;
+    }
+    if ((p == digits) || ((p - digits) > 8) || (val == 0)) {
+      return NULL;
+    }
+  }
+
+  (*raw) = negative ? -val : val;
+  return p;
+}
+
+// Resolves a nonzero index parsed by `parseRawFaceIndex` as `fixIndex`, where
+// `n` is the number of elements so far. Returns false when a relative index is
+// out of range.
+static inline bool resolveFaceIndex(int raw, int n, int *ret) {
+  if (raw > 0) {
+    (*ret) = raw - 1;
+    return true;
+  }
+  (*ret) = n + raw;  // negative value = relative
+  return ((*ret) >= 0);
+}
+
+// Parses a vertex of a `f` line which matches `Pattern` exactly. Indices are
+// stored as written(0 = not specified). Returns false without consuming
+// `token` when the vertex does not match `Pattern`, or when an index needs
+// `fixIndex`.
+template <FacePattern Pattern>
+static inline bool parseRawTripleAs(const char **token, const char *end,
+                                    vertex_index_t *raw) {
+  vertex_index_t vi(0);
+
+  const char *p = parseRawFaceIndex((*token), end, &vi.v_idx);
+  if (!p) {
+    return false;
+  }
+
+  if ((Pattern == FACE_PATTERN_V_VT) || (Pattern == FACE_PATTERN_V_VT_VN)) {
+    if ((p == end) || (p[0] != '/')) {
+      return false;
+    }
+    p = parseRawFaceIndex(p + 1, end, &vi.vt_idx);
+    if (!p) {
+      return false;
+    }
+  }
+
+  if (Pattern == FACE_PATTERN_V_VN) {
+    if (((end - p) < 2) || (p[0] != '/') || (p[1] != '/')) {
+      return false;
+    }
+    p = parseRawFaceIndex(p + 2, end, &vi.vn_idx);
+    if (!p) {
+      return false;
+    }
+  } else if (Pattern == FACE_PATTERN_V_VT_VN) {
+    if ((p == end) || (p[0] != '/')) {
+      return false;
+    }
+    p = parseRawFaceIndex(p + 1, end, &vi.vn_idx);
+    if (!p) {
+      return false;
+    }
+  }
+
+  // Same terminators as `parseTriple`.
+  if ((p < end) && !IS_SPACE(p[0]) && (p[0] != '\r') && (p[0] != '\0')) {
+    return false;
+  }
+
+  (*token) = p;
+  (*raw) = vi;
+  return true;
+}
+
+// Resolves a vertex parsed by `parseRawTripleAs`(-1 = not specified).
+// Returns false when a relative index is out of range.
+static inline bool resolveTriple(const vertex_index_t &raw, int vsize,
+                                 int vnsize, int vtsize, vertex_index_t *ret) {
+  vertex_index_t vi(-1);
+  if (!resolveFaceIndex(raw.v_idx, vsize, &vi.v_idx)) {
+    return false;
+  }
+  if (raw.vt_idx && !resolveFaceIndex(raw.vt_idx, vtsize, &vi.vt_idx)) {
+    return false;
+  }
+  if (raw.vn_idx && !resolveFaceIndex(raw.vn_idx, vnsize, &vi.vn_idx)) {
+    return false;
+  }
+  (*ret) = vi;
+  return true;
+}
+
+// `parseTriple` specialized for `Pattern`. Returns false without consuming
+// `token` when the vertex does not match `Pattern` exactly, or when an index
+// needs the warnings or errors of `parseTriple`. The caller must then fall
+// back to `parseTriple`.
+template <FacePattern Pattern>
+static inline bool parseTripleAs(const char **token, const char *end,
+                                 int vsize, int vnsize, int vtsize,
+                                 vertex_index_t *ret) {
+  const char *p = (*token);
+  vertex_index_t raw;
+  if (!parseRawTripleAs<Pattern>(&p, end, &raw) ||
+      !resolveTriple(raw, vsize, vnsize, vtsize, ret)) {
+    return false;
+  }
+  (*token) = p;
+  return true;
+}
+
 // Parse raw triples: i, i/j/k, i//k, i/j
 static vertex_index_t parseRawTriple(const char **token) {
   vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
@@ -1381,6 +2559,7 @@ static void InitTexOpt(texture_option_t *texopt, const bool is_bump) {
   texopt->turbulence[2] = static_cast<real_t>(0.0);
   texopt->texture_resolution = -1;
   texopt->type = TEXTURE_TYPE_NONE;
+  texopt->colorspace.clear();
 }
 
 static void InitMaterial(material_t *material) {
@@ -1478,56 +2657,311 @@ inline TinyObjPoint WorldToLocal(const TinyObjPoint &a, const TinyObjPoint &u,
   return TinyObjPoint(dot(a, u), dot(a, v), dot(a, w));
 }
 
-// TODO(syoyo): refactor function.
-static bool exportGroupsToShape(shape_t *shape, const PrimGroup &prim_group,
-                                const std::vector<tag_t> &tags,
-                                const int material_id, const std::string &name,
-                                bool triangulate, const std::vector<real_t> &v,
-                                std::string *warn) {
-  if (prim_group.IsEmpty()) {
-    return false;
+// Append `*value` to `v`. `*value` is moved with C++11(and is left in a valid
+// but unspecified state), so its arrays and strings are not allocated again.
+template <typename T, typename Alloc>
+static inline void pushBackMove(std::vector<T, Alloc> *v, T *value) {
+#ifdef TINYOBJLOADER_HAS_MOVE
+  v->push_back(std::move(*value));
+#else
+  v->push_back(*value);
+#endif
+}
+
+// Reserve space to append `n` elements. Grows geometrically so repeated calls
+// for the same vector(e.g. `usemtl` in a shape) stay amortized O(1).
+template <typename T, typename Alloc>
+static inline void reserveAppend(std::vector<T, Alloc> *v, size_t n) {
+  size_t required = v->size() + n;
+  if (required > v->capacity()) {
+    size_t grown = 2 * v->capacity();
+    v->reserve(required > grown ? required : grown);
   }
+}
 
-  shape->name = name;
+// Triangulate(when `triangulate` is true) and flatten faces
+// [face_begin, face_end) of `prim_group`, and append them to `mesh`.
+static void triangulateFaces(mesh_t *mesh, const PrimGroup &prim_group,
+                             size_t face_begin, size_t face_end,
+                             const int material_id, bool triangulate,
+                             const vector_of<real_t>::type &v, std::string *warn) {
+#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+  // Scratch buffers reused for every polygon.
+  using Point = std::array<real_t, 2>;
 
-  // polygon
-  if (!prim_group.faceGroup.empty()) {
-    // Flatten vertices and indices
-    for (size_t i = 0; i < prim_group.faceGroup.size(); i++) {
-      const face_t &face = prim_group.faceGroup[i];
+  // first polyline define the main polygon.
+  // following polylines define holes(not used in tinyobj).
+  std::vector<std::vector<Point> > polygon(1);
 
-      size_t npolys = face.vertex_indices.size();
+  mapbox::detail::Earcut<uint32_t> earcut;
+#else
+  // Scratch buffer for ear clipping.
+  vector_of<vertex_index_t>::type remainingFace;
+#endif
 
-      if (npolys < 3) {
-        // Face must have 3+ vertices.
-        if (warn) {
-          (*warn) += "Degenerated face found\n.";
-        }
-        continue;
+  // Flatten vertices and indices
+  for (size_t i = face_begin; i < face_end; i++) {
+    const face_t &face = prim_group.faceGroup[i];
+
+    size_t npolys = face.num_vertices;
+
+    if (npolys < 3) {
+      // Face must have 3+ vertices.
+      if (warn) {
+        (*warn) += "Degenerated face found\n.";
       }
+      continue;
+    }
+
+    const vertex_index_t *fv = &prim_group.faceIndices[face.vertex_offset];
+
+    if (triangulate && npolys != 3) {
+      if (npolys == 4) {
+        vertex_index_t i0 = fv[0];
+        vertex_index_t i1 = fv[1];
+        vertex_index_t i2 = fv[2];
+        vertex_index_t i3 = fv[3];
+
+        size_t vi0 = size_t(i0.v_idx);
+        size_t vi1 = size_t(i1.v_idx);
+        size_t vi2 = size_t(i2.v_idx);
+        size_t vi3 = size_t(i3.v_idx);
+
+        if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) ||
+            ((3 * vi2 + 2) >= v.size()) || ((3 * vi3 + 2) >= v.size())) {
+          // Invalid triangle.
+          // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
+          if (warn) {
+            (*warn) += "Face with invalid vertex index found.\n";
+          }
+          continue;
+        }
+
+        real_t v0x = v[vi0 * 3 + 0];
+        real_t v0y = v[vi0 * 3 + 1];
+        real_t v0z = v[vi0 * 3 + 2];
+        real_t v1x = v[vi1 * 3 + 0];
+        real_t v1y = v[vi1 * 3 + 1];
+        real_t v1z = v[vi1 * 3 + 2];
+        real_t v2x = v[vi2 * 3 + 0];
+        real_t v2y = v[vi2 * 3 + 1];
+        real_t v2z = v[vi2 * 3 + 2];
+        real_t v3x = v[vi3 * 3 + 0];
+        real_t v3y = v[vi3 * 3 + 1];
+        real_t v3z = v[vi3 * 3 + 2];
+
+        // There are two candidates to split the quad into two triangles.
+        //
+        // Choose the shortest edge.
+        // TODO: Is it better to determine the edge to split by calculating
+        // the area of each triangle?
+        //
+        // +---+
+        // |\  |
+        // | \ |
+        // |  \|
+        // +---+
+        //
+        // +---+
+        // |  /|
+        // | / |
+        // |/  |
+        // +---+
+
+        real_t e02x = v2x - v0x;
+        real_t e02y = v2y - v0y;
+        real_t e02z = v2z - v0z;
+        real_t e13x = v3x - v1x;
+        real_t e13y = v3y - v1y;
+        real_t e13z = v3z - v1z;
+
+        real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+        index_t idx0, idx1, idx2, idx3;
+
+        idx0.vertex_index = i0.v_idx;
+        idx0.normal_index = i0.vn_idx;
+        idx0.texcoord_index = i0.vt_idx;
+        idx1.vertex_index = i1.v_idx;
+        idx1.normal_index = i1.vn_idx;
+        idx1.texcoord_index = i1.vt_idx;
+        idx2.vertex_index = i2.v_idx;
+        idx2.normal_index = i2.vn_idx;
+        idx2.texcoord_index = i2.vt_idx;
+        idx3.vertex_index = i3.v_idx;
+        idx3.normal_index = i3.vn_idx;
+        idx3.texcoord_index = i3.vt_idx;
+
+        if (sqr02 < sqr13) {
+          // [0, 1, 2], [0, 2, 3]
+          mesh->indices.push_back(idx0);
+          mesh->indices.push_back(idx1);
+          mesh->indices.push_back(idx2);
+
+          mesh->indices.push_back(idx0);
+          mesh->indices.push_back(idx2);
+          mesh->indices.push_back(idx3);
+        } else {
+          // [0, 1, 3], [1, 2, 3]
+          mesh->indices.push_back(idx0);
+          mesh->indices.push_back(idx1);
+          mesh->indices.push_back(idx3);
+
+          mesh->indices.push_back(idx1);
+          mesh->indices.push_back(idx2);
+          mesh->indices.push_back(idx3);
+        }
+
+        // Two triangle faces
+        mesh->num_face_vertices.push_back(3);
+        mesh->num_face_vertices.push_back(3);
+
+        mesh->material_ids.push_back(material_id);
+        mesh->material_ids.push_back(material_id);
+
+        mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+        mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+
+      } else {
+#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+        vertex_index_t i0 = fv[0];
+        vertex_index_t i0_2 = i0;
+
+        // TMW change: Find the normal axis of the polygon using Newell's
+        // method
+        TinyObjPoint n;
+        for (size_t k = 0; k < npolys; ++k) {
+          i0 = fv[k % npolys];
+          size_t vi0 = size_t(i0.v_idx);
+
+          size_t j = (k + 1) % npolys;
+          i0_2 = fv[j];
+          size_t vi0_2 = size_t(i0_2.v_idx);
+
+          real_t v0x = v[vi0 * 3 + 0];
+          real_t v0y = v[vi0 * 3 + 1];
+          real_t v0z = v[vi0 * 3 + 2];
+
+          real_t v0x_2 = v[vi0_2 * 3 + 0];
+          real_t v0y_2 = v[vi0_2 * 3 + 1];
+          real_t v0z_2 = v[vi0_2 * 3 + 2];
+
+          const TinyObjPoint point1(v0x, v0y, v0z);
+          const TinyObjPoint point2(v0x_2, v0y_2, v0z_2);
+
+          TinyObjPoint a(point1.x - point2.x, point1.y - point2.y,
+                         point1.z - point2.z);
+          TinyObjPoint b(point1.x + point2.x, point1.y + point2.y,
+                         point1.z + point2.z);
+
+          n.x += (a.y * b.z);
+          n.y += (a.z * b.x);
+          n.z += (a.x * b.y);
+        }
+        real_t length_n = GetLength(n);
+        // Check if zero length normal
+        if (length_n <= 0) {
+          continue;
+        }
+        // Negative is to flip the normal to the correct direction
+        real_t inv_length = -real_t(1.0) / length_n;
+        n.x *= inv_length;
+        n.y *= inv_length;
+        n.z *= inv_length;
+
+        TinyObjPoint axis_w, axis_v, axis_u;
+        axis_w = n;
+        TinyObjPoint a;
+        if (std::fabs(axis_w.x) > real_t(0.9999999)) {
+          a = TinyObjPoint(0, 1, 0);
+        } else {
+          a = TinyObjPoint(1, 0, 0);
+        }
+        axis_v = Normalize(cross(axis_w, a));
+        axis_u = cross(axis_w, axis_v);
+        std::vector<Point> &polyline = polygon[0];
+        polyline.clear();
+
+        // TMW change: Find best normal and project v0x and v0y to those
+        // coordinates, instead of picking a plane aligned with an axis (which
+        // can flip polygons).
+
+        // Fill polygon data(facevarying vertices).
+        for (size_t k = 0; k < npolys; k++) {
+          i0 = fv[k];
+          size_t vi0 = size_t(i0.v_idx);
+
+          assert(((3 * vi0 + 2) < v.size()));
+
+          real_t v0x = v[vi0 * 3 + 0];
+          real_t v0y = v[vi0 * 3 + 1];
+          real_t v0z = v[vi0 * 3 + 2];
+
+          TinyObjPoint polypoint(v0x, v0y, v0z);
+          TinyObjPoint loc = WorldToLocal(polypoint, axis_u, axis_v, axis_w);
 
-      if (triangulate && npolys != 3) {
-        if (npolys == 4) {
-          vertex_index_t i0 = face.vertex_indices[0];
-          vertex_index_t i1 = face.vertex_indices[1];
-          vertex_index_t i2 = face.vertex_indices[2];
-          vertex_index_t i3 = face.vertex_indices[3];
+          polyline.push_back({loc.x, loc.y});
+        }
+
+        earcut(polygon);
+        const std::vector<uint32_t> &indices = earcut.indices;
+        // => result = 3 * faces, clockwise
+
+        assert(indices.size() % 3 == 0);
+
+        // Reconstruct vertex_index_t
+        for (size_t k = 0; k < indices.size() / 3; k++) {
+          {
+            index_t idx0, idx1, idx2;
+            idx0.vertex_index = fv[indices[3 * k + 0]].v_idx;
+            idx0.normal_index =
+                fv[indices[3 * k + 0]].vn_idx;
+            idx0.texcoord_index =
+                fv[indices[3 * k + 0]].vt_idx;
+            idx1.vertex_index = fv[indices[3 * k + 1]].v_idx;
+            idx1.normal_index =
+                fv[indices[3 * k + 1]].vn_idx;
+            idx1.texcoord_index =
+                fv[indices[3 * k + 1]].vt_idx;
+            idx2.vertex_index = fv[indices[3 * k + 2]].v_idx;
+            idx2.normal_index =
+                fv[indices[3 * k + 2]].vn_idx;
+            idx2.texcoord_index =
+                fv[indices[3 * k + 2]].vt_idx;
+
+            mesh->indices.push_back(idx0);
+            mesh->indices.push_back(idx1);
+            mesh->indices.push_back(idx2);
+
+            mesh->num_face_vertices.push_back(3);
+            mesh->material_ids.push_back(material_id);
+            mesh->smoothing_group_ids.push_back(
+                face.smoothing_group_id);
+          }
+        }
 
+#else  // Built-in ear clipping triangulation
+        vertex_index_t i0 = fv[0];
+        vertex_index_t i1(-1);
+        vertex_index_t i2 = fv[1];
+
+        // find the two axes to work in
+        size_t axes[2] = {1, 2};
+        for (size_t k = 0; k < npolys; ++k) {
+          i0 = fv[(k + 0) % npolys];
+          i1 = fv[(k + 1) % npolys];
+          i2 = fv[(k + 2) % npolys];
           size_t vi0 = size_t(i0.v_idx);
           size_t vi1 = size_t(i1.v_idx);
           size_t vi2 = size_t(i2.v_idx);
-          size_t vi3 = size_t(i3.v_idx);
 
           if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) ||
-              ((3 * vi2 + 2) >= v.size()) || ((3 * vi3 + 2) >= v.size())) {
+              ((3 * vi2 + 2) >= v.size())) {
             // Invalid triangle.
             // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
-            if (warn) {
-              (*warn) += "Face with invalid vertex index found.\n";
-            }
             continue;
           }
-
           real_t v0x = v[vi0 * 3 + 0];
           real_t v0y = v[vi0 * 3 + 1];
           real_t v0z = v[vi0 * 3 + 2];
@@ -1537,458 +2971,395 @@ static bool exportGroupsToShape(shape_t *shape, const PrimGroup &prim_group,
           real_t v2x = v[vi2 * 3 + 0];
           real_t v2y = v[vi2 * 3 + 1];
           real_t v2z = v[vi2 * 3 + 2];
-          real_t v3x = v[vi3 * 3 + 0];
-          real_t v3y = v[vi3 * 3 + 1];
-          real_t v3z = v[vi3 * 3 + 2];
-
-          // There are two candidates to split the quad into two triangles.
-          //
-          // Choose the shortest edge.
-          // TODO: Is it better to determine the edge to split by calculating
-          // the area of each triangle?
-          //
-          // +---+
-          // |\  |
-          // | \ |
-          // |  \|
-          // +---+
-          //
-          // +---+
-          // |  /|
-          // | / |
-          // |/  |
-          // +---+
-
-          real_t e02x = v2x - v0x;
-          real_t e02y = v2y - v0y;
-          real_t e02z = v2z - v0z;
-          real_t e13x = v3x - v1x;
-          real_t e13y = v3y - v1y;
-          real_t e13z = v3z - v1z;
-
-          real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
-          real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
-
-          index_t idx0, idx1, idx2, idx3;
-
-          idx0.vertex_index = i0.v_idx;
-          idx0.normal_index = i0.vn_idx;
-          idx0.texcoord_index = i0.vt_idx;
-          idx1.vertex_index = i1.v_idx;
-          idx1.normal_index = i1.vn_idx;
-          idx1.texcoord_index = i1.vt_idx;
-          idx2.vertex_index = i2.v_idx;
-          idx2.normal_index = i2.vn_idx;
-          idx2.texcoord_index = i2.vt_idx;
-          idx3.vertex_index = i3.v_idx;
-          idx3.normal_index = i3.vn_idx;
-          idx3.texcoord_index = i3.vt_idx;
-
-          if (sqr02 < sqr13) {
-            // [0, 1, 2], [0, 2, 3]
-            shape->mesh.indices.push_back(idx0);
-            shape->mesh.indices.push_back(idx1);
-            shape->mesh.indices.push_back(idx2);
-
-            shape->mesh.indices.push_back(idx0);
-            shape->mesh.indices.push_back(idx2);
-            shape->mesh.indices.push_back(idx3);
-          } else {
-            // [0, 1, 3], [1, 2, 3]
-            shape->mesh.indices.push_back(idx0);
-            shape->mesh.indices.push_back(idx1);
-            shape->mesh.indices.push_back(idx3);
-
-            shape->mesh.indices.push_back(idx1);
-            shape->mesh.indices.push_back(idx2);
-            shape->mesh.indices.push_back(idx3);
+          real_t e0x = v1x - v0x;
+          real_t e0y = v1y - v0y;
+          real_t e0z = v1z - v0z;
+          real_t e1x = v2x - v1x;
+          real_t e1y = v2y - v1y;
+          real_t e1z = v2z - v1z;
+          real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+          real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+          real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+          const real_t epsilon = std::numeric_limits<real_t>::epsilon();
+          // std::cout << "cx " << cx << ", cy " << cy << ", cz " << cz <<
+          // "\n";
+          if (cx > epsilon || cy > epsilon || cz > epsilon) {
+            // std::cout << "corner\n";
+            // found a corner
+            if (cx > cy && cx > cz) {
+              // std::cout << "pattern0\n";
+            } else {
+              // std::cout << "axes[0] = 0\n";
+              axes[0] = 0;
+              if (cz > cx && cz > cy) {
+                // std::cout << "axes[1] = 1\n";
+                axes[1] = 1;
+              }
+            }
+            break;
           }
+        }
 
-          // Two triangle faces
-          shape->mesh.num_face_vertices.push_back(3);
-          shape->mesh.num_face_vertices.push_back(3);
-
-          shape->mesh.material_ids.push_back(material_id);
-          shape->mesh.material_ids.push_back(material_id);
-
-          shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-          shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-
-        } else {
-#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
-          vertex_index_t i0 = face.vertex_indices[0];
-          vertex_index_t i0_2 = i0;
-
-          // TMW change: Find the normal axis of the polygon using Newell's
-          // method
-          TinyObjPoint n;
-          for (size_t k = 0; k < npolys; ++k) {
-            i0 = face.vertex_indices[k % npolys];
-            size_t vi0 = size_t(i0.v_idx);
-
-            size_t j = (k + 1) % npolys;
-            i0_2 = face.vertex_indices[j];
-            size_t vi0_2 = size_t(i0_2.v_idx);
-
-            real_t v0x = v[vi0 * 3 + 0];
-            real_t v0y = v[vi0 * 3 + 1];
-            real_t v0z = v[vi0 * 3 + 2];
-
-            real_t v0x_2 = v[vi0_2 * 3 + 0];
-            real_t v0y_2 = v[vi0_2 * 3 + 1];
-            real_t v0z_2 = v[vi0_2 * 3 + 2];
-
-            const TinyObjPoint point1(v0x, v0y, v0z);
-            const TinyObjPoint point2(v0x_2, v0y_2, v0z_2);
-
-            TinyObjPoint a(point1.x - point2.x, point1.y - point2.y,
-                           point1.z - point2.z);
-            TinyObjPoint b(point1.x + point2.x, point1.y + point2.y,
-                           point1.z + point2.z);
-
-            n.x += (a.y * b.z);
-            n.y += (a.z * b.x);
-            n.z += (a.x * b.y);
-          }
-          real_t length_n = GetLength(n);
-          // Check if zero length normal
-          if (length_n <= 0) {
-            continue;
+        remainingFace.assign(fv, fv + npolys);
+        size_t guess_vert = 0;
+        vertex_index_t ind[3];
+        real_t vx[3];
+        real_t vy[3];
+
+        // How many iterations can we do without decreasing the remaining
+        // vertices.
+        size_t remainingIterations = face.num_vertices;
+        size_t previousRemainingVertices =
+            remainingFace.size();
+
+        while (remainingFace.size() > 3 &&
+               remainingIterations > 0) {
+          // std::cout << "remainingIterations " << remainingIterations <<
+          // "\n";
+
+          npolys = remainingFace.size();
+          if (guess_vert >= npolys) {
+            guess_vert -= npolys;
           }
-          // Negative is to flip the normal to the correct direction
-          real_t inv_length = -real_t(1.0) / length_n;
-          n.x *= inv_length;
-          n.y *= inv_length;
-          n.z *= inv_length;
-
-          TinyObjPoint axis_w, axis_v, axis_u;
-          axis_w = n;
-          TinyObjPoint a;
-          if (std::fabs(axis_w.x) > real_t(0.9999999)) {
-            a = TinyObjPoint(0, 1, 0);
+
+          if (previousRemainingVertices != npolys) {
+            // The number of remaining vertices decreased. Reset counters.
+            previousRemainingVertices = npolys;
+            remainingIterations = npolys;
           } else {
-            a = TinyObjPoint(1, 0, 0);
+            // We didn't consume a vertex on previous iteration, reduce the
+            // available iterations.
+            remainingIterations--;
           }
-          axis_v = Normalize(cross(axis_w, a));
-          axis_u = cross(axis_w, axis_v);
-          using Point = std::array<real_t, 2>;
-
-          // first polyline define the main polygon.
-          // following polylines define holes(not used in tinyobj).
-          std::vector<std::vector<Point> > polygon;
-
-          std::vector<Point> polyline;
-
-          // TMW change: Find best normal and project v0x and v0y to those
-          // coordinates, instead of picking a plane aligned with an axis (which
-          // can flip polygons).
-
-          // Fill polygon data(facevarying vertices).
-          for (size_t k = 0; k < npolys; k++) {
-            i0 = face.vertex_indices[k];
-            size_t vi0 = size_t(i0.v_idx);
 
-            assert(((3 * vi0 + 2) < v.size()));
-
-            real_t v0x = v[vi0 * 3 + 0];
-            real_t v0y = v[vi0 * 3 + 1];
-            real_t v0z = v[vi0 * 3 + 2];
-
-            TinyObjPoint polypoint(v0x, v0y, v0z);
-            TinyObjPoint loc = WorldToLocal(polypoint, axis_u, axis_v, axis_w);
+          for (size_t k = 0; k < 3; k++) {
+            ind[k] = remainingFace[(guess_vert + k) % npolys];
+            size_t vi = size_t(ind[k].v_idx);
+            if (((vi * 3 + axes[0]) >= v.size()) ||
+                ((vi * 3 + axes[1]) >= v.size())) {
+              // ???
+              vx[k] = static_cast<real_t>(0.0);
+              vy[k] = static_cast<real_t>(0.0);
+            } else {
+              vx[k] = v[vi * 3 + axes[0]];
+              vy[k] = v[vi * 3 + axes[1]];
+            }
+          }
 
-            polyline.push_back({loc.x, loc.y});
+          //
+          // area is calculated per face
+          //
+          real_t e0x = vx[1] - vx[0];
+          real_t e0y = vy[1] - vy[0];
+          real_t e1x = vx[2] - vx[1];
+          real_t e1y = vy[2] - vy[1];
+          real_t cross = e0x * e1y - e0y * e1x;
+          // std::cout << "axes = " << axes[0] << ", " << axes[1] << "\n";
+          // std::cout << "e0x, e0y, e1x, e1y " << e0x << ", " << e0y << ", "
+          // << e1x << ", " << e1y << "\n";
+
+          real_t area =
+              (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<real_t>(0.5);
+          // std::cout << "cross " << cross << ", area " << area << "\n";
+          // if an internal angle
+          if (cross * area < static_cast<real_t>(0.0)) {
+            // std::cout << "internal \n";
+            guess_vert += 1;
+            // std::cout << "guess vert : " << guess_vert << "\n";
+            continue;
           }
 
-          polygon.push_back(polyline);
-          std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
-          // => result = 3 * faces, clockwise
-
-          assert(indices.size() % 3 == 0);
-
-          // Reconstruct vertex_index_t
-          for (size_t k = 0; k < indices.size() / 3; k++) {
-            {
-              index_t idx0, idx1, idx2;
-              idx0.vertex_index = face.vertex_indices[indices[3 * k + 0]].v_idx;
-              idx0.normal_index =
-                  face.vertex_indices[indices[3 * k + 0]].vn_idx;
-              idx0.texcoord_index =
-                  face.vertex_indices[indices[3 * k + 0]].vt_idx;
-              idx1.vertex_index = face.vertex_indices[indices[3 * k + 1]].v_idx;
-              idx1.normal_index =
-                  face.vertex_indices[indices[3 * k + 1]].vn_idx;
-              idx1.texcoord_index =
-                  face.vertex_indices[indices[3 * k + 1]].vt_idx;
-              idx2.vertex_index = face.vertex_indices[indices[3 * k + 2]].v_idx;
-              idx2.normal_index =
-                  face.vertex_indices[indices[3 * k + 2]].vn_idx;
-              idx2.texcoord_index =
-                  face.vertex_indices[indices[3 * k + 2]].vt_idx;
-
-              shape->mesh.indices.push_back(idx0);
-              shape->mesh.indices.push_back(idx1);
-              shape->mesh.indices.push_back(idx2);
-
-              shape->mesh.num_face_vertices.push_back(3);
-              shape->mesh.material_ids.push_back(material_id);
-              shape->mesh.smoothing_group_ids.push_back(
-                  face.smoothing_group_id);
+          // check all other verts in case they are inside this triangle
+          bool overlap = false;
+          for (size_t otherVert = 3; otherVert < npolys; ++otherVert) {
+            size_t idx = (guess_vert + otherVert) % npolys;
+
+            if (idx >= remainingFace.size()) {
+              // std::cout << "???0\n";
+              // ???
+              continue;
             }
-          }
 
-#else  // Built-in ear clipping triangulation
-          vertex_index_t i0 = face.vertex_indices[0];
-          vertex_index_t i1(-1);
-          vertex_index_t i2 = face.vertex_indices[1];
-
-          // find the two axes to work in
-          size_t axes[2] = {1, 2};
-          for (size_t k = 0; k < npolys; ++k) {
-            i0 = face.vertex_indices[(k + 0) % npolys];
-            i1 = face.vertex_indices[(k + 1) % npolys];
-            i2 = face.vertex_indices[(k + 2) % npolys];
-            size_t vi0 = size_t(i0.v_idx);
-            size_t vi1 = size_t(i1.v_idx);
-            size_t vi2 = size_t(i2.v_idx);
-
-            if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) ||
-                ((3 * vi2 + 2) >= v.size())) {
-              // Invalid triangle.
-              // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
+            size_t ovi = size_t(remainingFace[idx].v_idx);
+
+            if (((ovi * 3 + axes[0]) >= v.size()) ||
+                ((ovi * 3 + axes[1]) >= v.size())) {
+              // std::cout << "???1\n";
+              // ???
               continue;
             }
-            real_t v0x = v[vi0 * 3 + 0];
-            real_t v0y = v[vi0 * 3 + 1];
-            real_t v0z = v[vi0 * 3 + 2];
-            real_t v1x = v[vi1 * 3 + 0];
-            real_t v1y = v[vi1 * 3 + 1];
-            real_t v1z = v[vi1 * 3 + 2];
-            real_t v2x = v[vi2 * 3 + 0];
-            real_t v2y = v[vi2 * 3 + 1];
-            real_t v2z = v[vi2 * 3 + 2];
-            real_t e0x = v1x - v0x;
-            real_t e0y = v1y - v0y;
-            real_t e0z = v1z - v0z;
-            real_t e1x = v2x - v1x;
-            real_t e1y = v2y - v1y;
-            real_t e1z = v2z - v1z;
-            real_t cx = std::fabs(e0y * e1z - e0z * e1y);
-            real_t cy = std::fabs(e0z * e1x - e0x * e1z);
-            real_t cz = std::fabs(e0x * e1y - e0y * e1x);
-            const real_t epsilon = std::numeric_limits<real_t>::epsilon();
-            // std::cout << "cx " << cx << ", cy " << cy << ", cz " << cz <<
-            // "\n";
-            if (cx > epsilon || cy > epsilon || cz > epsilon) {
-              // std::cout << "corner\n";
-              // found a corner
-              if (cx > cy && cx > cz) {
-                // std::cout << "pattern0\n";
-              } else {
-                // std::cout << "axes[0] = 0\n";
-                axes[0] = 0;
-                if (cz > cx && cz > cy) {
-                  // std::cout << "axes[1] = 1\n";
-                  axes[1] = 1;
-                }
-              }
+            real_t tx = v[ovi * 3 + axes[0]];
+            real_t ty = v[ovi * 3 + axes[1]];
+            if (pnpoly(3, vx, vy, tx, ty)) {
+              // std::cout << "overlap\n";
+              overlap = true;
               break;
             }
           }
 
-          face_t remainingFace = face;  // copy
-          size_t guess_vert = 0;
-          vertex_index_t ind[3];
-          real_t vx[3];
-          real_t vy[3];
-
-          // How many iterations can we do without decreasing the remaining
-          // vertices.
-          size_t remainingIterations = face.vertex_indices.size();
-          size_t previousRemainingVertices =
-              remainingFace.vertex_indices.size();
-
-          while (remainingFace.vertex_indices.size() > 3 &&
-                 remainingIterations > 0) {
-            // std::cout << "remainingIterations " << remainingIterations <<
-            // "\n";
-
-            npolys = remainingFace.vertex_indices.size();
-            if (guess_vert >= npolys) {
-              guess_vert -= npolys;
-            }
+          if (overlap) {
+            // std::cout << "overlap2\n";
+            guess_vert += 1;
+            continue;
+          }
 
-            if (previousRemainingVertices != npolys) {
-              // The number of remaining vertices decreased. Reset counters.
-              previousRemainingVertices = npolys;
-              remainingIterations = npolys;
-            } else {
-              // We didn't consume a vertex on previous iteration, reduce the
-              // available iterations.
-              remainingIterations--;
-            }
+          // this triangle is an ear
+          {
+            index_t idx0, idx1, idx2;
+            idx0.vertex_index = ind[0].v_idx;
+            idx0.normal_index = ind[0].vn_idx;
+            idx0.texcoord_index = ind[0].vt_idx;
+            idx1.vertex_index = ind[1].v_idx;
+            idx1.normal_index = ind[1].vn_idx;
+            idx1.texcoord_index = ind[1].vt_idx;
+            idx2.vertex_index = ind[2].v_idx;
+            idx2.normal_index = ind[2].vn_idx;
+            idx2.texcoord_index = ind[2].vt_idx;
+
+            mesh->indices.push_back(idx0);
+            mesh->indices.push_back(idx1);
+            mesh->indices.push_back(idx2);
+
+            mesh->num_face_vertices.push_back(3);
+            mesh->material_ids.push_back(material_id);
+            mesh->smoothing_group_ids.push_back(
+                face.smoothing_group_id);
+          }
 
-            for (size_t k = 0; k < 3; k++) {
-              ind[k] = remainingFace.vertex_indices[(guess_vert + k) % npolys];
-              size_t vi = size_t(ind[k].v_idx);
-              if (((vi * 3 + axes[0]) >= v.size()) ||
-                  ((vi * 3 + axes[1]) >= v.size())) {
-                // ???
-                vx[k] = static_cast<real_t>(0.0);
-                vy[k] = static_cast<real_t>(0.0);
-              } else {
-                vx[k] = v[vi * 3 + axes[0]];
-                vy[k] = v[vi * 3 + axes[1]];
-              }
-            }
+          // remove v1 from the list
+          size_t removed_vert_index = (guess_vert + 1) % npolys;
+          while (removed_vert_index + 1 < npolys) {
+            remainingFace[removed_vert_index] =
+                remainingFace[removed_vert_index + 1];
+            removed_vert_index += 1;
+          }
+          remainingFace.pop_back();
+        }
 
-            //
-            // area is calculated per face
-            //
-            real_t e0x = vx[1] - vx[0];
-            real_t e0y = vy[1] - vy[0];
-            real_t e1x = vx[2] - vx[1];
-            real_t e1y = vy[2] - vy[1];
-            real_t cross = e0x * e1y - e0y * e1x;
-            // std::cout << "axes = " << axes[0] << ", " << axes[1] << "\n";
-            // std::cout << "e0x, e0y, e1x, e1y " << e0x << ", " << e0y << ", "
-            // << e1x << ", " << e1y << "\n";
-
-            real_t area =
-                (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<real_t>(0.5);
-            // std::cout << "cross " << cross << ", area " << area << "\n";
-            // if an internal angle
-            if (cross * area < static_cast<real_t>(0.0)) {
-              // std::cout << "internal \n";
-              guess_vert += 1;
-              // std::cout << "guess vert : " << guess_vert << "\n";
-              continue;
-            }
+        // std::cout << "remainingFace.vi.size = " <<
+        // remainingFace.size() << "\n";
+        if (remainingFace.size() == 3) {
+          i0 = remainingFace[0];
+          i1 = remainingFace[1];
+          i2 = remainingFace[2];
+          {
+            index_t idx0, idx1, idx2;
+            idx0.vertex_index = i0.v_idx;
+            idx0.normal_index = i0.vn_idx;
+            idx0.texcoord_index = i0.vt_idx;
+            idx1.vertex_index = i1.v_idx;
+            idx1.normal_index = i1.vn_idx;
+            idx1.texcoord_index = i1.vt_idx;
+            idx2.vertex_index = i2.v_idx;
+            idx2.normal_index = i2.vn_idx;
+            idx2.texcoord_index = i2.vt_idx;
+
+            mesh->indices.push_back(idx0);
+            mesh->indices.push_back(idx1);
+            mesh->indices.push_back(idx2);
+
+            mesh->num_face_vertices.push_back(3);
+            mesh->material_ids.push_back(material_id);
+            mesh->smoothing_group_ids.push_back(
+                face.smoothing_group_id);
+          }
+        }
+#endif
+      }  // npolys
+    } else {
+      for (size_t k = 0; k < npolys; k++) {
+        index_t idx;
+        idx.vertex_index = fv[k].v_idx;
+        idx.normal_index = fv[k].vn_idx;
+        idx.texcoord_index = fv[k].vt_idx;
+        mesh->indices.push_back(idx);
+      }
 
-            // check all other verts in case they are inside this triangle
-            bool overlap = false;
-            for (size_t otherVert = 3; otherVert < npolys; ++otherVert) {
-              size_t idx = (guess_vert + otherVert) % npolys;
+      mesh->num_face_vertices.push_back(
+          static_cast<unsigned int>(npolys));
+      mesh->material_ids.push_back(material_id);  // per face
+      mesh->smoothing_group_ids.push_back(
+          face.smoothing_group_id);  // per face
+    }
+  }
+}
 
-              if (idx >= remainingFace.vertex_indices.size()) {
-                // std::cout << "???0\n";
-                // ???
-                continue;
-              }
+#ifdef TINYOBJLOADER_HAS_THREADS
+// Each thread triangulates at least this number of faces. Smaller groups are
+// triangulated on the calling thread, since starting threads costs more.
+static const size_t kMinTriangulateFacesPerThread = 4096;
 
-              size_t ovi = size_t(remainingFace.vertex_indices[idx].v_idx);
+struct TriangulatedChunk {
+  mesh_t mesh;
+  std::string warn;
+};
 
-              if (((ovi * 3 + axes[0]) >= v.size()) ||
-                  ((ovi * 3 + axes[1]) >= v.size())) {
-                // std::cout << "???1\n";
-                // ???
-                continue;
-              }
-              real_t tx = v[ovi * 3 + axes[0]];
-              real_t ty = v[ovi * 3 + axes[1]];
-              if (pnpoly(3, vx, vy, tx, ty)) {
-                // std::cout << "overlap\n";
-                overlap = true;
-                break;
-              }
-            }
+// Triangulate faces of `prim_group` on `num_chunks` threads and append them to
+// `mesh`. Faces are split into contiguous ranges of about the same number of
+// face vertices. Each thread triangulates its range into its own buffers, and
+// the results are then copied to precomputed offsets of `mesh` in order, so
+// the result is identical to `triangulateFaces` on a single thread.
+static void triangulateFacesParallel(mesh_t *mesh, const PrimGroup &prim_group,
+                                     size_t num_chunks, const int material_id,
+                                     const vector_of<real_t>::type &v,
+                                     std::string *warn) {
+  const vector_of<face_t>::type &faces = prim_group.faceGroup;
+  const size_t num_face_vertices = prim_group.faceIndices.size();
+
+  // Faces are stored in the order of `vertex_offset`.
+  std::vector<size_t> face_begins(num_chunks + 1);
+  face_begins[0] = 0;
+  for (size_t t = 1; t < num_chunks; t++) {
+    const size_t offset = (num_face_vertices / num_chunks) * t;
+    face_begins[t] = size_t(
+        std::lower_bound(faces.begin() + std::ptrdiff_t(face_begins[t - 1]),
+                         faces.end(), offset,
+                         [](const face_t &face, size_t value) {
+                           return face.vertex_offset < value;
+                         }) -
+        faces.begin());
+  }
+  face_begins[num_chunks] = faces.size();
+
+  std::vector<TriangulatedChunk> chunks(num_chunks);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < num_chunks; t++) {
+    workers.push_back(std::thread([&, t]() {
+      triangulateFaces(&chunks[t].mesh, prim_group, face_begins[t],
+                       face_begins[t + 1], material_id,
+                       /* triangulate */ true, v, &chunks[t].warn);
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
 
-            if (overlap) {
-              // std::cout << "overlap2\n";
-              guess_vert += 1;
-              continue;
-            }
+  std::vector<size_t> index_offsets(num_chunks);
+  std::vector<size_t> face_offsets(num_chunks);
+  size_t num_indices = mesh->indices.size();
+  size_t num_faces = mesh->num_face_vertices.size();
+  for (size_t t = 0; t < num_chunks; t++) {
+    index_offsets[t] = num_indices;
+    face_offsets[t] = num_faces;
+    num_indices += chunks[t].mesh.indices.size();
+    num_faces += chunks[t].mesh.num_face_vertices.size();
+  }
+  mesh->indices.resize(num_indices);
+  mesh->num_face_vertices.resize(num_faces);
+  mesh->material_ids.resize(num_faces);
+  mesh->smoothing_group_ids.resize(num_faces);
+
+  workers.clear();
+  for (size_t t = 0; t < num_chunks; t++) {
+    workers.push_back(std::thread([&, t]() {
+      const mesh_t &src = chunks[t].mesh;
+      std::copy(src.indices.begin(), src.indices.end(),
+                mesh->indices.begin() + std::ptrdiff_t(index_offsets[t]));
+      std::copy(
+          src.num_face_vertices.begin(), src.num_face_vertices.end(),
+          mesh->num_face_vertices.begin() + std::ptrdiff_t(face_offsets[t]));
+      std::copy(src.material_ids.begin(), src.material_ids.end(),
+                mesh->material_ids.begin() + std::ptrdiff_t(face_offsets[t]));
+      std::copy(
+          src.smoothing_group_ids.begin(), src.smoothing_group_ids.end(),
+          mesh->smoothing_group_ids.begin() + std::ptrdiff_t(face_offsets[t]));
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
 
-            // this triangle is an ear
-            {
-              index_t idx0, idx1, idx2;
-              idx0.vertex_index = ind[0].v_idx;
-              idx0.normal_index = ind[0].vn_idx;
-              idx0.texcoord_index = ind[0].vt_idx;
-              idx1.vertex_index = ind[1].v_idx;
-              idx1.normal_index = ind[1].vn_idx;
-              idx1.texcoord_index = ind[1].vt_idx;
-              idx2.vertex_index = ind[2].v_idx;
-              idx2.normal_index = ind[2].vn_idx;
-              idx2.texcoord_index = ind[2].vt_idx;
-
-              shape->mesh.indices.push_back(idx0);
-              shape->mesh.indices.push_back(idx1);
-              shape->mesh.indices.push_back(idx2);
-
-              shape->mesh.num_face_vertices.push_back(3);
-              shape->mesh.material_ids.push_back(material_id);
-              shape->mesh.smoothing_group_ids.push_back(
-                  face.smoothing_group_id);
-            }
+  if (warn) {
+    for (size_t t = 0; t < num_chunks; t++) {
+      (*warn) += chunks[t].warn;
+    }
+  }
+}
+#endif
 
-            // remove v1 from the list
-            size_t removed_vert_index = (guess_vert + 1) % npolys;
-            while (removed_vert_index + 1 < npolys) {
-              remainingFace.vertex_indices[removed_vert_index] =
-                  remainingFace.vertex_indices[removed_vert_index + 1];
-              removed_vert_index += 1;
-            }
-            remainingFace.vertex_indices.pop_back();
-          }
+// TODO(syoyo): refactor function.
+static bool exportGroupsToShape(shape_t *shape, const PrimGroup &prim_group,
+                                const vector_of<tag_t>::type &tags,
+                                const int material_id, const std::string &name,
+                                bool triangulate, int num_threads,
+                                const vector_of<real_t>::type &v,
+                                std::string *warn) {
+  if (prim_group.IsEmpty()) {
+    return false;
+  }
 
-          // std::cout << "remainingFace.vi.size = " <<
-          // remainingFace.vertex_indices.size() << "\n";
-          if (remainingFace.vertex_indices.size() == 3) {
-            i0 = remainingFace.vertex_indices[0];
-            i1 = remainingFace.vertex_indices[1];
-            i2 = remainingFace.vertex_indices[2];
-            {
-              index_t idx0, idx1, idx2;
-              idx0.vertex_index = i0.v_idx;
-              idx0.normal_index = i0.vn_idx;
-              idx0.texcoord_index = i0.vt_idx;
-              idx1.vertex_index = i1.v_idx;
-              idx1.normal_index = i1.vn_idx;
-              idx1.texcoord_index = i1.vt_idx;
-              idx2.vertex_index = i2.v_idx;
-              idx2.normal_index = i2.vn_idx;
-              idx2.texcoord_index = i2.vt_idx;
-
-              shape->mesh.indices.push_back(idx0);
-              shape->mesh.indices.push_back(idx1);
-              shape->mesh.indices.push_back(idx2);
-
-              shape->mesh.num_face_vertices.push_back(3);
-              shape->mesh.material_ids.push_back(material_id);
-              shape->mesh.smoothing_group_ids.push_back(
-                  face.smoothing_group_id);
-            }
-          }
-#endif
-        }  // npolys
-      } else {
-        for (size_t k = 0; k < npolys; k++) {
-          index_t idx;
-          idx.vertex_index = face.vertex_indices[k].v_idx;
-          idx.normal_index = face.vertex_indices[k].vn_idx;
-          idx.texcoord_index = face.vertex_indices[k].vt_idx;
-          shape->mesh.indices.push_back(idx);
+  shape->name = name;
+
+  // polygon
+  if (!prim_group.faceGroup.empty()) {
+    // Pre-size output arrays. Triangulation emits (npolys - 2) triangles per
+    // polygon.
+    {
+      size_t num_faces = 0;
+      size_t num_indices = 0;
+      for (size_t i = 0; i < prim_group.faceGroup.size(); i++) {
+        size_t npolys = prim_group.faceGroup[i].num_vertices;
+        if (npolys < 3) {
+          continue;
         }
+        if (triangulate && npolys != 3) {
+          num_faces += npolys - 2;
+          num_indices += 3 * (npolys - 2);
+        } else {
+          num_faces += 1;
+          num_indices += npolys;
+        }
+      }
+      reserveAppend(&shape->mesh.indices, num_indices);
+      reserveAppend(&shape->mesh.num_face_vertices, num_faces);
+      reserveAppend(&shape->mesh.material_ids, num_faces);
+      reserveAppend(&shape->mesh.smoothing_group_ids, num_faces);
+    }
 
-        shape->mesh.num_face_vertices.push_back(
-            static_cast<unsigned int>(npolys));
-        shape->mesh.material_ids.push_back(material_id);  // per face
-        shape->mesh.smoothing_group_ids.push_back(
-            face.smoothing_group_id);  // per face
+#ifdef TINYOBJLOADER_HAS_THREADS
+    size_t num_chunks = 1;
+    if (triangulate && (num_threads > 1)) {
+      num_chunks = prim_group.faceGroup.size() / kMinTriangulateFacesPerThread;
+      if (num_chunks > size_t(num_threads)) {
+        num_chunks = size_t(num_threads);
       }
     }
 
+    if (num_chunks > 1) {
+      triangulateFacesParallel(&shape->mesh, prim_group, num_chunks,
+                               material_id, v, warn);
+    } else {
+      triangulateFaces(&shape->mesh, prim_group, 0,
+                       prim_group.faceGroup.size(), material_id, triangulate,
+                       v, warn);
+    }
+#else
+    (void)num_threads;
+    triangulateFaces(&shape->mesh, prim_group, 0, prim_group.faceGroup.size(),
+                     material_id, triangulate, v, warn);
+#endif
+
     shape->mesh.tags = tags;
   }
 
   // line
   if (!prim_group.lineGroup.empty()) {
+    {
+      size_t num_indices = 0;
+      for (size_t i = 0; i < prim_group.lineGroup.size(); i++) {
+        num_indices += prim_group.lineGroup[i].num_vertices;
+      }
+      reserveAppend(&shape->lines.indices, num_indices);
+      reserveAppend(&shape->lines.num_line_vertices,
+                    prim_group.lineGroup.size());
+    }
+
     // Flatten indices
     for (size_t i = 0; i < prim_group.lineGroup.size(); i++) {
-      for (size_t j = 0; j < prim_group.lineGroup[i].vertex_indices.size();
-           j++) {
-        const vertex_index_t &vi = prim_group.lineGroup[i].vertex_indices[j];
+      const __line_t &line = prim_group.lineGroup[i];
+      for (size_t j = 0; j < line.num_vertices; j++) {
+        const vertex_index_t &vi =
+            prim_group.lineIndices[line.vertex_offset + j];
 
         index_t idx;
         idx.vertex_index = vi.v_idx;
@@ -1998,18 +3369,26 @@ static bool exportGroupsToShape(shape_t *shape, const PrimGroup &prim_group,
         shape->lines.indices.push_back(idx);
       }
 
-      shape->lines.num_line_vertices.push_back(
-          int(prim_group.lineGroup[i].vertex_indices.size()));
+      shape->lines.num_line_vertices.push_back(int(line.num_vertices));
     }
   }
 
   // points
   if (!prim_group.pointsGroup.empty()) {
+    {
+      size_t num_indices = 0;
+      for (size_t i = 0; i < prim_group.pointsGroup.size(); i++) {
+        num_indices += prim_group.pointsGroup[i].num_vertices;
+      }
+      reserveAppend(&shape->points.indices, num_indices);
+    }
+
     // Flatten & convert indices
     for (size_t i = 0; i < prim_group.pointsGroup.size(); i++) {
-      for (size_t j = 0; j < prim_group.pointsGroup[i].vertex_indices.size();
-           j++) {
-        const vertex_index_t &vi = prim_group.pointsGroup[i].vertex_indices[j];
+      const __points_t &pts = prim_group.pointsGroup[i];
+      for (size_t j = 0; j < pts.num_vertices; j++) {
+        const vertex_index_t &vi =
+            prim_group.pointsIndices[pts.vertex_offset + j];
 
         index_t idx;
         idx.vertex_index = vi.v_idx;
@@ -2066,6 +3445,248 @@ static std::string JoinPath(const std::string &dir,
   }
 }
 
+// Line types of .obj. `LoadObj` and `LoadObjWithCallback` dispatch a line with
+// one switch on `classifyObjLine`, instead of comparing it with each command.
+enum ObjLineType {
+  OBJ_LINE_UNKNOWN = 0,
+  OBJ_LINE_V,
+  OBJ_LINE_VN,
+  OBJ_LINE_VT,
+  OBJ_LINE_VW,  // tinyobj extension
+  OBJ_LINE_F,
+  OBJ_LINE_L,
+  OBJ_LINE_P,
+  OBJ_LINE_G,
+  OBJ_LINE_O,
+  OBJ_LINE_S,
+  OBJ_LINE_T,  // tinyobj extension
+  OBJ_LINE_USEMTL,
+  OBJ_LINE_MTLLIB
+};
+
+// `token` must not start with spaces.
+static inline ObjLineType classifyObjLine(const char *token) {
+  switch (token[0]) {
+    case 'v':
+      if (IS_SPACE(token[1])) {
+        return OBJ_LINE_V;
+      }
+      if ((token[1] != '\0') && IS_SPACE(token[2])) {
+        switch (token[1]) {
+          case 'n':
+            return OBJ_LINE_VN;
+          case 't':
+            return OBJ_LINE_VT;
+          case 'w':
+            return OBJ_LINE_VW;
+          default:
+            break;
+        }
+      }
+      break;
+    case 'f':
+      return IS_SPACE(token[1]) ? OBJ_LINE_F : OBJ_LINE_UNKNOWN;
+    case 'l':
+      return IS_SPACE(token[1]) ? OBJ_LINE_L : OBJ_LINE_UNKNOWN;
+    case 'p':
+      return IS_SPACE(token[1]) ? OBJ_LINE_P : OBJ_LINE_UNKNOWN;
+    case 'g':
+      return IS_SPACE(token[1]) ? OBJ_LINE_G : OBJ_LINE_UNKNOWN;
+    case 'o':
+      return IS_SPACE(token[1]) ? OBJ_LINE_O : OBJ_LINE_UNKNOWN;
+    case 's':
+      return IS_SPACE(token[1]) ? OBJ_LINE_S : OBJ_LINE_UNKNOWN;
+    case 't':
+      return IS_SPACE(token[1]) ? OBJ_LINE_T : OBJ_LINE_UNKNOWN;
+    case 'u':
+      // No space is required after `usemtl`(compatibility).
+      if (0 == strncmp(token, "usemtl", 6)) {
+        return OBJ_LINE_USEMTL;
+      }
+      break;
+    case 'm':
+      if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE(token[6])) {
+        return OBJ_LINE_MTLLIB;
+      }
+      break;
+    default:
+      break;
+  }
+  return OBJ_LINE_UNKNOWN;
+}
+
+// Keywords of .mtl. `LoadMtl` dispatches a line with one switch on
+// `classifyMtlKeyword`.
+enum MtlKeyword {
+  MTL_KEYWORD_UNKNOWN = 0,
+  MTL_KEYWORD_NEWMTL,
+  MTL_KEYWORD_KA,
+  MTL_KEYWORD_KD,
+  MTL_KEYWORD_KS,
+  MTL_KEYWORD_KT,  // `Kt` or `Tf`
+  MTL_KEYWORD_KE,
+  MTL_KEYWORD_NI,
+  MTL_KEYWORD_NS,
+  MTL_KEYWORD_ILLUM,
+  MTL_KEYWORD_D,
+  MTL_KEYWORD_TR,
+  MTL_KEYWORD_PR,
+  MTL_KEYWORD_PM,
+  MTL_KEYWORD_PS,
+  MTL_KEYWORD_PC,
+  MTL_KEYWORD_PCR,
+  MTL_KEYWORD_ANISO,
+  MTL_KEYWORD_ANISOR,
+  MTL_KEYWORD_MAP_KA,
+  MTL_KEYWORD_MAP_KD,
+  MTL_KEYWORD_MAP_KS,
+  MTL_KEYWORD_MAP_NS,
+  MTL_KEYWORD_MAP_BUMP,  // `map_bump` or `map_Bump`
+  MTL_KEYWORD_BUMP,
+  MTL_KEYWORD_MAP_D,
+  MTL_KEYWORD_MAP_DISP,  // `map_disp` or `map_Disp`
+  MTL_KEYWORD_DISP,
+  MTL_KEYWORD_REFL,
+  MTL_KEYWORD_MAP_PR,
+  MTL_KEYWORD_MAP_PM,
+  MTL_KEYWORD_MAP_PS,
+  MTL_KEYWORD_MAP_KE,
+  MTL_KEYWORD_NORM
+};
+
+// Classifies the keyword at `token`, which must be followed by a space or a
+// tab. Switches on the first byte and the length, then compares at most a
+// few bytes.
+static inline MtlKeyword classifyMtlKeyword(const char *token) {
+  const size_t len = strcspn(token, " \t");
+  if (!IS_SPACE(token[len])) {
+    return MTL_KEYWORD_UNKNOWN;
+  }
+
+  switch (token[0]) {
+    case 'K':
+      if (len == 2) {
+        switch (token[1]) {
+          case 'a':
+            return MTL_KEYWORD_KA;
+          case 'd':
+            return MTL_KEYWORD_KD;
+          case 's':
+            return MTL_KEYWORD_KS;
+          case 't':
+            return MTL_KEYWORD_KT;
+          case 'e':
+            return MTL_KEYWORD_KE;
+          default:
+            break;
+        }
+      }
+      break;
+    case 'N':
+      if (len == 2) {
+        if (token[1] == 'i') return MTL_KEYWORD_NI;
+        if (token[1] == 's') return MTL_KEYWORD_NS;
+      }
+      break;
+    case 'T':
+      if (len == 2) {
+        if (token[1] == 'r') return MTL_KEYWORD_TR;
+        if (token[1] == 'f') return MTL_KEYWORD_KT;
+      }
+      break;
+    case 'P':
+      if (len == 2) {
+        switch (token[1]) {
+          case 'r':
+            return MTL_KEYWORD_PR;
+          case 'm':
+            return MTL_KEYWORD_PM;
+          case 's':
+            return MTL_KEYWORD_PS;
+          case 'c':
+            return MTL_KEYWORD_PC;
+          default:
+            break;
+        }
+      } else if ((len == 3) && (token[1] == 'c') && (token[2] == 'r')) {
+        return MTL_KEYWORD_PCR;
+      }
+      break;
+    case 'd':
+      if (len == 1) return MTL_KEYWORD_D;
+      if ((len == 4) && (0 == strncmp(token, "disp", 4))) {
+        return MTL_KEYWORD_DISP;
+      }
+      break;
+    case 'i':
+      if ((len == 5) && (0 == strncmp(token, "illum", 5))) {
+        return MTL_KEYWORD_ILLUM;
+      }
+      break;
+    case 'a':
+      if ((len == 5) && (0 == strncmp(token, "aniso", 5))) {
+        return MTL_KEYWORD_ANISO;
+      }
+      if ((len == 6) && (0 == strncmp(token, "anisor", 6))) {
+        return MTL_KEYWORD_ANISOR;
+      }
+      break;
+    case 'b':
+      if ((len == 4) && (0 == strncmp(token, "bump", 4))) {
+        return MTL_KEYWORD_BUMP;
+      }
+      break;
+    case 'r':
+      if ((len == 4) && (0 == strncmp(token, "refl", 4))) {
+        return MTL_KEYWORD_REFL;
+      }
+      break;
+    case 'n':
+      if ((len == 6) && (0 == strncmp(token, "newmtl", 6))) {
+        return MTL_KEYWORD_NEWMTL;
+      }
+      if ((len == 4) && (0 == strncmp(token, "norm", 4))) {
+        return MTL_KEYWORD_NORM;
+      }
+      break;
+    case 'm':
+      if ((len < 5) || (0 != strncmp(token, "map_", 4))) {
+        break;
+      }
+      if (len == 5) {
+        if (token[4] == 'd') return MTL_KEYWORD_MAP_D;
+      } else if (len == 6) {
+        // map_Ka, map_Kd, map_Ks, map_Ke, map_Ns, map_Pr, map_Pm, map_Ps
+        const char c = token[5];
+        if (token[4] == 'K') {
+          if (c == 'a') return MTL_KEYWORD_MAP_KA;
+          if (c == 'd') return MTL_KEYWORD_MAP_KD;
+          if (c == 's') return MTL_KEYWORD_MAP_KS;
+          if (c == 'e') return MTL_KEYWORD_MAP_KE;
+        } else if (token[4] == 'N') {
+          if (c == 's') return MTL_KEYWORD_MAP_NS;
+        } else if (token[4] == 'P') {
+          if (c == 'r') return MTL_KEYWORD_MAP_PR;
+          if (c == 'm') return MTL_KEYWORD_MAP_PM;
+          if (c == 's') return MTL_KEYWORD_MAP_PS;
+        }
+      } else if (len == 8) {
+        if ((0 == strncmp(token + 4, "bump", 4)) ||
+            (0 == strncmp(token + 4, "Bump", 4))) {
+          return MTL_KEYWORD_MAP_BUMP;
+        }
+        if ((0 == strncmp(token + 4, "disp", 4)) ||
+            (0 == strncmp(token + 4, "Disp", 4))) {
+          return MTL_KEYWORD_MAP_DISP;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return MTL_KEYWORD_UNKNOWN;
+}
+
 void LoadMtl(std::map<std::string, int> *material_map,
              std::vector<material_t> *materials, std::istream *inStream,
              std::string *warning, std::string *err) {
@@ -2120,327 +3741,326 @@ void LoadMtl(std::map<std::string, int> *material_map,
 
     if (token[0] == '#') continue;  // comment line
 
-    // new mtl
-    if ((0 == strncmp(token, "newmtl", 6)) && IS_SPACE((token[6]))) {
-      // flush previous material.
-      if (!material.name.empty()) {
-        material_map->insert(std::pair<std::string, int>(
-            material.name, static_cast<int>(materials->size())));
-        materials->push_back(material);
-      }
+    switch (classifyMtlKeyword(token)) {
+      // new mtl
+      case MTL_KEYWORD_NEWMTL: {
+        // flush previous material.
+        if (!material.name.empty()) {
+          material_map->insert(std::pair<std::string, int>(
+              material.name, static_cast<int>(materials->size())));
+          pushBackMove(materials, &material);
+        }
 
-      // initial temporary material
-      InitMaterial(&material);
+        // initial temporary material
+        InitMaterial(&material);
 
-      has_d = false;
-      has_tr = false;
+        has_d = false;
+        has_tr = false;
 
-      // set new mtl name
-      token += 7;
-      {
-        std::string namebuf = parseString(&token);
-        // TODO: empty name check?
-        if (namebuf.empty()) {
-          if (warning) {
-            (*warning) += "empty material name in `newmtl`\n";
+        // set new mtl name
+        token += 7;
+        {
+          std::string namebuf = parseString(&token);
+          // TODO: empty name check?
+          if (namebuf.empty()) {
+            if (warning) {
+              (*warning) += "empty material name in `newmtl`\n";
+            }
           }
+          material.name = namebuf;
         }
-        material.name = namebuf;
+        continue;
       }
-      continue;
-    }
 
-    // ambient
-    if (token[0] == 'K' && token[1] == 'a' && IS_SPACE((token[2]))) {
-      token += 2;
-      real_t r, g, b;
-      parseReal3(&r, &g, &b, &token);
-      material.ambient[0] = r;
-      material.ambient[1] = g;
-      material.ambient[2] = b;
-      continue;
-    }
+      // ambient
+      case MTL_KEYWORD_KA: {
+        token += 2;
+        real_t r, g, b;
+        parseReal3(&r, &g, &b, &token);
+        material.ambient[0] = r;
+        material.ambient[1] = g;
+        material.ambient[2] = b;
+        continue;
+      }
 
-    // diffuse
-    if (token[0] == 'K' && token[1] == 'd' && IS_SPACE((token[2]))) {
-      token += 2;
-      real_t r, g, b;
-      parseReal3(&r, &g, &b, &token);
-      material.diffuse[0] = r;
-      material.diffuse[1] = g;
-      material.diffuse[2] = b;
-      has_kd = true;
-      continue;
-    }
+      // diffuse
+      case MTL_KEYWORD_KD: {
+        token += 2;
+        real_t r, g, b;
+        parseReal3(&r, &g, &b, &token);
+        material.diffuse[0] = r;
+        material.diffuse[1] = g;
+        material.diffuse[2] = b;
+        has_kd = true;
+        continue;
+      }
 
-    // specular
-    if (token[0] == 'K' && token[1] == 's' && IS_SPACE((token[2]))) {
-      token += 2;
-      real_t r, g, b;
-      parseReal3(&r, &g, &b, &token);
-      material.specular[0] = r;
-      material.specular[1] = g;
-      material.specular[2] = b;
-      continue;
-    }
+      // specular
+      case MTL_KEYWORD_KS: {
+        token += 2;
+        real_t r, g, b;
+        parseReal3(&r, &g, &b, &token);
+        material.specular[0] = r;
+        material.specular[1] = g;
+        material.specular[2] = b;
+        continue;
+      }
 
-    // transmittance
-    if ((token[0] == 'K' && token[1] == 't' && IS_SPACE((token[2]))) ||
-        (token[0] == 'T' && token[1] == 'f' && IS_SPACE((token[2])))) {
-      token += 2;
-      real_t r, g, b;
-      parseReal3(&r, &g, &b, &token);
-      material.transmittance[0] = r;
-      material.transmittance[1] = g;
-      material.transmittance[2] = b;
-      continue;
-    }
+      // transmittance
+      case MTL_KEYWORD_KT: {
+        token += 2;
+        real_t r, g, b;
+        parseReal3(&r, &g, &b, &token);
+        material.transmittance[0] = r;
+        material.transmittance[1] = g;
+        material.transmittance[2] = b;
+        continue;
+      }
 
-    // ior(index of refraction)
-    if (token[0] == 'N' && token[1] == 'i' && IS_SPACE((token[2]))) {
-      token += 2;
-      material.ior = parseReal(&token);
-      continue;
-    }
+      // ior(index of refraction)
+      case MTL_KEYWORD_NI: {
+        token += 2;
+        material.ior = parseReal(&token);
+        continue;
+      }
 
-    // emission
-    if (token[0] == 'K' && token[1] == 'e' && IS_SPACE(token[2])) {
-      token += 2;
-      real_t r, g, b;
-      parseReal3(&r, &g, &b, &token);
-      material.emission[0] = r;
-      material.emission[1] = g;
-      material.emission[2] = b;
-      continue;
-    }
+      // emission
+      case MTL_KEYWORD_KE: {
+        token += 2;
+        real_t r, g, b;
+        parseReal3(&r, &g, &b, &token);
+        material.emission[0] = r;
+        material.emission[1] = g;
+        material.emission[2] = b;
+        continue;
+      }
 
-    // shininess
-    if (token[0] == 'N' && token[1] == 's' && IS_SPACE(token[2])) {
-      token += 2;
-      material.shininess = parseReal(&token);
-      continue;
-    }
+      // shininess
+      case MTL_KEYWORD_NS: {
+        token += 2;
+        material.shininess = parseReal(&token);
+        continue;
+      }
 
-    // illum model
-    if (0 == strncmp(token, "illum", 5) && IS_SPACE(token[5])) {
-      token += 6;
-      material.illum = parseInt(&token);
-      continue;
-    }
+      // illum model
+      case MTL_KEYWORD_ILLUM: {
+        token += 6;
+        material.illum = parseInt(&token);
+        continue;
+      }
 
-    // dissolve
-    if ((token[0] == 'd' && IS_SPACE(token[1]))) {
-      token += 1;
-      material.dissolve = parseReal(&token);
+      // dissolve
+      case MTL_KEYWORD_D: {
+        token += 1;
+        material.dissolve = parseReal(&token);
 
-      if (has_tr) {
-        warn_ss << "Both `d` and `Tr` parameters defined for \""
-                << material.name
-                << "\". Use the value of `d` for dissolve (line " << line_no
-                << " in .mtl.)\n";
+        if (has_tr) {
+          warn_ss << "Both `d` and `Tr` parameters defined for \""
+                  << material.name
+                  << "\". Use the value of `d` for dissolve (line " << line_no
+                  << " in .mtl.)\n";
+        }
+        has_d = true;
+        continue;
       }
-      has_d = true;
-      continue;
-    }
-    if (token[0] == 'T' && token[1] == 'r' && IS_SPACE(token[2])) {
-      token += 2;
-      if (has_d) {
-        // `d` wins. Ignore `Tr` value.
-        warn_ss << "Both `d` and `Tr` parameters defined for \""
-                << material.name
-                << "\". Use the value of `d` for dissolve (line " << line_no
-                << " in .mtl.)\n";
-      } else {
-        // We invert value of Tr(assume Tr is in range [0, 1])
-        // NOTE: Interpretation of Tr is application(exporter) dependent. For
-        // some application(e.g. 3ds max obj exporter), Tr = d(Issue 43)
-        material.dissolve = static_cast<real_t>(1.0) - parseReal(&token);
+      case MTL_KEYWORD_TR: {
+        token += 2;
+        if (has_d) {
+          // `d` wins. Ignore `Tr` value.
+          warn_ss << "Both `d` and `Tr` parameters defined for \""
+                  << material.name
+                  << "\". Use the value of `d` for dissolve (line " << line_no
+                  << " in .mtl.)\n";
+        } else {
+          // We invert value of Tr(assume Tr is in range [0, 1])
+          // NOTE: Interpretation of Tr is application(exporter) dependent. For
+          // some application(e.g. 3ds max obj exporter), Tr = d(Issue 43)
+          material.dissolve = static_cast<real_t>(1.0) - parseReal(&token);
+        }
+        has_tr = true;
+        continue;
       }
-      has_tr = true;
-      continue;
-    }
 
-    // PBR: roughness
-    if (token[0] == 'P' && token[1] == 'r' && IS_SPACE(token[2])) {
-      token += 2;
-      material.roughness = parseReal(&token);
-      continue;
-    }
+      // PBR: roughness
+      case MTL_KEYWORD_PR: {
+        token += 2;
+        material.roughness = parseReal(&token);
+        continue;
+      }
 
-    // PBR: metallic
-    if (token[0] == 'P' && token[1] == 'm' && IS_SPACE(token[2])) {
-      token += 2;
-      material.metallic = parseReal(&token);
-      continue;
-    }
+      // PBR: metallic
+      case MTL_KEYWORD_PM: {
+        token += 2;
+        material.metallic = parseReal(&token);
+        continue;
+      }
 
-    // PBR: sheen
-    if (token[0] == 'P' && token[1] == 's' && IS_SPACE(token[2])) {
-      token += 2;
-      material.sheen = parseReal(&token);
-      continue;
-    }
+      // PBR: sheen
+      case MTL_KEYWORD_PS: {
+        token += 2;
+        material.sheen = parseReal(&token);
+        continue;
+      }
 
-    // PBR: clearcoat thickness
-    if (token[0] == 'P' && token[1] == 'c' && IS_SPACE(token[2])) {
-      token += 2;
-      material.clearcoat_thickness = parseReal(&token);
-      continue;
-    }
+      // PBR: clearcoat thickness
+      case MTL_KEYWORD_PC: {
+        token += 2;
+        material.clearcoat_thickness = parseReal(&token);
+        continue;
+      }
 
-    // PBR: clearcoat roughness
-    if ((0 == strncmp(token, "Pcr", 3)) && IS_SPACE(token[3])) {
-      token += 4;
-      material.clearcoat_roughness = parseReal(&token);
-      continue;
-    }
+      // PBR: clearcoat roughness
+      case MTL_KEYWORD_PCR: {
+        token += 4;
+        material.clearcoat_roughness = parseReal(&token);
+        continue;
+      }
 
-    // PBR: anisotropy
-    if ((0 == strncmp(token, "aniso", 5)) && IS_SPACE(token[5])) {
-      token += 6;
-      material.anisotropy = parseReal(&token);
-      continue;
-    }
+      // PBR: anisotropy
+      case MTL_KEYWORD_ANISO: {
+        token += 6;
+        material.anisotropy = parseReal(&token);
+        continue;
+      }
 
-    // PBR: anisotropy rotation
-    if ((0 == strncmp(token, "anisor", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      material.anisotropy_rotation = parseReal(&token);
-      continue;
-    }
+      // PBR: anisotropy rotation
+      case MTL_KEYWORD_ANISOR: {
+        token += 7;
+        material.anisotropy_rotation = parseReal(&token);
+        continue;
+      }
 
-    // ambient or ambient occlusion texture
-    if ((0 == strncmp(token, "map_Ka", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.ambient_texname),
-                                &(material.ambient_texopt), token);
-      continue;
-    }
+      // ambient or ambient occlusion texture
+      case MTL_KEYWORD_MAP_KA: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.ambient_texname),
+                                  &(material.ambient_texopt), token);
+        continue;
+      }
 
-    // diffuse texture
-    if ((0 == strncmp(token, "map_Kd", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.diffuse_texname),
-                                &(material.diffuse_texopt), token);
+      // diffuse texture
+      case MTL_KEYWORD_MAP_KD: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.diffuse_texname),
+                                  &(material.diffuse_texopt), token);
+
+        // Set a decent diffuse default value if a diffuse texture is specified
+        // without a matching Kd value.
+        if (!has_kd) {
+          material.diffuse[0] = static_cast<real_t>(0.6);
+          material.diffuse[1] = static_cast<real_t>(0.6);
+          material.diffuse[2] = static_cast<real_t>(0.6);
+        }
 
-      // Set a decent diffuse default value if a diffuse texture is specified
-      // without a matching Kd value.
-      if (!has_kd) {
-        material.diffuse[0] = static_cast<real_t>(0.6);
-        material.diffuse[1] = static_cast<real_t>(0.6);
-        material.diffuse[2] = static_cast<real_t>(0.6);
+        continue;
       }
 
-      continue;
-    }
-
-    // specular texture
-    if ((0 == strncmp(token, "map_Ks", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.specular_texname),
-                                &(material.specular_texopt), token);
-      continue;
-    }
+      // specular texture
+      case MTL_KEYWORD_MAP_KS: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.specular_texname),
+                                  &(material.specular_texopt), token);
+        continue;
+      }
 
-    // specular highlight texture
-    if ((0 == strncmp(token, "map_Ns", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.specular_highlight_texname),
-                                &(material.specular_highlight_texopt), token);
-      continue;
-    }
+      // specular highlight texture
+      case MTL_KEYWORD_MAP_NS: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.specular_highlight_texname),
+                                  &(material.specular_highlight_texopt), token);
+        continue;
+      }
 
-    // bump texture
-    if (((0 == strncmp(token, "map_bump", 8)) ||
-         (0 == strncmp(token, "map_Bump", 8))) &&
-        IS_SPACE(token[8])) {
-      token += 9;
-      ParseTextureNameAndOption(&(material.bump_texname),
-                                &(material.bump_texopt), token);
-      continue;
-    }
+      // bump texture
+      case MTL_KEYWORD_MAP_BUMP: {
+        token += 9;
+        ParseTextureNameAndOption(&(material.bump_texname),
+                                  &(material.bump_texopt), token);
+        continue;
+      }
 
-    // bump texture
-    if ((0 == strncmp(token, "bump", 4)) && IS_SPACE(token[4])) {
-      token += 5;
-      ParseTextureNameAndOption(&(material.bump_texname),
-                                &(material.bump_texopt), token);
-      continue;
-    }
+      // bump texture
+      case MTL_KEYWORD_BUMP: {
+        token += 5;
+        ParseTextureNameAndOption(&(material.bump_texname),
+                                  &(material.bump_texopt), token);
+        continue;
+      }
 
-    // alpha texture
-    if ((0 == strncmp(token, "map_d", 5)) && IS_SPACE(token[5])) {
-      token += 6;
-      material.alpha_texname = token;
-      ParseTextureNameAndOption(&(material.alpha_texname),
-                                &(material.alpha_texopt), token);
-      continue;
-    }
+      // alpha texture
+      case MTL_KEYWORD_MAP_D: {
+        token += 6;
+        material.alpha_texname = token;
+        ParseTextureNameAndOption(&(material.alpha_texname),
+                                  &(material.alpha_texopt), token);
+        continue;
+      }
 
-    // displacement texture
-    if (((0 == strncmp(token, "map_disp", 8)) ||
-         (0 == strncmp(token, "map_Disp", 8))) &&
-        IS_SPACE(token[8])) {
-      token += 9;
-      ParseTextureNameAndOption(&(material.displacement_texname),
-                                &(material.displacement_texopt), token);
-      continue;
-    }
+      // displacement texture
+      case MTL_KEYWORD_MAP_DISP: {
+        token += 9;
+        ParseTextureNameAndOption(&(material.displacement_texname),
+                                  &(material.displacement_texopt), token);
+        continue;
+      }
 
-    // displacement texture
-    if ((0 == strncmp(token, "disp", 4)) && IS_SPACE(token[4])) {
-      token += 5;
-      ParseTextureNameAndOption(&(material.displacement_texname),
-                                &(material.displacement_texopt), token);
-      continue;
-    }
+      // displacement texture
+      case MTL_KEYWORD_DISP: {
+        token += 5;
+        ParseTextureNameAndOption(&(material.displacement_texname),
+                                  &(material.displacement_texopt), token);
+        continue;
+      }
 
-    // reflection map
-    if ((0 == strncmp(token, "refl", 4)) && IS_SPACE(token[4])) {
-      token += 5;
-      ParseTextureNameAndOption(&(material.reflection_texname),
-                                &(material.reflection_texopt), token);
-      continue;
-    }
+      // reflection map
+      case MTL_KEYWORD_REFL: {
+        token += 5;
+        ParseTextureNameAndOption(&(material.reflection_texname),
+                                  &(material.reflection_texopt), token);
+        continue;
+      }
 
-    // PBR: roughness texture
-    if ((0 == strncmp(token, "map_Pr", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.roughness_texname),
-                                &(material.roughness_texopt), token);
-      continue;
-    }
+      // PBR: roughness texture
+      case MTL_KEYWORD_MAP_PR: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.roughness_texname),
+                                  &(material.roughness_texopt), token);
+        continue;
+      }
 
-    // PBR: metallic texture
-    if ((0 == strncmp(token, "map_Pm", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.metallic_texname),
-                                &(material.metallic_texopt), token);
-      continue;
-    }
+      // PBR: metallic texture
+      case MTL_KEYWORD_MAP_PM: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.metallic_texname),
+                                  &(material.metallic_texopt), token);
+        continue;
+      }
 
-    // PBR: sheen texture
-    if ((0 == strncmp(token, "map_Ps", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.sheen_texname),
-                                &(material.sheen_texopt), token);
-      continue;
-    }
+      // PBR: sheen texture
+      case MTL_KEYWORD_MAP_PS: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.sheen_texname),
+                                  &(material.sheen_texopt), token);
+        continue;
+      }
 
-    // PBR: emissive texture
-    if ((0 == strncmp(token, "map_Ke", 6)) && IS_SPACE(token[6])) {
-      token += 7;
-      ParseTextureNameAndOption(&(material.emissive_texname),
-                                &(material.emissive_texopt), token);
-      continue;
-    }
+      // PBR: emissive texture
+      case MTL_KEYWORD_MAP_KE: {
+        token += 7;
+        ParseTextureNameAndOption(&(material.emissive_texname),
+                                  &(material.emissive_texopt), token);
+        continue;
+      }
 
-    // PBR: normal map texture
-    if ((0 == strncmp(token, "norm", 4)) && IS_SPACE(token[4])) {
-      token += 5;
-      ParseTextureNameAndOption(&(material.normal_texname),
-                                &(material.normal_texopt), token);
-      continue;
+      // PBR: normal map texture
+      case MTL_KEYWORD_NORM: {
+        token += 5;
+        ParseTextureNameAndOption(&(material.normal_texname),
+                                  &(material.normal_texopt), token);
+        continue;
+      }
+      default:
+        break;
     }
 
     // unknown parameter
@@ -2459,13 +4079,316 @@ void LoadMtl(std::map<std::string, int> *material_map,
   // flush last material.
   material_map->insert(std::pair<std::string, int>(
       material.name, static_cast<int>(materials->size())));
-  materials->push_back(material);
+  pushBackMove(materials, &material);
 
   if (warning) {
     (*warning) = warn_ss.str();
   }
 }
 
+//
+// std::streambuf reading directly from a memory block(no copy).
+//
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char *buf, size_t len) {
+    char *p = const_cast<char *>(buf);
+    setg(p, p, p + len);
+  }
+};
+
+enum CompressionType {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_GZIP,
+  COMPRESSION_ZSTD
+};
+
+// Detects gzip or zstd compressed data from the magic number.
+static CompressionType DetectCompression(const char *buf, size_t len) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(buf);
+  if ((len >= 2) && (p[0] == 0x1f) && (p[1] == 0x8b)) {
+    return COMPRESSION_GZIP;
+  }
+  if ((len >= 4) && (p[0] == 0x28) && (p[1] == 0xb5) && (p[2] == 0x2f) &&
+      (p[3] == 0xfd)) {
+    return COMPRESSION_ZSTD;
+  }
+  return COMPRESSION_NONE;
+}
+
+// Same as `DetectCompression` for a stream at its beginning(e.g. a file just
+// opened). The stream is rewound.
+static CompressionType DetectStreamCompression(std::istream *is) {
+  char magic[4];
+  is->read(magic, sizeof(magic));
+  size_t len = static_cast<size_t>(is->gcount());
+  is->clear();
+  is->seekg(0, std::ios::beg);
+  return DetectCompression(magic, len);
+}
+
+//
+// Streaming decompressor of gzip(TINYOBJLOADER_USE_ZLIB) or
+// zstd(TINYOBJLOADER_USE_ZSTD) data read from a stream. Only a small input
+// buffer is held, so the whole data is never decompressed in memory.
+// Concatenated gzip members or zstd frames are decompressed as one.
+//
+class Decompressor {
+ public:
+  Decompressor(std::istream *in, CompressionType type)
+      : in_(in),
+        type_(type),
+        in_buf_(64 * 1024),
+        eof_(false),
+        in_frame_(false),
+        finished_(false) {
+#ifdef TINYOBJLOADER_USE_ZLIB
+    zlib_initialized_ = false;
+#endif
+#ifdef TINYOBJLOADER_USE_ZSTD
+    zstd_ = NULL;
+#endif
+
+    if (type_ == COMPRESSION_GZIP) {
+#ifdef TINYOBJLOADER_USE_ZLIB
+      memset(&zlib_, 0, sizeof(zlib_));
+      // 15 + 16: gzip format with the maximum window size.
+      if (inflateInit2(&zlib_, 15 + 16) == Z_OK) {
+        zlib_initialized_ = true;
+      } else {
+        Fail("Failed to initialize zlib.\n");
+      }
+#else
+      Fail(
+          "gzip compressed data is not supported. Define "
+          "TINYOBJLOADER_USE_ZLIB and link zlib.\n");
+#endif
+    } else if (type_ == COMPRESSION_ZSTD) {
+#ifdef TINYOBJLOADER_USE_ZSTD
+      zstd_ = ZSTD_createDStream();
+      if (!zstd_ || ZSTD_isError(ZSTD_initDStream(zstd_))) {
+        Fail("Failed to initialize zstd.\n");
+      }
+      zstd_in_.src = &in_buf_.at(0);
+      zstd_in_.size = 0;
+      zstd_in_.pos = 0;
+#else
+      Fail(
+          "zstd compressed data is not supported. Define "
+          "TINYOBJLOADER_USE_ZSTD and link zstd.\n");
+#endif
+    } else {
+      Fail("Unknown compression.\n");
+    }
+  }
+
+  ~Decompressor() {
+#ifdef TINYOBJLOADER_USE_ZLIB
+    if (zlib_initialized_) {
+      inflateEnd(&zlib_);
+    }
+#endif
+#ifdef TINYOBJLOADER_USE_ZSTD
+    if (zstd_) {
+      ZSTD_freeDStream(zstd_);
+    }
+#endif
+  }
+
+  ///
+  /// Decompress up to `len` bytes into `buf`. Returns the number of bytes, or
+  /// 0 at the end of the data or on error(`Error()` is not empty).
+  ///
+  size_t Read(char *buf, size_t len) {
+    if (finished_ || (len == 0)) {
+      return 0;
+    }
+#ifdef TINYOBJLOADER_USE_ZLIB
+    if (type_ == COMPRESSION_GZIP) {
+      return ReadGzip(buf, len);
+    }
+#endif
+#ifdef TINYOBJLOADER_USE_ZSTD
+    if (type_ == COMPRESSION_ZSTD) {
+      return ReadZstd(buf, len);
+    }
+#endif
+    (void)buf;
+    return 0;
+  }
+
+  const std::string &Error() const { return error_; }
+
+ private:
+  // non-copyable
+  Decompressor(const Decompressor &);
+  Decompressor &operator=(const Decompressor &);
+
+  std::istream *in_;
+  CompressionType type_;
+  vector_of<char>::type in_buf_;
+  bool eof_;       // all compressed data has been read from `in_`
+  bool in_frame_;  // in the middle of a gzip member or a zstd frame
+  bool finished_;
+  std::string error_;
+
+#ifdef TINYOBJLOADER_USE_ZLIB
+  z_stream zlib_;
+  bool zlib_initialized_;
+#endif
+#ifdef TINYOBJLOADER_USE_ZSTD
+  ZSTD_DStream *zstd_;
+  ZSTD_inBuffer zstd_in_;
+#endif
+
+  void Fail(const std::string &msg) {
+    error_ = msg;
+    finished_ = true;
+  }
+
+  // Reads the next compressed data into `in_buf_`.
+  size_t Refill() {
+    in_->read(&in_buf_.at(0), static_cast<std::streamsize>(in_buf_.size()));
+    size_t n = static_cast<size_t>(in_->gcount());
+    if (n == 0) {
+      eof_ = true;
+    }
+    return n;
+  }
+
+#ifdef TINYOBJLOADER_USE_ZLIB
+  size_t ReadGzip(char *buf, size_t len) {
+    zlib_.next_out = reinterpret_cast<Bytef *>(buf);
+    zlib_.avail_out = static_cast<uInt>(len);
+
+    while (zlib_.avail_out > 0) {
+      if ((zlib_.avail_in == 0) && !eof_) {
+        zlib_.avail_in = static_cast<uInt>(Refill());
+        zlib_.next_in = reinterpret_cast<Bytef *>(&in_buf_.at(0));
+      }
+      if (eof_ && !in_frame_) {
+        finished_ = true;
+        break;
+      }
+
+      // inflate may still have pending output after all input is consumed.
+      const uInt avail_out = zlib_.avail_out;
+      in_frame_ = true;
+      int ret = inflate(&zlib_, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        in_frame_ = false;
+        inflateReset(&zlib_);
+      } else if ((ret == Z_OK) || (ret == Z_BUF_ERROR)) {
+        if (eof_ && (zlib_.avail_out == avail_out)) {
+          Fail("Unexpected end of gzip data.\n");
+          break;
+        }
+      } else {
+        Fail(std::string("Failed to decompress gzip data: ") +
+             (zlib_.msg ? zlib_.msg : "unknown error") + "\n");
+        break;
+      }
+    }
+
+    return len - zlib_.avail_out;
+  }
+#endif
+
+#ifdef TINYOBJLOADER_USE_ZSTD
+  size_t ReadZstd(char *buf, size_t len) {
+    ZSTD_outBuffer out;
+    out.dst = buf;
+    out.size = len;
+    out.pos = 0;
+
+    while (out.pos < out.size) {
+      if ((zstd_in_.pos == zstd_in_.size) && !eof_) {
+        zstd_in_.size = Refill();
+        zstd_in_.pos = 0;
+      }
+      if (eof_ && !in_frame_) {
+        finished_ = true;
+        break;
+      }
+
+      // zstd may still have pending output after all input is consumed.
+      const size_t pos = out.pos;
+      size_t ret = ZSTD_decompressStream(zstd_, &out, &zstd_in_);
+      if (ZSTD_isError(ret)) {
+        Fail(std::string("Failed to decompress zstd data: ") +
+             ZSTD_getErrorName(ret) + "\n");
+        break;
+      }
+      in_frame_ = (ret != 0);
+      if (eof_ && in_frame_ && (out.pos == pos)) {
+        Fail("Unexpected end of zstd data.\n");
+        break;
+      }
+    }
+
+    return out.pos;
+  }
+#endif
+};
+
+//
+// std::streambuf decompressing gzip or zstd data of another stream while it
+// is read.
+//
+class DecompressStreamBuf : public std::streambuf {
+ public:
+  DecompressStreamBuf(std::istream *in, CompressionType type)
+      : decompressor_(in, type), buf_(64 * 1024) {}
+
+  ///
+  /// Error message of the decompression(empty = no error so far).
+  ///
+  const std::string &Error() const { return decompressor_.Error(); }
+
+ protected:
+  virtual int_type underflow() TINYOBJ_OVERRIDE {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+    size_t n = decompressor_.Read(&buf_.at(0), buf_.size());
+    if (n == 0) {
+      return traits_type::eof();
+    }
+    setg(&buf_.at(0), &buf_.at(0), &buf_.at(0) + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+ private:
+  Decompressor decompressor_;
+  vector_of<char>::type buf_;
+};
+
+// Loads .mtl file `filepath`, which may be compressed. Returns false when the
+// file cannot be opened.
+static bool LoadMtlFile(const std::string &filepath,
+                        std::map<std::string, int> *matMap,
+                        std::vector<material_t> *materials, std::string *warn,
+                        std::string *err) {
+  std::ifstream matIStream(filepath.c_str(), std::ios::in | std::ios::binary);
+  if (!matIStream) {
+    return false;
+  }
+
+  const CompressionType compression = DetectStreamCompression(&matIStream);
+  if (compression == COMPRESSION_NONE) {
+    LoadMtl(matMap, materials, &matIStream, warn, err);
+    return true;
+  }
+
+  DecompressStreamBuf sbuf(&matIStream, compression);
+  std::istream is(&sbuf);
+  LoadMtl(matMap, materials, &is, warn, err);
+  if (err && !sbuf.Error().empty()) {
+    (*err) += sbuf.Error();
+  }
+  return true;
+}
+
 bool MaterialFileReader::operator()(const std::string &matId,
                                     std::vector<material_t> *materials,
                                     std::map<std::string, int> *matMap,
@@ -2489,10 +4412,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
     for (size_t i = 0; i < paths.size(); i++) {
       std::string filepath = JoinPath(paths[i], matId);
 
-      std::ifstream matIStream(filepath.c_str());
-      if (matIStream) {
-        LoadMtl(matMap, materials, &matIStream, warn, err);
-
+      if (LoadMtlFile(filepath, matMap, materials, warn, err)) {
         return true;
       }
     }
@@ -2507,10 +4427,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
 
   } else {
     std::string filepath = matId;
-    std::ifstream matIStream(filepath.c_str());
-    if (matIStream) {
-      LoadMtl(matMap, materials, &matIStream, warn, err);
-
+    if (LoadMtlFile(filepath, matMap, materials, warn, err)) {
       return true;
     }
 
@@ -2557,7 +4474,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   std::stringstream errss;
 
-  std::ifstream ifs(filename);
+  std::ifstream ifs(filename, std::ios::in | std::ios::binary);
   if (!ifs) {
     errss << "Cannot open file [" << filename << "]\n";
     if (err) {
@@ -2577,123 +4494,790 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   }
   MaterialFileReader matFileReader(baseDir);
 
+  const CompressionType compression = DetectStreamCompression(&ifs);
+  if (compression != COMPRESSION_NONE) {
+    DecompressStreamBuf sbuf(&ifs, compression);
+    std::istream is(&sbuf);
+    bool ret = LoadObj(attrib, shapes, materials, warn, err, &is,
+                       &matFileReader, triangulate, default_vcols_fallback);
+    if (!sbuf.Error().empty()) {
+      if (err) {
+        (*err) += sbuf.Error();
+      }
+      return false;
+    }
+    return ret;
+  }
+
   return LoadObj(attrib, shapes, materials, warn, err, &ifs, &matFileReader,
                  triangulate, default_vcols_fallback);
 }
 
-bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
-             std::vector<material_t> *materials, std::string *warn,
-             std::string *err, std::istream *inStream,
-             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
-             bool default_vcols_fallback) {
-  std::stringstream errss;
-
-  std::vector<real_t> v;
-  std::vector<real_t> vertex_weights;  // optional [w] component in `v`
-  std::vector<real_t> vn;
-  std::vector<real_t> vt;
-  std::vector<real_t> vc;
-  std::vector<skin_weight_t> vw;  // tinyobj extension: vertex skin weights
-  std::vector<tag_t> tags;
-  PrimGroup prim_group;
-  std::string name;
-
-  // material
-  std::set<std::string> material_filenames;
-  std::map<std::string, int> material_map;
-  int material = -1;
+// The number of elements in .obj, counted by `PrescanObj`.
+struct CommandCount {
+  size_t num_v;
+  size_t num_vn;
+  size_t num_vt;
+  size_t num_f;
+  size_t num_indices;
+
+  // The largest number of faces(and face indices) between `g`, `o` and
+  // `usemtl` lines, i.e. the size of the face group exported at a time.
+  size_t max_group_f;
+  size_t max_group_indices;
+
+  CommandCount()
+      : num_v(0),
+        num_vn(0),
+        num_vt(0),
+        num_f(0),
+        num_indices(0),
+        max_group_f(0),
+        max_group_indices(0) {}
+};
 
-  // smoothing group id
-  unsigned int current_smoothing_id =
-      0;  // Initial value. 0 means no smoothing.
+// A range of lines of a chunk parsed by the multithreaded loader.
+struct ObjChunkSegment {
+  const char *begin;  // at the beginning of a line
+  const char *end;    // after the line ending of the last line
+  size_t num_lines;
+
+  // false: the lines are parsed by `ObjParser` when the chunk is merged(e.g.
+  // `g`, `usemtl`, or a `f` line which needs `parseTriple`).
+  bool parsed;
+
+  // Lines parsed into `ObjChunk`. All `v`, `vn` and `vt` lines of a segment
+  // precede its `f` lines, so relative indices of the faces are resolved with
+  // the numbers of vertices at the end of the segment.
+  int num_v;
+  int num_vn;
+  int num_vt;
+  size_t num_f;
+
+  // The most negative(relative) index of the faces for each attribute, or 0.
+  int min_v_idx;
+  int min_vn_idx;
+  int min_vt_idx;
+};
 
-  int greatest_v_idx = -1;
-  int greatest_vn_idx = -1;
-  int greatest_vt_idx = -1;
+// `v`, `vn`, `vt` and `f` lines of a chunk of .obj text, parsed by a worker
+// thread of the multithreaded loader and merged in line order by
+// `ObjParser::MergeChunk`.
+struct ObjChunk {
+  vector_of<real_t>::type v;  // x, y, z
+  vector_of<unsigned char>::type v_num_components;  // 3, 4 or 6
+  vector_of<real_t>::type v_extra;  // w(4 components) or r, g, b(6)
+  vector_of<real_t>::type vn;  // empty unless ATTRIBUTE_NORMAL
+  vector_of<real_t>::type vt;  // u, v. empty unless ATTRIBUTE_TEXCOORD
+
+  // Indices as written(1-based, negative = relative, 0 = not specified).
+  vector_of<vertex_index_t>::type face_indices;
+  vector_of<unsigned int>::type face_num_vertices;
+
+  std::vector<ObjChunkSegment> segments;
+};
 
-  shape_t shape;
+//
+// The line grammar of .obj, shared by `LoadObj`(`ObjParser`) and
+// `LoadObjWithCallback`(`CallbackHandler`). Lines are classified and their
+// attributes and indices are parsed here, then passed to `Handler`. `Handler`
+// is a template parameter, so the calls are resolved(and usually inlined) at
+// compile time instead of going through function pointers.
+//
+// `Handler` provides:
+//
+//   // true: indices are passed as written(1-based, negative = relative,
+//   // 0 = not specified). false: resolved to 0-based indices, -1 = not
+//   // specified.
+//   static const bool kRawIndices;
+//
+//   // `r` is `w` when `num_components` is 3 or 4.
+//   void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b,
+//               int num_components);
+//   void Normal(real_t x, real_t y, real_t z);
+//   void Texcoord(real_t x, real_t y, real_t z);
+//
+//   // Vertices of a `f`, `l` or `p` line are appended to the returned array,
+//   // then `Primitive` is called with the offset of the first one. NULL =
+//   // skip the line.
+//   vector_of<vertex_index_t>::type *PrimitiveIndices(ObjLineType type);
+//   void Primitive(ObjLineType type, size_t vertex_offset);
+//
+//   // Other lines(`usemtl`, `mtllib`, `g`, `o`, `s`, `t` and `vw`). `token`
+//   // points to the command. Returns false on a fatal error.
+//   bool Command(ObjLineType type, const char *token);
+//
+template <typename Handler>
+class ObjLineParser {
+ public:
+  ObjLineParser(Handler *handler, std::string *warn, std::string *err)
+      : handler_(handler),
+        warn_(warn),
+        err_(err),
+        attribute_mask_(ATTRIBUTE_ALL),
+        num_v_(0),
+        num_vn_(0),
+        num_vt_(0),
+        face_pattern_(FACE_PATTERN_UNKNOWN),
+        line_num_(0) {}
 
-  bool found_all_colors = true;  // check if all 'v' line has color info
+  ///
+  /// Parse a line. `linebuf` must be terminated by '\0' and must not contain
+  /// the line ending. Returns false when a fatal parse error was found.
+  ///
+  bool ParseLine(const char *linebuf) {
+    line_num_++;
+    return ParseTokens(linebuf, linebuf + strlen(linebuf), true);
+  }
 
-  size_t line_num = 0;
-  std::string linebuf;
-  while (inStream->peek() != -1) {
-    safeGetline(*inStream, linebuf);
+  ///
+  /// Parse a line in [line, line_end) of the input buffer without copying
+  /// it. The line need not be terminated by '\0' and must not contain the
+  /// line ending.
+  ///
+  bool ParseLine(const char *line, const char *line_end) {
+    line_num_++;
+    return ParseTokens(line, line_end, false);
+  }
 
-    line_num++;
+  ///
+  /// Count lines parsed by someone else(`ObjParser::MergeChunk`), so that
+  /// line numbers and relative indices of subsequent lines are correct.
+  ///
+  void SkipLines(size_t num_lines, int num_v, int num_vn, int num_vt) {
+    line_num_ += num_lines;
+    num_v_ += num_v;
+    num_vn_ += num_vn;
+    num_vt_ += num_vt;
+  }
 
-    // Trim newline '\r\n' or '\n'
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
+  int num_v() const { return num_v_; }
+  int num_vn() const { return num_vn_; }
+  int num_vt() const { return num_vt_; }
+
+  void SetAttributeMask(unsigned int attribute_mask) {
+    attribute_mask_ = attribute_mask;
+  }
+
+  size_t line_num() const { return line_num_; }
+
+ private:
+  Handler *handler_;
+  std::string *warn_;
+  std::string *err_;
+  unsigned int attribute_mask_;
+
+  // The number of `v`, `vn` and `vt` lines so far, including skipped ones.
+  int num_v_;
+  int num_vn_;
+  int num_vt_;
+
+  FacePattern face_pattern_;  // of the last `f` line
+
+  size_t line_num_;
+
+  // '\0' terminated copy of a line which is not parsed in place.
+  std::string linebuf_;
+
+  // `terminated`: (*end) is '\0'. Otherwise `v`, `vn`, `vt` and `f` lines are
+  // parsed in place, and other lines are parsed from a '\0' terminated copy.
+  bool ParseTokens(const char *token, const char *end, bool terminated);
+
+  bool ParseCopiedLine(const char *token, const char *end) {
+    linebuf_.assign(token, end);
+    const char *p = linebuf_.c_str();
+    return ParseTokens(p, p + linebuf_.size(), true);
+  }
+
+  // Parses a face vertex of `f`, `l` and `p` lines.
+  bool ParseIndices(const char **token, vertex_index_t *vi,
+                    const warning_context &context) const {
+    if (Handler::kRawIndices) {
+      (*vi) = parseRawTriple(token);
+      return true;
     }
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
+    if (!parseTriple(token, num_v_, num_vn_, num_vt_, vi, context)) {
+      return false;
     }
+    MaskIndices(vi);
+    return true;
+  }
 
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
+  void MaskIndices(vertex_index_t *vi) const {
+    if (!(attribute_mask_ & ATTRIBUTE_NORMAL)) {
+      vi->vn_idx = -1;
+    }
+    if (!(attribute_mask_ & ATTRIBUTE_TEXCOORD)) {
+      vi->vt_idx = -1;
     }
+  }
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
+  // Parses the vertices of a `f`, `l` or `p` line one by one.
+  bool ParseVertices(const char **token, vector_of<vertex_index_t>::type *indices,
+                     const warning_context &context) const {
+    while (!IS_NEW_LINE((*token)[0])) {
+      vertex_index_t vi;
+      if (!ParseIndices(token, &vi, context)) {
+        return false;
+      }
+      indices->push_back(vi);
+      size_t n = strspn((*token), " \t\r");
+      (*token) += n;
+    }
 
-    assert(token);
-    if (token[0] == '\0') continue;  // empty line
+    return true;
+  }
 
-    if (token[0] == '#') continue;  // comment line
+  // Parses the vertices of a `f` line in [(*token), end) with
+  // `parseTripleAs<Pattern>`. A vertex which does not match is parsed by
+  // `ParseIndices`, and the pattern is detected again at the next face.
+  // When the line is not `terminated` by '\0', `ParseIndices` can not be used
+  // and false is returned for such a vertex. The caller then parses a copy of
+  // the line.
+  template <FacePattern Pattern>
+  bool ParseFaceVertices(const char **token, const char *end, bool terminated,
+                         vector_of<vertex_index_t>::type *indices,
+                         const warning_context &context) {
+    while (((*token) < end) && !IS_NEW_LINE((*token)[0])) {
+      vertex_index_t vi;
+      if (parseTripleAs<Pattern>(token, end, num_v_, num_vn_, num_vt_, &vi)) {
+        MaskIndices(&vi);
+      } else {
+        face_pattern_ = FACE_PATTERN_UNKNOWN;
+        if (!terminated || !ParseIndices(token, &vi, context)) {
+          return false;
+        }
+      }
+
+      indices->push_back(vi);
+      while (((*token) < end) &&
+             (IS_SPACE((*token)[0]) || ((*token)[0] == '\r'))) {
+        (*token)++;
+      }
+    }
+
+    return true;
+  }
+
+  bool ParseFace(const char **token, const char *end, bool terminated,
+                 vector_of<vertex_index_t>::type *indices,
+                 const warning_context &context) {
+    if (Handler::kRawIndices) {
+      return terminated && ParseVertices(token, indices, context);
+    }
+
+    if (face_pattern_ == FACE_PATTERN_UNKNOWN) {
+      face_pattern_ = detectFacePattern(*token, end);
+    }
+
+    switch (face_pattern_) {
+      case FACE_PATTERN_V:
+        return ParseFaceVertices<FACE_PATTERN_V>(token, end, terminated,
+                                                 indices, context);
+      case FACE_PATTERN_V_VT:
+        return ParseFaceVertices<FACE_PATTERN_V_VT>(token, end, terminated,
+                                                    indices, context);
+      case FACE_PATTERN_V_VN:
+        return ParseFaceVertices<FACE_PATTERN_V_VN>(token, end, terminated,
+                                                    indices, context);
+      default:
+        return ParseFaceVertices<FACE_PATTERN_V_VT_VN>(token, end, terminated,
+                                                       indices, context);
+    }
+  }
+};
+
+template <typename Handler>
+bool ObjLineParser<Handler>::ParseTokens(const char *token, const char *end,
+                                         bool terminated) {
+  std::string *err = err_;
+
+  // Skip leading space.
+  while ((token < end) && IS_SPACE((*token))) {
+    token++;
+  }
 
+  assert(token);
+  if ((token == end) || (token[0] == '\0')) return true;  // empty line
+
+  if (token[0] == '#') return true;  // comment line
+
+  // `classifyObjLine` reads up to 7 bytes.
+  if (!terminated && ((end - token) < 7)) {
+    return ParseCopiedLine(token, end);
+  }
+
+  warning_context context;
+  context.warn = warn_;
+  context.line_number = line_num_;
+
+  const ObjLineType type = classifyObjLine(token);
+  if (!terminated && (type != OBJ_LINE_V) && (type != OBJ_LINE_VN) &&
+      (type != OBJ_LINE_VT) && (type != OBJ_LINE_F) &&
+      (type != OBJ_LINE_UNKNOWN)) {
+    // Less frequent lines are parsed by helpers which need '\0'.
+    return ParseCopiedLine(token, end);
+  }
+
+  switch (type) {
     // vertex
-    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+    case OBJ_LINE_V: {
+      num_v_++;
       token += 2;
       real_t x, y, z;
       real_t r, g, b;
 
-      int num_components = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
-      found_all_colors &= (num_components == 6);
-
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
-
-      vertex_weights.push_back(
-          r);  // r = w, and initialized to 1.0 when `w` component is not found.
-
-      if ((num_components == 6) || default_vcols_fallback) {
-        vc.push_back(r);
-        vc.push_back(g);
-        vc.push_back(b);
+      int num_components;
+      if (attribute_mask_ & ATTRIBUTE_COLOR) {
+        num_components =
+            parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token, end);
+      } else {
+        num_components = parseVertexWithoutColor(&x, &y, &z, &r, &token, end);
+        g = b = static_cast<real_t>(1.0);
       }
 
-      continue;
+      handler_->Vertex(x, y, z, r, g, b, num_components);
+      return true;
     }
 
     // normal
-    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+    case OBJ_LINE_VN: {
+      num_vn_++;
+      if (!(attribute_mask_ & ATTRIBUTE_NORMAL)) {
+        return true;
+      }
       token += 3;
       real_t x, y, z;
-      parseReal3(&x, &y, &z, &token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
-      continue;
+      parseReal3(&x, &y, &z, &token, end);
+      handler_->Normal(x, y, z);
+      return true;
     }
 
     // texcoord
-    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+    case OBJ_LINE_VT: {
+      num_vt_++;
+      if (!(attribute_mask_ & ATTRIBUTE_TEXCOORD)) {
+        return true;
+      }
       token += 3;
-      real_t x, y;
-      parseReal2(&x, &y, &token);
-      vt.push_back(x);
-      vt.push_back(y);
+      real_t x, y, z;  // y and z are optional. default = 0.0
+      parseReal3(&x, &y, &z, &token, end);
+      handler_->Texcoord(x, y, z);
+      return true;
+    }
+
+    // line, points
+    case OBJ_LINE_L:
+    case OBJ_LINE_P: {
+      vector_of<vertex_index_t>::type *indices = handler_->PrimitiveIndices(type);
+      if (!indices) {
+        return true;
+      }
+      token += 2;
+
+      const size_t vertex_offset = indices->size();
+      if (!ParseVertices(&token, indices, context)) {
+        if (err) {
+          (*err) += std::string("Failed to parse `") +
+                    ((type == OBJ_LINE_L) ? "l" : "p") +
+                    "' line (e.g. a zero value for vertex index. Line " +
+                    toString(line_num_) + ").\n";
+        }
+        return false;
+      }
+
+      handler_->Primitive(type, vertex_offset);
+      return true;
+    }
+
+    // face
+    case OBJ_LINE_F: {
+      vector_of<vertex_index_t>::type *indices = handler_->PrimitiveIndices(type);
+      if (!indices) {
+        return true;
+      }
+      token += 2;
+      while ((token < end) && IS_SPACE((*token))) {
+        token++;
+      }
+
+      const size_t vertex_offset = indices->size();
+      const char *vertices = token;
+      if (!terminated &&
+          !ParseFace(&token, end, false, indices, context)) {
+        // A vertex needs `parseTriple`(e.g. for its warnings or errors).
+        // Parse the vertices again from a '\0' terminated copy.
+        indices->resize(vertex_offset);
+        linebuf_.assign(vertices, end);
+        token = linebuf_.c_str();
+        end = token + linebuf_.size();
+        terminated = true;
+      }
+      if (terminated && !ParseFace(&token, end, true, indices, context)) {
+        if (err) {
+          (*err) +=
+              "Failed to parse `f' line (e.g. a zero value for vertex index "
+              "or invalid relative vertex index). Line " +
+              toString(line_num_) + ").\n";
+        }
+        return false;
+      }
+
+      handler_->Primitive(type, vertex_offset);
+      return true;
+    }
+
+    // skin weight. tinyobj extension
+    case OBJ_LINE_VW:
+      if (!(attribute_mask_ & ATTRIBUTE_SKIN_WEIGHT)) {
+        return true;
+      }
+      return handler_->Command(type, token);
+
+    // tag. tinyobj extension
+    case OBJ_LINE_T:
+      if (!(attribute_mask_ & ATTRIBUTE_TAG)) {
+        return true;
+      }
+      return handler_->Command(type, token);
+
+    case OBJ_LINE_USEMTL:
+    case OBJ_LINE_MTLLIB:
+    case OBJ_LINE_G:
+    case OBJ_LINE_O:
+    case OBJ_LINE_S:
+      return handler_->Command(type, token);
+
+    default:
+      break;
+  }
+
+  // Ignore unknown command.
+  return true;
+}
+
+// Loads the materials of a `mtllib` line. `token` points to the file names.
+// Returns true when one of the files is loaded(or was loaded before).
+static bool LoadMtllib(const char *token, MaterialReader *readMatFn,
+                       std::set<std::string> *material_filenames,
+                       std::vector<material_t> *materials,
+                       std::map<std::string, int> *material_map,
+                       size_t line_num, std::string *warn, std::string *err) {
+  std::vector<std::string> filenames;
+  SplitString(std::string(token), ' ', '\\', filenames);
+
+  if (filenames.empty()) {
+    if (warn) {
+      std::stringstream ss;
+      ss << "Looks like empty filename for mtllib. Use default "
+            "material (line "
+         << line_num << ".)\n";
+
+      (*warn) += ss.str();
+    }
+    return false;
+  }
+
+  bool found = false;
+  for (size_t s = 0; s < filenames.size(); s++) {
+    if (material_filenames->count(filenames[s]) > 0) {
+      found = true;
       continue;
     }
 
+    std::string warn_mtl;
+    std::string err_mtl;
+    bool ok = (*readMatFn)(filenames[s].c_str(), materials, material_map,
+                           &warn_mtl, &err_mtl);
+    if (warn && (!warn_mtl.empty())) {
+      (*warn) += warn_mtl;
+    }
+
+    if (err && (!err_mtl.empty())) {
+      (*err) += err_mtl;
+    }
+
+    if (ok) {
+      found = true;
+      material_filenames->insert(filenames[s]);
+      break;
+    }
+  }
+
+  if (!found) {
+    if (warn) {
+      (*warn) +=
+          "Failed to load material file(s). Use default "
+          "material.\n";
+    }
+  }
+
+  return found;
+}
+
+//
+// Line-by-line .obj parser. Shared by the stream, memory and multithreaded
+// code paths of `LoadObj`. Lines are parsed by `ObjLineParser`, which calls
+// back `Vertex`, `Primitive`, `Command`, ... of this class.
+//
+class ObjParser {
+ public:
+  ObjParser(std::vector<shape_t> *shapes, std::vector<material_t> *materials,
+            MaterialReader *readMatFn, bool triangulate,
+            bool default_vcols_fallback, std::string *warn, std::string *err)
+      : shapes_(shapes),
+        materials_(materials),
+        readMatFn_(readMatFn),
+        triangulate_(triangulate),
+        default_vcols_fallback_(default_vcols_fallback),
+        default_vertex_attribs_(true),
+        attribute_mask_(ATTRIBUTE_ALL),
+        num_threads_(1),
+        warn_(warn),
+        err_(err),
+        line_parser_(this, warn, err),
+        material_(-1),
+        current_smoothing_id_(0),
+        greatest_v_idx_(-1),
+        greatest_vn_idx_(-1),
+        greatest_vt_idx_(-1),
+        found_all_colors_(true) {}
+
+  ///
+  /// Parse a line. `linebuf` must be terminated by '\0' and must not contain
+  /// the line ending. Returns false when a fatal parse error was found.
+  ///
+  bool ParseLine(const char *linebuf) {
+    return line_parser_.ParseLine(linebuf);
+  }
+
+  ///
+  /// Parse a line in [line, line_end) in place(no '\0' is required).
+  ///
+  bool ParseLine(const char *line, const char *line_end) {
+    return line_parser_.ParseLine(line, line_end);
+  }
+
+  ///
+  /// Flush the last shape and move vertex attributes to `attrib`.
+  ///
+  void Finish(attrib_t *attrib);
+
+  ///
+  /// Add the lines of `chunk`(parsed by `ParseObjChunk`) as if they were
+  /// parsed by `ParseLine`. Chunks must be merged in line order. Returns false
+  /// when a fatal parse error was found.
+  ///
+  bool MergeChunk(const ObjChunk &chunk);
+
+  ///
+  /// Parse the lines in [begin, end) by `ParseLine`.
+  ///
+  bool ParseLines(const char *begin, const char *end);
+
+  ///
+  /// The number of threads used to triangulate large groups of faces.
+  ///
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
+  ///
+  /// false = do not fill `vertex_weights` and `colors` with default values
+  /// unless some `v` line has `w` or vertex color.
+  /// Must be set before `ReserveAttribs`.
+  ///
+  void SetDefaultVertexAttribs(bool default_vertex_attribs) {
+    default_vertex_attribs_ = default_vertex_attribs;
+  }
+
+  ///
+  /// Attributes to load(`ObjReaderConfig::attribute_mask`).
+  /// Must be set before `ReserveAttribs`.
+  ///
+  void SetAttributeMask(unsigned int attribute_mask) {
+    attribute_mask_ = attribute_mask;
+    line_parser_.SetAttributeMask(attribute_mask);
+  }
+
+  void ReserveAttribs(size_t num_v, size_t num_vn, size_t num_vt) {
+    v_.reserve(3 * num_v);
+    if (default_vertex_attribs_) {
+      vertex_weights_.reserve(num_v);
+      if (attribute_mask_ & ATTRIBUTE_COLOR) {
+        vc_.reserve(3 * num_v);
+      }
+    }
+    if (attribute_mask_ & ATTRIBUTE_NORMAL) {
+      vn_.reserve(3 * num_vn);
+    }
+    if (attribute_mask_ & ATTRIBUTE_TEXCOORD) {
+      vt_.reserve(2 * num_vt);
+    }
+  }
+
+  void Reserve(const CommandCount &count) {
+    ReserveAttribs(count.num_v, count.num_vn, count.num_vt);
+    prim_group_.faceGroup.reserve(count.max_group_f);
+    prim_group_.faceIndices.reserve(count.max_group_indices);
+  }
+
+  ///
+  /// Vertex positions parsed so far.
+  ///
+  const vector_of<real_t>::type &vertices() const { return v_; }
+
+  // `ObjLineParser` handler.
+  static const bool kRawIndices = false;
+
+  void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b,
+              int num_components);
+
+  void Normal(real_t x, real_t y, real_t z) {
+    vn_.push_back(x);
+    vn_.push_back(y);
+    vn_.push_back(z);
+  }
+
+  void Texcoord(real_t x, real_t y, real_t z) {
+    (void)z;
+    vt_.push_back(x);
+    vt_.push_back(y);
+  }
+
+  vector_of<vertex_index_t>::type *PrimitiveIndices(ObjLineType type) {
+    if (type == OBJ_LINE_F) {
+      return &prim_group_.faceIndices;
+    } else if (type == OBJ_LINE_L) {
+      return &prim_group_.lineIndices;
+    }
+    return &prim_group_.pointsIndices;
+  }
+
+  void Primitive(ObjLineType type, size_t vertex_offset);
+
+  bool Command(ObjLineType type, const char *token);
+
+ private:
+  std::vector<shape_t> *shapes_;
+  std::vector<material_t> *materials_;
+  MaterialReader *readMatFn_;
+  bool triangulate_;
+  bool default_vcols_fallback_;
+  bool default_vertex_attribs_;
+  unsigned int attribute_mask_;
+  int num_threads_;
+  std::string *warn_;
+  std::string *err_;
+  ObjLineParser<ObjParser> line_parser_;
+
+  vector_of<real_t>::type v_;
+  vector_of<real_t>::type vertex_weights_;  // optional [w] component in `v`
+  vector_of<real_t>::type vn_;
+  vector_of<real_t>::type vt_;
+  vector_of<real_t>::type vc_;
+  vector_of<skin_weight_t>::type vw_;  // tinyobj extension: vertex skin weights
+  vector_of<tag_t>::type tags_;
+  PrimGroup prim_group_;
+  std::string name_;
+
+  // material
+  std::set<std::string> material_filenames_;
+  std::map<std::string, int> material_map_;
+  int material_;
+
+  // smoothing group id. 0 means no smoothing.
+  unsigned int current_smoothing_id_;
+
+  int greatest_v_idx_;
+  int greatest_vn_idx_;
+  int greatest_vt_idx_;
+
+  shape_t shape_;
+
+  bool found_all_colors_;  // check if all 'v' line has color info
+};
+
+void ObjParser::Vertex(real_t x, real_t y, real_t z, real_t r, real_t g,
+                       real_t b, int num_components) {
+  found_all_colors_ &= (num_components == 6);
+
+  v_.push_back(x);
+  v_.push_back(y);
+  v_.push_back(z);
+
+  if (default_vertex_attribs_) {
+    vertex_weights_.push_back(
+        r);  // r = w, and initialized to 1.0 when `w` component is not found.
+
+    if ((attribute_mask_ & ATTRIBUTE_COLOR) &&
+        ((num_components == 6) || default_vcols_fallback_)) {
+      vc_.push_back(r);
+      vc_.push_back(g);
+      vc_.push_back(b);
+    }
+  } else {
+    // Arrays are created at the first `v` line which has the data, and
+    // filled with default values for the preceding vertices.
+    const size_t num_v = v_.size() / 3;
+    if ((num_components == 4) || !vertex_weights_.empty()) {
+      vertex_weights_.resize(num_v - 1, static_cast<real_t>(1.0));
+      vertex_weights_.push_back((num_components == 4)
+                                    ? r
+                                    : static_cast<real_t>(1.0));
+    }
+    if ((attribute_mask_ & ATTRIBUTE_COLOR) &&
+        ((num_components == 6) || !vc_.empty())) {
+      vc_.resize(3 * (num_v - 1), static_cast<real_t>(1.0));
+      if (num_components == 6) {
+        vc_.push_back(r);
+        vc_.push_back(g);
+        vc_.push_back(b);
+      } else {
+        vc_.resize(3 * num_v, static_cast<real_t>(1.0));
+      }
+    }
+  }
+}
+
+void ObjParser::Primitive(ObjLineType type, size_t vertex_offset) {
+  if (type == OBJ_LINE_F) {
+    for (size_t i = vertex_offset; i < prim_group_.faceIndices.size(); i++) {
+      const vertex_index_t &vi = prim_group_.faceIndices[i];
+      greatest_v_idx_ = greatest_v_idx_ > vi.v_idx ? greatest_v_idx_ : vi.v_idx;
+      greatest_vn_idx_ =
+          greatest_vn_idx_ > vi.vn_idx ? greatest_vn_idx_ : vi.vn_idx;
+      greatest_vt_idx_ =
+          greatest_vt_idx_ > vi.vt_idx ? greatest_vt_idx_ : vi.vt_idx;
+    }
+
+    face_t face;
+    face.smoothing_group_id = current_smoothing_id_;
+    face.vertex_offset = vertex_offset;
+    face.num_vertices = static_cast<unsigned int>(
+        prim_group_.faceIndices.size() - vertex_offset);
+    prim_group_.faceGroup.push_back(face);
+  } else if (type == OBJ_LINE_L) {
+    __line_t line;
+    line.vertex_offset = vertex_offset;
+    line.num_vertices = static_cast<unsigned int>(
+        prim_group_.lineIndices.size() - vertex_offset);
+    prim_group_.lineGroup.push_back(line);
+  } else {
+    __points_t pts;
+    pts.vertex_offset = vertex_offset;
+    pts.num_vertices = static_cast<unsigned int>(
+        prim_group_.pointsIndices.size() - vertex_offset);
+    prim_group_.pointsGroup.push_back(pts);
+  }
+}
+
+bool ObjParser::Command(ObjLineType type, const char *token) {
+  std::string *warn = warn_;
+  std::string *err = err_;
+  const size_t line_num = line_parser_.line_num();
+
+  switch (type) {
     // skin weight. tinyobj extension
-    if (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))) {
+    case OBJ_LINE_VW: {
       token += 3;
 
       // vw <vid> <joint_0> <weight_0> <joint_1> <weight_1> ...
@@ -2736,218 +5320,67 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         token += n;
       }
 
-      vw.push_back(sw);
+      vw_.push_back(sw);
+      return true;
     }
 
-    warning_context context;
-    context.warn = warn;
-    context.line_number = line_num;
+    // use mtl
+    case OBJ_LINE_USEMTL: {
+      token += 6;
+      std::string namebuf = parseString(&token);
 
-    // line
-    if (token[0] == 'l' && IS_SPACE((token[1]))) {
-      token += 2;
+      int newMaterialId = -1;
+      std::map<std::string, int>::const_iterator it =
+          material_map_.find(namebuf);
+      if (it != material_map_.end()) {
+        newMaterialId = it->second;
+      } else {
+        // { error!! material not found }
+        if (warn) {
+          (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
+        }
+      }
 
-      __line_t line;
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `l' line (e.g. a zero value for vertex index. "
-                "Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
-        }
-
-        line.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      prim_group.lineGroup.push_back(line);
-
-      continue;
-    }
-
-    // points
-    if (token[0] == 'p' && IS_SPACE((token[1]))) {
-      token += 2;
-
-      __points_t pts;
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `p' line (e.g. a zero value for vertex index. "
-                "Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
-        }
-
-        pts.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      prim_group.pointsGroup.push_back(pts);
-
-      continue;
-    }
-
-    // face
-    if (token[0] == 'f' && IS_SPACE((token[1]))) {
-      token += 2;
-      token += strspn(token, " \t");
-
-      face_t face;
-
-      face.smoothing_group_id = current_smoothing_id;
-      face.vertex_indices.reserve(3);
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `f' line (e.g. a zero value for vertex index "
-                "or invalid relative vertex index). Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
-        }
-
-        greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
-        greatest_vn_idx =
-            greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
-        greatest_vt_idx =
-            greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
-
-        face.vertex_indices.push_back(vi);
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      // replace with emplace_back + std::move on C++11
-      prim_group.faceGroup.push_back(face);
-
-      continue;
-    }
-
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6))) {
-      token += 6;
-      std::string namebuf = parseString(&token);
-
-      int newMaterialId = -1;
-      std::map<std::string, int>::const_iterator it =
-          material_map.find(namebuf);
-      if (it != material_map.end()) {
-        newMaterialId = it->second;
-      } else {
-        // { error!! material not found }
-        if (warn) {
-          (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
-        }
-      }
-
-      if (newMaterialId != material) {
+      if (newMaterialId != material_) {
         // Create per-face material. Thus we don't add `shape` to `shapes` at
         // this time.
         // just clear `faceGroup` after `exportGroupsToShape()` call.
-        exportGroupsToShape(&shape, prim_group, tags, material, name,
-                            triangulate, v, warn);
-        prim_group.faceGroup.clear();
-        material = newMaterialId;
+        exportGroupsToShape(&shape_, prim_group_, tags_, material_, name_,
+                            triangulate_, num_threads_, v_, warn);
+        prim_group_.clearFaces();
+        material_ = newMaterialId;
       }
 
-      continue;
+      return true;
     }
 
     // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-      if (readMatFn) {
+    case OBJ_LINE_MTLLIB: {
+      if (readMatFn_) {
         token += 7;
-
-        std::vector<std::string> filenames;
-        SplitString(std::string(token), ' ', '\\', filenames);
-
-        if (filenames.empty()) {
-          if (warn) {
-            std::stringstream ss;
-            ss << "Looks like empty filename for mtllib. Use default "
-                  "material (line "
-               << line_num << ".)\n";
-
-            (*warn) += ss.str();
-          }
-        } else {
-          bool found = false;
-          for (size_t s = 0; s < filenames.size(); s++) {
-            if (material_filenames.count(filenames[s]) > 0) {
-              found = true;
-              continue;
-            }
-
-            std::string warn_mtl;
-            std::string err_mtl;
-            bool ok = (*readMatFn)(filenames[s].c_str(), materials,
-                                   &material_map, &warn_mtl, &err_mtl);
-            if (warn && (!warn_mtl.empty())) {
-              (*warn) += warn_mtl;
-            }
-
-            if (err && (!err_mtl.empty())) {
-              (*err) += err_mtl;
-            }
-
-            if (ok) {
-              found = true;
-              material_filenames.insert(filenames[s]);
-              break;
-            }
-          }
-
-          if (!found) {
-            if (warn) {
-              (*warn) +=
-                  "Failed to load material file(s). Use default "
-                  "material.\n";
-            }
-          }
-        }
+        LoadMtllib(token, readMatFn_, &material_filenames_, materials_,
+                   &material_map_, line_num, warn, err);
       }
 
-      continue;
+      return true;
     }
 
     // group name
-    if (token[0] == 'g' && IS_SPACE((token[1]))) {
+    case OBJ_LINE_G: {
       // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
+      bool ret = exportGroupsToShape(&shape_, prim_group_, tags_, material_,
+                                     name_, triangulate_, num_threads_, v_,
+                                     warn);
       (void)ret;  // return value not used.
 
-      if (shape.mesh.indices.size() > 0) {
-        shapes->push_back(shape);
+      if (shape_.mesh.indices.size() > 0) {
+        pushBackMove(shapes_, &shape_);
       }
 
-      shape = shape_t();
+      shape_ = shape_t();
 
       // material = -1;
-      prim_group.clear();
+      prim_group_.clear();
 
       std::vector<std::string> names;
 
@@ -2965,7 +5398,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
           std::stringstream ss;
           ss << "Empty group name. line: " << line_num << "\n";
           (*warn) += ss.str();
-          name = "";
+          name_ = "";
         }
       } else {
         std::stringstream ss;
@@ -2979,38 +5412,39 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
           ss << " " << names[i];
         }
 
-        name = ss.str();
+        name_ = ss.str();
       }
 
-      continue;
+      return true;
     }
 
     // object name
-    if (token[0] == 'o' && IS_SPACE((token[1]))) {
+    case OBJ_LINE_O: {
       // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
+      bool ret = exportGroupsToShape(&shape_, prim_group_, tags_, material_,
+                                     name_, triangulate_, num_threads_, v_,
+                                     warn);
       (void)ret;  // return value not used.
 
-      if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 ||
-          shape.points.indices.size() > 0) {
-        shapes->push_back(shape);
+      if (shape_.mesh.indices.size() > 0 || shape_.lines.indices.size() > 0 ||
+          shape_.points.indices.size() > 0) {
+        pushBackMove(shapes_, &shape_);
       }
 
       // material = -1;
-      prim_group.clear();
-      shape = shape_t();
+      prim_group_.clear();
+      shape_ = shape_t();
 
       // @todo { multiple object name? }
       token += 2;
       std::stringstream ss;
       ss << token;
-      name = ss.str();
+      name_ = ss.str();
 
-      continue;
+      return true;
     }
 
-    if (token[0] == 't' && IS_SPACE(token[1])) {
+    case OBJ_LINE_T: {
       const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
       tag_t tag;
 
@@ -3057,12 +5491,12 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         tag.stringValues[i] = parseString(&token);
       }
 
-      tags.push_back(tag);
+      pushBackMove(&tags_, &tag);
 
-      continue;
+      return true;
     }
 
-    if (token[0] == 's' && IS_SPACE(token[1])) {
+    case OBJ_LINE_S: {
       // smoothing group id
       token += 2;
 
@@ -3070,47 +5504,54 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       token += strspn(token, " \t");  // skip space
 
       if (token[0] == '\0') {
-        continue;
+        return true;
       }
 
       if (token[0] == '\r' || token[1] == '\n') {
-        continue;
+        return true;
       }
 
       if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
           token[2] == 'f') {
-        current_smoothing_id = 0;
+        current_smoothing_id_ = 0;
       } else {
         // assume number
         int smGroupId = parseInt(&token);
         if (smGroupId < 0) {
           // parse error. force set to 0.
           // FIXME(syoyo): Report warning.
-          current_smoothing_id = 0;
+          current_smoothing_id_ = 0;
         } else {
-          current_smoothing_id = static_cast<unsigned int>(smGroupId);
+          current_smoothing_id_ = static_cast<unsigned int>(smGroupId);
         }
       }
 
-      continue;
+      return true;
     }  // smoothing group id
-
-    // Ignore unknown command.
+    default:
+      break;
   }
 
+  return true;
+}
+
+void ObjParser::Finish(attrib_t *attrib) {
+  std::string *warn = warn_;
+  const size_t line_num = line_parser_.line_num();
+
   // not all vertices have colors, no default colors desired? -> clear colors
-  if (!found_all_colors && !default_vcols_fallback) {
-    vc.clear();
+  if (!found_all_colors_ && !default_vcols_fallback_) {
+    vc_.clear();
   }
 
-  if (greatest_v_idx >= static_cast<int>(v.size() / 3)) {
+  if (greatest_v_idx_ >= static_cast<int>(v_.size() / 3)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex indices out of bounds (line " << line_num << ".)\n\n";
       (*warn) += ss.str();
     }
   }
-  if (greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
+  if (greatest_vn_idx_ >= static_cast<int>(vn_.size() / 3)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex normal indices out of bounds (line " << line_num
@@ -3118,7 +5559,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       (*warn) += ss.str();
     }
   }
-  if (greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
+  if (greatest_vt_idx_ >= static_cast<int>(vt_.size() / 2)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex texcoord indices out of bounds (line " << line_num
@@ -3127,331 +5568,2080 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     }
   }
 
-  bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                 triangulate, v, warn);
+  bool ret = exportGroupsToShape(&shape_, prim_group_, tags_, material_, name_,
+                                 triangulate_, num_threads_, v_, warn);
   // exportGroupsToShape return false when `usemtl` is called in the last
   // line.
   // we also add `shape` to `shapes` when `shape.mesh` has already some
   // faces(indices)
-  if (ret || shape.mesh.indices
+  if (ret || shape_.mesh.indices
                  .size()) {  // FIXME(syoyo): Support other prims(e.g. lines)
-    shapes->push_back(shape);
+    pushBackMove(shapes_, &shape_);
   }
-  prim_group.clear();  // for safety
-
-  if (err) {
-    (*err) += errss.str();
-  }
-
-  attrib->vertices.swap(v);
-  attrib->vertex_weights.swap(vertex_weights);
-  attrib->normals.swap(vn);
-  attrib->texcoords.swap(vt);
-  attrib->texcoord_ws.swap(vt);
-  attrib->colors.swap(vc);
-  attrib->skin_weights.swap(vw);
-
-  return true;
+  prim_group_.clear();  // for safety
+
+  attrib->vertices.swap(v_);
+  attrib->vertex_weights.swap(vertex_weights_);
+  attrib->normals.swap(vn_);
+  attrib->texcoords.swap(vt_);
+  attrib->texcoord_ws.swap(vt_);
+  attrib->colors.swap(vc_);
+  attrib->skin_weights.swap(vw_);
 }
 
-bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
-                         void *user_data /*= NULL*/,
-                         MaterialReader *readMatFn /*= NULL*/,
-                         std::string *warn, /* = NULL*/
-                         std::string *err /*= NULL*/) {
-  std::stringstream errss;
-
-  // material
-  std::set<std::string> material_filenames;
-  std::map<std::string, int> material_map;
-  int material_id = -1;  // -1 = invalid
-
-  std::vector<index_t> indices;
-  std::vector<material_t> materials;
-  std::vector<std::string> names;
-  names.reserve(2);
-  std::vector<const char *> names_out;
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *warn,
+             std::string *err, std::istream *inStream,
+             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
+             bool default_vcols_fallback) {
+  ObjParser parser(shapes, materials, readMatFn, triangulate,
+                   default_vcols_fallback, warn, err);
 
   std::string linebuf;
-  while (inStream.peek() != -1) {
-    safeGetline(inStream, linebuf);
+  while (inStream->peek() != -1) {
+    safeGetline(*inStream, linebuf);
 
-    // Trim newline '\r\n' or '\n'
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
-    }
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
+    if (!parser.ParseLine(linebuf.c_str())) {
+      return false;
     }
+  }
 
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
-    }
+  parser.Finish(attrib);
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
+  return true;
+}
 
-    assert(token);
-    if (token[0] == '\0') continue;  // empty line
+// Returns the position of the line ending('\n' or '\r') of the line starting
+// at `p`, or `end` for the last line without line ending.
+static inline const char *FindLineEnding(const char *p, const char *end) {
+  return ScanBytes(p, end, '\n', '\r', '\r', /* match */ true);
+}
 
-    if (token[0] == '#') continue;  // comment line
+// Skips leading ' ' and '\t' in [p, end).
+static inline const char *SkipSpaces(const char *p, const char *end) {
+  return ScanBytes(p, end, ' ', '\t', '\t', /* match */ false);
+}
 
-    // vertex
-    if (token[0] == 'v' && IS_SPACE((token[1]))) {
-      token += 2;
-      real_t x, y, z;
-      real_t r, g, b;
+// Skips a line ending('\n', '\r\n' or '\r') found by `FindLineEnding`.
+// Same rule as `safeGetline`.
+static inline const char *SkipLineEnding(const char *p, const char *end) {
+  if (p >= end) {
+    return end;
+  }
+  if ((*p) == '\r') {
+    p++;
+    if ((p < end) && ((*p) == '\n')) {
+      p++;
+    }
+    return p;
+  }
+  return p + 1;
+}
 
-      int num_components = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
-      if (callback.vertex_cb) {
-        callback.vertex_cb(user_data, x, y, z, r);  // r=w is optional
+bool ObjParser::MergeChunk(const ObjChunk &chunk) {
+  size_t v = 0;
+  size_t v_extra = 0;
+  size_t vn = 0;
+  size_t vt = 0;
+  size_t f = 0;
+  size_t face_index = 0;
+
+  for (size_t s = 0; s < chunk.segments.size(); s++) {
+    const ObjChunkSegment &segment = chunk.segments[s];
+
+    const int num_v = line_parser_.num_v() + segment.num_v;
+    const int num_vn = line_parser_.num_vn() + segment.num_vn;
+    const int num_vt = line_parser_.num_vt() + segment.num_vt;
+
+    // A relative index out of range is a parse error of `ParseLine`, so such
+    // a segment is parsed again to get the same error.
+    const bool valid_indices = ((num_v + segment.min_v_idx) >= 0) &&
+                               ((num_vn + segment.min_vn_idx) >= 0) &&
+                               ((num_vt + segment.min_vt_idx) >= 0);
+
+    if (!segment.parsed || !valid_indices) {
+      if (!ParseLines(segment.begin, segment.end)) {
+        return false;
       }
-      if (callback.vertex_color_cb) {
-        bool found_color = (num_components == 6);
-        callback.vertex_color_cb(user_data, x, y, z, r, g, b, found_color);
+
+      for (int i = 0; i < segment.num_v; i++, v++) {
+        const int num_components = chunk.v_num_components[v];
+        v_extra += (num_components == 4) ? 1 : ((num_components == 6) ? 3 : 0);
+      }
+      for (size_t i = 0; i < segment.num_f; i++, f++) {
+        face_index += chunk.face_num_vertices[f];
+      }
+    } else {
+      for (int i = 0; i < segment.num_v; i++, v++) {
+        const int num_components = chunk.v_num_components[v];
+        real_t r = static_cast<real_t>(1.0);
+        real_t g = static_cast<real_t>(1.0);
+        real_t b = static_cast<real_t>(1.0);
+        if (num_components == 4) {
+          r = chunk.v_extra[v_extra++];
+        } else if (num_components == 6) {
+          r = chunk.v_extra[v_extra++];
+          g = chunk.v_extra[v_extra++];
+          b = chunk.v_extra[v_extra++];
+        }
+        Vertex(chunk.v[3 * v + 0], chunk.v[3 * v + 1], chunk.v[3 * v + 2], r,
+               g, b, num_components);
       }
-      continue;
-    }
 
-    // normal
-    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-      token += 3;
-      real_t x, y, z;
-      parseReal3(&x, &y, &z, &token);
-      if (callback.normal_cb) {
-        callback.normal_cb(user_data, x, y, z);
+      if (attribute_mask_ & ATTRIBUTE_NORMAL) {
+        const size_t n = 3 * size_t(segment.num_vn);
+        vn_.insert(vn_.end(), chunk.vn.begin() + std::ptrdiff_t(vn),
+                   chunk.vn.begin() + std::ptrdiff_t(vn + n));
+      }
+      if (attribute_mask_ & ATTRIBUTE_TEXCOORD) {
+        const size_t n = 2 * size_t(segment.num_vt);
+        vt_.insert(vt_.end(), chunk.vt.begin() + std::ptrdiff_t(vt),
+                   chunk.vt.begin() + std::ptrdiff_t(vt + n));
       }
-      continue;
-    }
 
-    // texcoord
-    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-      token += 3;
-      real_t x, y, z;  // y and z are optional. default = 0.0
-      parseReal3(&x, &y, &z, &token);
-      if (callback.texcoord_cb) {
-        callback.texcoord_cb(user_data, x, y, z);
+      line_parser_.SkipLines(segment.num_lines, segment.num_v, segment.num_vn,
+                             segment.num_vt);
+
+      for (size_t i = 0; i < segment.num_f; i++, f++) {
+        const size_t vertex_offset = prim_group_.faceIndices.size();
+        for (unsigned int k = 0; k < chunk.face_num_vertices[f];
+             k++, face_index++) {
+          vertex_index_t vi;
+          resolveTriple(chunk.face_indices[face_index], num_v, num_vn, num_vt,
+                        &vi);
+          if (!(attribute_mask_ & ATTRIBUTE_NORMAL)) {
+            vi.vn_idx = -1;
+          }
+          if (!(attribute_mask_ & ATTRIBUTE_TEXCOORD)) {
+            vi.vt_idx = -1;
+          }
+          prim_group_.faceIndices.push_back(vi);
+        }
+        Primitive(OBJ_LINE_F, vertex_offset);
       }
-      continue;
     }
 
-    // face
-    if (token[0] == 'f' && IS_SPACE((token[1]))) {
-      token += 2;
-      token += strspn(token, " \t");
+    // `vn` and `vt` are stored only when they are loaded.
+    if (attribute_mask_ & ATTRIBUTE_NORMAL) {
+      vn += 3 * size_t(segment.num_vn);
+    }
+    if (attribute_mask_ & ATTRIBUTE_TEXCOORD) {
+      vt += 2 * size_t(segment.num_vt);
+    }
+  }
 
-      indices.clear();
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi = parseRawTriple(&token);
+  return true;
+}
 
-        index_t idx;
-        idx.vertex_index = vi.v_idx;
-        idx.normal_index = vi.vn_idx;
-        idx.texcoord_index = vi.vt_idx;
+bool ObjParser::ParseLines(const char *begin, const char *end) {
+  const char *p = begin;
+  while (p < end) {
+    const char *line_end = FindLineEnding(p, end);
+    if (!ParseLine(SkipSpaces(p, line_end), line_end)) {
+      return false;
+    }
+    p = SkipLineEnding(line_end, end);
+  }
+  return true;
+}
 
-        indices.push_back(idx);
-        size_t n = strspn(token, " \t\r");
-        token += n;
+// Count `v`, `vn`, `vt` and `f` lines and face indices in [begin, end).
+static void PrescanObj(const char *begin, const char *end,
+                       CommandCount *count) {
+  size_t group_f = 0;
+  size_t group_indices = 0;
+
+  const char *p = begin;
+  while (p < end) {
+    const char *line_end = FindLineEnding(p, end);
+    const char *s = SkipSpaces(p, line_end);
+
+    size_t n = size_t(line_end - s);
+    if ((n >= 2) && (s[0] == 'v')) {
+      if (IS_SPACE((s[1]))) {
+        count->num_v++;
+      } else if ((n >= 3) && IS_SPACE((s[2]))) {
+        if (s[1] == 'n') {
+          count->num_vn++;
+        } else if (s[1] == 't') {
+          count->num_vt++;
+        }
       }
-
-      if (callback.index_cb && indices.size() > 0) {
-        callback.index_cb(user_data, &indices.at(0),
-                          static_cast<int>(indices.size()));
+    } else if ((n >= 2) && (s[0] == 'f') && IS_SPACE((s[1]))) {
+      // Count whitespace separated `v/vt/vn` tokens.
+      size_t num_indices = 0;
+      bool in_token = false;
+      for (const char *c = s + 2; c < line_end; c++) {
+        bool space = IS_SPACE((*c)) || ((*c) == '\0');
+        if (!space && !in_token) {
+          num_indices++;
+        }
+        in_token = !space;
+      }
+      count->num_f++;
+      count->num_indices += num_indices;
+      group_f++;
+      group_indices += num_indices;
+    } else if (((n >= 2) && ((s[0] == 'g') || (s[0] == 'o')) &&
+                IS_SPACE((s[1]))) ||
+               ((n >= 6) && (0 == strncmp(s, "usemtl", 6)))) {
+      if (group_f > count->max_group_f) count->max_group_f = group_f;
+      if (group_indices > count->max_group_indices) {
+        count->max_group_indices = group_indices;
       }
+      group_f = 0;
+      group_indices = 0;
+    }
 
-      continue;
+    p = SkipLineEnding(line_end, end);
+  }
+
+  if (group_f > count->max_group_f) count->max_group_f = group_f;
+  if (group_indices > count->max_group_indices) {
+    count->max_group_indices = group_indices;
+  }
+}
+
+#ifdef TINYOBJLOADER_HAS_THREADS
+// Parses the vertices of a `f` line in [token, end) into `chunk` with
+// `parseRawTripleAs<Pattern>`. Returns false(and adds nothing) when a vertex
+// does not match `Pattern`.
+template <FacePattern Pattern>
+static bool ParseChunkFaceAs(const char *token, const char *end,
+                             ObjChunk *chunk) {
+  const size_t offset = chunk->face_indices.size();
+  while ((token < end) && !IS_NEW_LINE((*token))) {
+    vertex_index_t raw;
+    if (!parseRawTripleAs<Pattern>(&token, end, &raw)) {
+      chunk->face_indices.resize(offset);
+      return false;
     }
+    chunk->face_indices.push_back(raw);
+    while ((token < end) && (IS_SPACE((*token)) || ((*token) == '\r'))) {
+      token++;
+    }
+  }
+  chunk->face_num_vertices.push_back(
+      static_cast<unsigned int>(chunk->face_indices.size() - offset));
+  return true;
+}
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
-      token += 7;
-      std::stringstream ss;
-      ss << token;
-      std::string namebuf = ss.str();
+// Parses a `f` line(after `f`) as `ObjLineParser` does without `parseTriple`.
+static bool ParseChunkFace(const char *token, const char *end,
+                           FacePattern *face_pattern, ObjChunk *chunk) {
+  while ((token < end) && IS_SPACE((*token))) {
+    token++;
+  }
 
-      int newMaterialId = -1;
-      std::map<std::string, int>::const_iterator it =
-          material_map.find(namebuf);
-      if (it != material_map.end()) {
-        newMaterialId = it->second;
+  if ((*face_pattern) == FACE_PATTERN_UNKNOWN) {
+    (*face_pattern) = detectFacePattern(token, end);
+  }
+
+  bool ok;
+  switch (*face_pattern) {
+    case FACE_PATTERN_V:
+      ok = ParseChunkFaceAs<FACE_PATTERN_V>(token, end, chunk);
+      break;
+    case FACE_PATTERN_V_VT:
+      ok = ParseChunkFaceAs<FACE_PATTERN_V_VT>(token, end, chunk);
+      break;
+    case FACE_PATTERN_V_VN:
+      ok = ParseChunkFaceAs<FACE_PATTERN_V_VN>(token, end, chunk);
+      break;
+    default:
+      ok = ParseChunkFaceAs<FACE_PATTERN_V_VT_VN>(token, end, chunk);
+      break;
+  }
+  if (!ok) {
+    (*face_pattern) = FACE_PATTERN_UNKNOWN;
+  }
+  return ok;
+}
+
+static void BeginChunkSegment(const char *p, bool parsed,
+                              ObjChunkSegment *segment) {
+  segment->begin = p;
+  segment->end = p;
+  segment->num_lines = 0;
+  segment->parsed = parsed;
+  segment->num_v = 0;
+  segment->num_vn = 0;
+  segment->num_vt = 0;
+  segment->num_f = 0;
+  segment->min_v_idx = 0;
+  segment->min_vn_idx = 0;
+  segment->min_vt_idx = 0;
+}
+
+// Parses the lines in [begin, end) into `chunk` on a worker thread. `begin`
+// must be at the beginning of a line. `v`, `vn`, `vt` and `f` lines are
+// parsed as `ObjLineParser::ParseLine` does, other lines are left to
+// `ObjParser::MergeChunk`. Nothing depends on the preceding chunks.
+static void ParseObjChunk(const char *begin, const char *end,
+                          unsigned int attribute_mask, ObjChunk *chunk) {
+  FacePattern face_pattern = FACE_PATTERN_UNKNOWN;
+
+  ObjChunkSegment segment;
+  BeginChunkSegment(begin, true, &segment);
+
+  const char *p = begin;
+  while (p < end) {
+    const char *line_end = FindLineEnding(p, end);
+    const char *token = SkipSpaces(p, line_end);
+
+    // Same classification as `ObjLineParser::ParseLine`. Empty, comment and
+    // unknown lines are skipped in any segment.
+    ObjLineType type = OBJ_LINE_UNKNOWN;
+    bool parsed = true;
+    if ((token < line_end) && (token[0] != '#') && (token[0] != '\0')) {
+      if ((line_end - token) < 7) {
+        parsed = false;  // `classifyObjLine` reads up to 7 bytes.
       } else {
-        // { warn!! material not found }
-        if (warn && (!callback.usemtl_cb)) {
-          (*warn) += "material [ " + namebuf + " ] not found in .mtl\n";
+        type = classifyObjLine(token);
+        if (type == OBJ_LINE_F) {
+          parsed = ParseChunkFace(token + 2, line_end, &face_pattern, chunk);
+        } else if ((type != OBJ_LINE_V) && (type != OBJ_LINE_VN) &&
+                   (type != OBJ_LINE_VT) && (type != OBJ_LINE_UNKNOWN)) {
+          parsed = false;
         }
       }
+    }
 
-      if (newMaterialId != material_id) {
-        material_id = newMaterialId;
+    const bool is_attrib = (type == OBJ_LINE_V) || (type == OBJ_LINE_VN) ||
+                           (type == OBJ_LINE_VT);
+    if (parsed ? ((type != OBJ_LINE_UNKNOWN) &&
+                  (!segment.parsed || (is_attrib && (segment.num_f > 0))))
+               : segment.parsed) {
+      if (segment.num_lines > 0) {
+        chunk->segments.push_back(segment);
       }
+      BeginChunkSegment(p, parsed, &segment);
+    }
 
-      if (callback.usemtl_cb) {
-        callback.usemtl_cb(user_data, namebuf.c_str(), material_id);
+    if (parsed) {
+      if (type == OBJ_LINE_V) {
+        token += 2;
+        real_t x, y, z, r, g, b;
+        int num_components;
+        if (attribute_mask & ATTRIBUTE_COLOR) {
+          num_components =
+              parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token, line_end);
+        } else {
+          num_components =
+              parseVertexWithoutColor(&x, &y, &z, &r, &token, line_end);
+          g = b = static_cast<real_t>(1.0);
+        }
+        chunk->v.push_back(x);
+        chunk->v.push_back(y);
+        chunk->v.push_back(z);
+        chunk->v_num_components.push_back(
+            static_cast<unsigned char>(num_components));
+        if (num_components >= 4) {
+          chunk->v_extra.push_back(r);
+        }
+        if (num_components == 6) {
+          chunk->v_extra.push_back(g);
+          chunk->v_extra.push_back(b);
+        }
+        segment.num_v++;
+      } else if (type == OBJ_LINE_VN) {
+        if (attribute_mask & ATTRIBUTE_NORMAL) {
+          token += 3;
+          real_t x, y, z;
+          parseReal3(&x, &y, &z, &token, line_end);
+          chunk->vn.push_back(x);
+          chunk->vn.push_back(y);
+          chunk->vn.push_back(z);
+        }
+        segment.num_vn++;
+      } else if (type == OBJ_LINE_VT) {
+        if (attribute_mask & ATTRIBUTE_TEXCOORD) {
+          token += 3;
+          real_t x, y, z;
+          parseReal3(&x, &y, &z, &token, line_end);
+          chunk->vt.push_back(x);
+          chunk->vt.push_back(y);
+        }
+        segment.num_vt++;
+      } else if (type == OBJ_LINE_F) {
+        const size_t num_vertices = chunk->face_num_vertices.back();
+        const vertex_index_t *vi =
+            chunk->face_indices.data() +
+            (chunk->face_indices.size() - num_vertices);
+        for (size_t i = 0; i < num_vertices; i++) {
+          segment.min_v_idx = (std::min)(segment.min_v_idx, vi[i].v_idx);
+          segment.min_vn_idx = (std::min)(segment.min_vn_idx, vi[i].vn_idx);
+          segment.min_vt_idx = (std::min)(segment.min_vt_idx, vi[i].vt_idx);
+        }
+        segment.num_f++;
       }
-
-      continue;
     }
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-      if (readMatFn) {
-        token += 7;
+    p = SkipLineEnding(line_end, end);
+    segment.num_lines++;
+    segment.end = p;
+  }
+
+  if (segment.num_lines > 0) {
+    chunk->segments.push_back(segment);
+  }
+}
+
+// Returns the beginning of the first line which starts at `p` or later.
+static const char *AlignToLineStart(const char *begin, const char *p,
+                                    const char *end) {
+  while ((p > begin) && (p < end)) {
+    char prev = *(p - 1);
+    if ((prev == '\n') || ((prev == '\r') && ((*p) != '\n'))) {
+      break;
+    }
+    p++;
+  }
+  return p;
+}
+#endif
+
+// Parses the complete lines of a chunk of .obj text with `parser`. The
+// incomplete last line is kept in `linebuf` until the rest of it is fed.
+// `skip_lf` is set when the chunk ends with '\r', so '\n' of "\r\n" split
+// across chunks is skipped.
+static bool FeedLines(ObjParser *parser, const char *buf, size_t len,
+                      std::string *linebuf, bool *skip_lf) {
+  const char *p = buf;
+  const char *end = buf + len;
+
+  if ((*skip_lf) && (p < end)) {
+    if ((*p) == '\n') {
+      p++;
+    }
+    (*skip_lf) = false;
+  }
+
+  while (p < end) {
+    const char *line_end = FindLineEnding(p, end);
+    if (line_end == end) {
+      linebuf->append(p, end);
+      break;
+    }
+
+    // Only a line split across chunks is copied.
+    bool ok;
+    if (linebuf->empty()) {
+      ok = parser->ParseLine(p, line_end);
+    } else {
+      linebuf->append(p, line_end);
+      ok = parser->ParseLine(linebuf->c_str());
+      linebuf->clear();
+    }
+    if (!ok) {
+      return false;
+    }
+
+    if (((*line_end) == '\r') && ((line_end + 1) == end)) {
+      (*skip_lf) = true;
+    }
+    p = SkipLineEnding(line_end, end);
+  }
+
+  return true;
+}
+
+// Parses the last line(without line ending) kept by `FeedLines`.
+static bool FinishLines(ObjParser *parser, std::string *linebuf) {
+  bool ok = true;
+  if (!linebuf->empty()) {
+    ok = parser->ParseLine(linebuf->c_str());
+  }
+  std::string().swap(*linebuf);
+  return ok;
+}
+
+#ifdef TINYOBJLOADER_HAS_THREADS
+//
+// Chunks of decompressed .obj text passed from the decompression thread to
+// the parser. A fixed number of buffers are reused, so the memory use is
+// bounded regardless of the size of .obj.
+//
+class ChunkPipe {
+ public:
+  struct Chunk {
+    vector_of<char>::type data;
+    size_t size;  // 0 = the end of the data
+  };
+
+  ChunkPipe(size_t num_chunks, size_t chunk_size)
+      : chunks_(num_chunks), closed_(false) {
+    for (size_t i = 0; i < chunks_.size(); i++) {
+      chunks_[i].data.resize(chunk_size);
+      chunks_[i].size = 0;
+      free_.push_back(&chunks_[i]);
+    }
+  }
+
+  // Returns a chunk to fill. NULL when the pipe was closed.
+  Chunk *Acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (free_.empty() && !closed_) {
+      cond_.wait(lock);
+    }
+    if (closed_) {
+      return NULL;
+    }
+    Chunk *chunk = free_.front();
+    free_.pop_front();
+    return chunk;
+  }
+
+  void Push(Chunk *chunk) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filled_.push_back(chunk);
+    cond_.notify_all();
+  }
+
+  // Returns the next filled chunk.
+  Chunk *Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (filled_.empty()) {
+      cond_.wait(lock);
+    }
+    Chunk *chunk = filled_.front();
+    filled_.pop_front();
+    return chunk;
+  }
+
+  void Release(Chunk *chunk) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(chunk);
+    cond_.notify_all();
+  }
+
+  // Stops the producer(e.g. on a parse error).
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cond_.notify_all();
+  }
+
+ private:
+  std::vector<Chunk> chunks_;
+  std::deque<Chunk *> free_;
+  std::deque<Chunk *> filled_;
+  bool closed_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+// Decompression thread of `LoadObjFromCompressedStream`.
+static void DecompressChunks(Decompressor *decompressor, ChunkPipe *pipe) {
+  for (;;) {
+    ChunkPipe::Chunk *chunk = pipe->Acquire();
+    if (!chunk) {
+      return;
+    }
+    chunk->size = decompressor->Read(&chunk->data.at(0), chunk->data.size());
+    pipe->Push(chunk);
+    if (chunk->size == 0) {
+      return;
+    }
+  }
+}
+#endif
+
+// Parse gzip or zstd compressed .obj read from `in`. The data is decompressed
+// in chunks(on its own thread when C++11 threads are available, pipelined with
+// parsing), so the whole decompressed text is never held in memory.
+// `num_threads` and `prescan` in `config` are not used.
+static bool LoadObjFromCompressedStream(attrib_t *attrib,
+                                        std::vector<shape_t> *shapes,
+                                        std::vector<material_t> *materials,
+                                        std::string *warn, std::string *err,
+                                        std::istream *in,
+                                        CompressionType compression,
+                                        MaterialReader *readMatFn,
+                                        const ObjReaderConfig &config) {
+  const size_t kChunkSize = 256 * 1024;
+
+  Decompressor decompressor(in, compression);
+  if (!decompressor.Error().empty()) {
+    if (err) {
+      (*err) += decompressor.Error();
+    }
+    return false;
+  }
+
+  ObjParser parser(shapes, materials, readMatFn, config.triangulate,
+                   config.vertex_color, warn, err);
+  parser.SetDefaultVertexAttribs(config.default_vertex_attribs);
+  parser.SetAttributeMask(config.attribute_mask);
+
+  std::string linebuf;
+  bool skip_lf = false;
+  bool ok = true;
+
+#ifdef TINYOBJLOADER_HAS_THREADS
+  ChunkPipe pipe(4, kChunkSize);
+  std::thread worker(DecompressChunks, &decompressor, &pipe);
+  for (;;) {
+    ChunkPipe::Chunk *chunk = pipe.Pop();
+    if (chunk->size == 0) {
+      break;
+    }
+    ok = FeedLines(&parser, &chunk->data.at(0), chunk->size, &linebuf,
+                   &skip_lf);
+    pipe.Release(chunk);
+    if (!ok) {
+      break;
+    }
+  }
+  pipe.Close();
+  worker.join();
+#else
+  vector_of<char>::type chunk(kChunkSize);
+  for (;;) {
+    size_t n = decompressor.Read(&chunk.at(0), chunk.size());
+    if (n == 0) {
+      break;
+    }
+    if (!FeedLines(&parser, &chunk.at(0), n, &linebuf, &skip_lf)) {
+      ok = false;
+      break;
+    }
+  }
+#endif
+
+  if (!decompressor.Error().empty()) {
+    if (err) {
+      (*err) += decompressor.Error();
+    }
+    return false;
+  }
+  if (!ok || !FinishLines(&parser, &linebuf)) {
+    return false;
+  }
+
+  parser.Finish(attrib);
+
+  return true;
+}
+
+// Parse .obj in memory. `buf` need not be terminated by '\0'.
+// gzip or zstd compressed data is decompressed while parsing(see
+// `LoadObjFromCompressedStream`).
+// When `config.num_threads` > 1(and C++11 threads are available), the text is
+// split into chunks at line boundaries. `v`, `vn`, `vt` and `f` lines of each
+// chunk are parsed by its own thread(`ParseObjChunk`), and the chunks are
+// merged in order(`ObjParser::MergeChunk`), so the result is identical to the
+// serial `LoadObj`.
+// Large groups of faces are also triangulated in parallel.
+// When `config.prescan` is true, output arrays are reserved by `PrescanObj`
+// first.
+static bool LoadObjFromMemory(attrib_t *attrib, std::vector<shape_t> *shapes,
+                              std::vector<material_t> *materials,
+                              std::string *warn, std::string *err,
+                              const char *buf, size_t len,
+                              MaterialReader *readMatFn,
+                              const ObjReaderConfig &config) {
+  shapes->clear();
+
+  const CompressionType compression = DetectCompression(buf, len);
+  if (compression != COMPRESSION_NONE) {
+    MemoryStreamBuf sbuf(buf, len);
+    std::istream is(&sbuf);
+    return LoadObjFromCompressedStream(attrib, shapes, materials, warn, err,
+                                       &is, compression, readMatFn, config);
+  }
+
+  int num_threads = config.num_threads;
+#ifdef TINYOBJLOADER_HAS_THREADS
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+#endif
+
+  const char *begin = buf;
+  const char *end = buf + len;
+
+  ObjParser parser(shapes, materials, readMatFn, config.triangulate,
+                   config.vertex_color, warn, err);
+  parser.SetNumThreads(num_threads);
+  parser.SetDefaultVertexAttribs(config.default_vertex_attribs);
+  parser.SetAttributeMask(config.attribute_mask);
+
+  if (config.prescan) {
+    CommandCount count;
+    PrescanObj(begin, end, &count);
+    parser.Reserve(count);
+  }
+
+#ifdef TINYOBJLOADER_HAS_THREADS
+  if ((num_threads > 1) && (len > 0)) {
+    std::vector<const char *> chunk_begins;
+    chunk_begins.push_back(begin);
+
+    size_t chunk_size = len / size_t(num_threads);
+    if (chunk_size < 1) chunk_size = 1;
+
+    for (int t = 1; t < num_threads; t++) {
+      const char *p = AlignToLineStart(begin, begin + size_t(t) * chunk_size,
+                                       end);
+      if (p > chunk_begins.back()) {
+        chunk_begins.push_back(p);
+      }
+    }
+    if (chunk_begins.back() == end) {
+      chunk_begins.pop_back();
+    }
+    chunk_begins.push_back(end);
+
+    // Each chunk is parsed by its own thread, and merged in line order as
+    // soon as its thread has finished, while later chunks are still parsed.
+    const size_t num_chunks = chunk_begins.size() - 1;
+    std::vector<ObjChunk> chunks(num_chunks);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < num_chunks; t++) {
+      workers.push_back(std::thread(ParseObjChunk, chunk_begins[t],
+                                    chunk_begins[t + 1], config.attribute_mask,
+                                    &chunks[t]));
+    }
+
+    bool ok = true;
+    for (size_t t = 0; t < num_chunks; t++) {
+      workers[t].join();
+      ok = ok && parser.MergeChunk(chunks[t]);
+      chunks[t] = ObjChunk();  // release memory as early as possible
+    }
+    if (!ok) {
+      return false;
+    }
+
+    parser.Finish(attrib);
+    return true;
+  }
+#endif
+
+  if (!parser.ParseLines(begin, end)) {
+    return false;
+  }
+
+  parser.Finish(attrib);
+
+  return true;
+}
+
+//
+// `usemtl`, `mtllib`, `g` and `o` lines of the callback APIs. Calls
+// `usemtl_cb`, `mtllib_cb`, `group_cb` and `object_cb` of `callback`.
+//
+class CallbackCommandHandler {
+ public:
+  CallbackCommandHandler(const callback_t &callback, void *user_data,
+                         MaterialReader *readMatFn, std::string *warn,
+                         std::string *err)
+      : callback_(callback),
+        user_data_(user_data),
+        readMatFn_(readMatFn),
+        warn_(warn),
+        err_(err),
+        material_id_(-1) {
+    names_.reserve(2);
+  }
+
+  bool Command(ObjLineType type, const char *token, size_t line_num);
+
+ private:
+  const callback_t &callback_;
+  void *user_data_;
+  MaterialReader *readMatFn_;
+  std::string *warn_;
+  std::string *err_;
+
+  // material
+  std::set<std::string> material_filenames_;
+  std::map<std::string, int> material_map_;
+  int material_id_;  // -1 = invalid
+  std::vector<material_t> materials_;
+
+  std::vector<std::string> names_;
+  std::vector<const char *> names_out_;
+};
+
+bool CallbackCommandHandler::Command(ObjLineType type, const char *token,
+                                     size_t line_num) {
+  std::string *warn = warn_;
+
+  switch (type) {
+    // use mtl
+    case OBJ_LINE_USEMTL: {
+      if (!IS_SPACE(token[6])) {
+        break;  // `usemtl` without a space is ignored here.
+      }
+      token += 7;
+      std::stringstream ss;
+      ss << token;
+      std::string namebuf = ss.str();
+
+      int newMaterialId = -1;
+      std::map<std::string, int>::const_iterator it =
+          material_map_.find(namebuf);
+      if (it != material_map_.end()) {
+        newMaterialId = it->second;
+      } else {
+        // { warn!! material not found }
+        if (warn && (!callback_.usemtl_cb)) {
+          (*warn) += "material [ " + namebuf + " ] not found in .mtl\n";
+        }
+      }
+
+      if (newMaterialId != material_id_) {
+        material_id_ = newMaterialId;
+      }
+
+      if (callback_.usemtl_cb) {
+        callback_.usemtl_cb(user_data_, namebuf.c_str(), material_id_);
+      }
+
+      return true;
+    }
+
+    // load mtl
+    case OBJ_LINE_MTLLIB: {
+      if (readMatFn_) {
+        token += 7;
+        if (LoadMtllib(token, readMatFn_, &material_filenames_, &materials_,
+                       &material_map_, line_num, warn, err_)) {
+          if (callback_.mtllib_cb) {
+            callback_.mtllib_cb(user_data_, &materials_.at(0),
+                                static_cast<int>(materials_.size()));
+          }
+        }
+      }
+
+      return true;
+    }
+
+    // group name
+    case OBJ_LINE_G: {
+      names_.clear();
+
+      while (!IS_NEW_LINE(token[0])) {
+        std::string str = parseString(&token);
+        names_.push_back(str);
+        token += strspn(token, " \t\r");  // skip tag
+      }
+
+      assert(names_.size() > 0);
+
+      if (callback_.group_cb) {
+        if (names_.size() > 1) {
+          // create const char* array.
+          names_out_.resize(names_.size() - 1);
+          for (size_t j = 0; j < names_out_.size(); j++) {
+            names_out_[j] = names_[j + 1].c_str();
+          }
+          callback_.group_cb(user_data_, &names_out_.at(0),
+                             static_cast<int>(names_out_.size()));
+
+        } else {
+          callback_.group_cb(user_data_, NULL, 0);
+        }
+      }
+
+      return true;
+    }
+
+    // object name
+    case OBJ_LINE_O: {
+      // @todo { multiple object name? }
+      token += 2;
+
+      std::stringstream ss;
+      ss << token;
+      std::string object_name = ss.str();
+
+      if (callback_.object_cb) {
+        callback_.object_cb(user_data_, object_name.c_str());
+      }
+
+      return true;
+    }
+
+    // @todo { `t` lines. They are not parsed since `callback_t` has no
+    // callback for tags. }
+    default:
+      break;
+  }
+
+  return true;
+}
+
+//
+// `ObjLineParser` handler of `LoadObjWithCallback`. Calls `callback_t`
+// functions with the parsed data.
+//
+class CallbackHandler {
+ public:
+  static const bool kRawIndices = true;
+
+  CallbackHandler(const callback_t &callback, void *user_data,
+                  MaterialReader *readMatFn, std::string *warn,
+                  std::string *err)
+      : callback_(callback),
+        user_data_(user_data),
+        line_parser_(this, warn, err),
+        commands_(callback, user_data, readMatFn, warn, err) {
+    // Attributes without a callback are not parsed.
+    unsigned int attribute_mask = 0;
+    if (callback_.normal_cb) {
+      attribute_mask |= ATTRIBUTE_NORMAL;
+    }
+    if (callback_.texcoord_cb) {
+      attribute_mask |= ATTRIBUTE_TEXCOORD;
+    }
+    if (callback_.vertex_color_cb) {
+      attribute_mask |= ATTRIBUTE_COLOR;
+    }
+    line_parser_.SetAttributeMask(attribute_mask);
+  }
+
+  bool ParseLine(const char *linebuf) {
+    return line_parser_.ParseLine(linebuf);
+  }
+
+  // `ObjLineParser` handler.
+  void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b,
+              int num_components) {
+    if (callback_.vertex_cb) {
+      callback_.vertex_cb(user_data_, x, y, z, r);  // r=w is optional
+    }
+    if (callback_.vertex_color_cb) {
+      bool found_color = (num_components == 6);
+      callback_.vertex_color_cb(user_data_, x, y, z, r, g, b, found_color);
+    }
+  }
+
+  void Normal(real_t x, real_t y, real_t z) {
+    callback_.normal_cb(user_data_, x, y, z);
+  }
+
+  void Texcoord(real_t x, real_t y, real_t z) {
+    callback_.texcoord_cb(user_data_, x, y, z);
+  }
+
+  // `l` and `p` lines are not reported.
+  vector_of<vertex_index_t>::type *PrimitiveIndices(ObjLineType type) {
+    if ((type != OBJ_LINE_F) || !callback_.index_cb) {
+      return NULL;
+    }
+    face_indices_.clear();
+    return &face_indices_;
+  }
+
+  void Primitive(ObjLineType type, size_t vertex_offset) {
+    (void)type;
+    (void)vertex_offset;
+
+    indices_.resize(face_indices_.size());
+    for (size_t i = 0; i < face_indices_.size(); i++) {
+      indices_[i].vertex_index = face_indices_[i].v_idx;
+      indices_[i].normal_index = face_indices_[i].vn_idx;
+      indices_[i].texcoord_index = face_indices_[i].vt_idx;
+    }
+
+    if (indices_.size() > 0) {
+      callback_.index_cb(user_data_, &indices_.at(0),
+                         static_cast<int>(indices_.size()));
+    }
+  }
+
+  bool Command(ObjLineType type, const char *token) {
+    return commands_.Command(type, token, line_parser_.line_num());
+  }
+
+ private:
+  const callback_t &callback_;
+  void *user_data_;
+  ObjLineParser<CallbackHandler> line_parser_;
+  CallbackCommandHandler commands_;
+
+  vector_of<vertex_index_t>::type face_indices_;
+  vector_of<index_t>::type indices_;
+};
+
+bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
+                         void *user_data /*= NULL*/,
+                         MaterialReader *readMatFn /*= NULL*/,
+                         std::string *warn, /* = NULL*/
+                         std::string *err /*= NULL*/) {
+  CallbackHandler handler(callback, user_data, readMatFn, warn, err);
+
+  std::string linebuf;
+  while (inStream.peek() != -1) {
+    safeGetline(inStream, linebuf);
+
+    if (!handler.ParseLine(linebuf.c_str())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Primitives of `f`, `l` or `p` lines not yet passed to `batch_callback_t`.
+struct PrimitiveBatch {
+  vector_of<vertex_index_t>::type indices;
+  vector_of<unsigned int>::type num_vertices;
+};
+
+//
+// `ObjLineParser` handler of `LoadObjWithBatchCallback`. Collects the parsed
+// data and calls `batch_callback_t` functions with `batch_size` elements.
+//
+class BatchCallbackHandler {
+ public:
+  static const bool kRawIndices = false;
+
+  BatchCallbackHandler(const batch_callback_t &callback, void *user_data,
+                       MaterialReader *readMatFn, std::string *warn,
+                       std::string *err)
+      : callback_(callback),
+        user_data_(user_data),
+        batch_size_(callback.batch_size > 0 ? callback.batch_size : 1),
+        line_parser_(this, warn, err),
+        command_callback_(MakeCommandCallback(callback)),
+        commands_(command_callback_, user_data, readMatFn, warn, err) {
+    // Attributes without a callback are not parsed.
+    unsigned int attribute_mask = 0;
+    if (callback_.normal_cb) {
+      attribute_mask |= ATTRIBUTE_NORMAL;
+    }
+    if (callback_.texcoord_cb) {
+      attribute_mask |= ATTRIBUTE_TEXCOORD;
+    }
+    if (callback_.vertex_color_cb) {
+      attribute_mask |= ATTRIBUTE_COLOR;
+    }
+    line_parser_.SetAttributeMask(attribute_mask);
+
+    if (callback_.vertex_cb || callback_.vertex_color_cb) {
+      v_.reserve(3 * batch_size_);
+    }
+    if (callback_.vertex_cb) {
+      vw_.reserve(batch_size_);
+    }
+    if (callback_.vertex_color_cb) {
+      vc_.reserve(3 * batch_size_);
+    }
+    if (callback_.normal_cb) {
+      vn_.reserve(3 * batch_size_);
+    }
+    if (callback_.texcoord_cb) {
+      vt_.reserve(3 * batch_size_);
+    }
+  }
+
+  bool ParseLine(const char *linebuf) {
+    return line_parser_.ParseLine(linebuf);
+  }
+
+  // Passes all pending batches.
+  void Flush() {
+    FlushVertices();
+    FlushNormals();
+    FlushTexcoords();
+    FlushPrimitives(callback_.face_cb, &faces_);
+    FlushPrimitives(callback_.line_cb, &lines_);
+    FlushPrimitives(callback_.point_cb, &points_);
+  }
+
+  // `ObjLineParser` handler.
+  void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b,
+              int num_components) {
+    if (!callback_.vertex_cb && !callback_.vertex_color_cb) {
+      return;
+    }
+    v_.push_back(x);
+    v_.push_back(y);
+    v_.push_back(z);
+    if (callback_.vertex_cb) {
+      vw_.push_back((num_components == 4) ? r : static_cast<real_t>(1.0));
+    }
+    if (callback_.vertex_color_cb) {
+      const bool has_color = (num_components == 6);
+      vc_.push_back(has_color ? r : static_cast<real_t>(1.0));
+      vc_.push_back(has_color ? g : static_cast<real_t>(1.0));
+      vc_.push_back(has_color ? b : static_cast<real_t>(1.0));
+    }
+    if (v_.size() >= 3 * batch_size_) {
+      FlushVertices();
+    }
+  }
+
+  void Normal(real_t x, real_t y, real_t z) {
+    vn_.push_back(x);
+    vn_.push_back(y);
+    vn_.push_back(z);
+    if (vn_.size() >= 3 * batch_size_) {
+      FlushNormals();
+    }
+  }
+
+  void Texcoord(real_t x, real_t y, real_t z) {
+    vt_.push_back(x);
+    vt_.push_back(y);
+    vt_.push_back(z);
+    if (vt_.size() >= 3 * batch_size_) {
+      FlushTexcoords();
+    }
+  }
+
+  vector_of<vertex_index_t>::type *PrimitiveIndices(ObjLineType type) {
+    if (type == OBJ_LINE_F) {
+      return callback_.face_cb ? &faces_.indices : NULL;
+    } else if (type == OBJ_LINE_L) {
+      return callback_.line_cb ? &lines_.indices : NULL;
+    }
+    return callback_.point_cb ? &points_.indices : NULL;
+  }
+
+  void Primitive(ObjLineType type, size_t vertex_offset) {
+    PrimitiveBatch *batch = &points_;
+    if (type == OBJ_LINE_F) {
+      batch = &faces_;
+    } else if (type == OBJ_LINE_L) {
+      batch = &lines_;
+    }
+
+    if (batch->indices.size() == vertex_offset) {
+      return;  // no vertices
+    }
+    batch->num_vertices.push_back(
+        static_cast<unsigned int>(batch->indices.size() - vertex_offset));
+
+    if (batch->num_vertices.size() >= batch_size_) {
+      if (type == OBJ_LINE_F) {
+        FlushPrimitives(callback_.face_cb, batch);
+      } else if (type == OBJ_LINE_L) {
+        FlushPrimitives(callback_.line_cb, batch);
+      } else {
+        FlushPrimitives(callback_.point_cb, batch);
+      }
+    }
+  }
+
+  bool Command(ObjLineType type, const char *token) {
+    if ((type == OBJ_LINE_S) || (type == OBJ_LINE_T) ||
+        (type == OBJ_LINE_VW)) {
+      return true;  // not reported
+    }
+
+    // Let the callbacks see the data in the order of the file.
+    Flush();
+    return commands_.Command(type, token, line_parser_.line_num());
+  }
+
+ private:
+  typedef void (*PrimitiveCallback)(void *user_data, const index_t *indices,
+                                    const unsigned int *num_vertices,
+                                    size_t count);
+
+  const batch_callback_t &callback_;
+  void *user_data_;
+  size_t batch_size_;
+  ObjLineParser<BatchCallbackHandler> line_parser_;
+  callback_t command_callback_;  // `usemtl_cb`, ... of `callback_`
+  CallbackCommandHandler commands_;
+
+  vector_of<real_t>::type v_;
+  vector_of<real_t>::type vw_;
+  vector_of<real_t>::type vc_;
+  vector_of<real_t>::type vn_;
+  vector_of<real_t>::type vt_;
+  PrimitiveBatch faces_;
+  PrimitiveBatch lines_;
+  PrimitiveBatch points_;
+  vector_of<index_t>::type indices_;
+
+  static callback_t MakeCommandCallback(const batch_callback_t &callback) {
+    callback_t ret;
+    ret.usemtl_cb = callback.usemtl_cb;
+    ret.mtllib_cb = callback.mtllib_cb;
+    ret.group_cb = callback.group_cb;
+    ret.object_cb = callback.object_cb;
+    return ret;
+  }
+
+  void FlushVertices() {
+    if (v_.empty()) {
+      return;
+    }
+    const size_t count = v_.size() / 3;
+    if (callback_.vertex_cb) {
+      callback_.vertex_cb(user_data_, &v_.at(0), &vw_.at(0), count);
+    }
+    if (callback_.vertex_color_cb) {
+      callback_.vertex_color_cb(user_data_, &vc_.at(0), count);
+    }
+    v_.clear();
+    vw_.clear();
+    vc_.clear();
+  }
+
+  void FlushNormals() {
+    if (vn_.empty()) {
+      return;
+    }
+    callback_.normal_cb(user_data_, &vn_.at(0), vn_.size() / 3);
+    vn_.clear();
+  }
+
+  void FlushTexcoords() {
+    if (vt_.empty()) {
+      return;
+    }
+    callback_.texcoord_cb(user_data_, &vt_.at(0), vt_.size() / 3);
+    vt_.clear();
+  }
+
+  void FlushPrimitives(PrimitiveCallback cb, PrimitiveBatch *batch) {
+    if (batch->num_vertices.empty()) {
+      return;
+    }
+
+    indices_.resize(batch->indices.size());
+    for (size_t i = 0; i < batch->indices.size(); i++) {
+      indices_[i].vertex_index = batch->indices[i].v_idx;
+      indices_[i].normal_index = batch->indices[i].vn_idx;
+      indices_[i].texcoord_index = batch->indices[i].vt_idx;
+    }
+
+    cb(user_data_, &indices_.at(0), &batch->num_vertices.at(0),
+       batch->num_vertices.size());
+    batch->indices.clear();
+    batch->num_vertices.clear();
+  }
+};
+
+bool LoadObjWithBatchCallback(std::istream &inStream,
+                              const batch_callback_t &callback,
+                              void *user_data /*= NULL*/,
+                              MaterialReader *readMatFn /*= NULL*/,
+                              std::string *warn, /* = NULL*/
+                              std::string *err /*= NULL*/) {
+  BatchCallbackHandler handler(callback, user_data, readMatFn, warn, err);
+
+  std::string linebuf;
+  while (inStream.peek() != -1) {
+    safeGetline(inStream, linebuf);
+
+    if (!handler.ParseLine(linebuf.c_str())) {
+      return false;
+    }
+  }
+  handler.Flush();
+
+  return true;
+}
+
+enum FileType {
+  FILE_TYPE_UNKNOWN = 0,  // e.g. `stat` failed
+  FILE_TYPE_REGULAR,
+  FILE_TYPE_DIRECTORY,
+  FILE_TYPE_OTHER  // e.g. a pipe or a device
+};
+
+static FileType GetFileType(const std::string &filename) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(filename.c_str(), &st) != 0) {
+    return FILE_TYPE_UNKNOWN;
+  }
+  const unsigned int type = static_cast<unsigned int>(st.st_mode) & _S_IFMT;
+  if (type == _S_IFREG) return FILE_TYPE_REGULAR;
+  if (type == _S_IFDIR) return FILE_TYPE_DIRECTORY;
+#else
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    return FILE_TYPE_UNKNOWN;
+  }
+  if (S_ISREG(st.st_mode)) return FILE_TYPE_REGULAR;
+  if (S_ISDIR(st.st_mode)) return FILE_TYPE_DIRECTORY;
+#endif
+  return FILE_TYPE_OTHER;
+}
+
+//
+// Read-only view of the whole content of a file. The file is memory mapped
+// when possible, otherwise it is read into memory.
+//
+class FileData {
+ public:
+  FileData() : data_(NULL), size_(0), mapped_(false) {
+#if defined(TINYOBJLOADER_HAS_MMAP) && defined(_WIN32)
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#endif
+  }
+  ~FileData() { Close(); }
+
+  bool Open(const std::string &filename, bool use_mmap);
+  void Close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  FileData(const FileData &);
+  FileData &operator=(const FileData &);
+
+  bool Map(const std::string &filename);
+
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+  vector_of<char>::type buf_;
+#if defined(TINYOBJLOADER_HAS_MMAP) && defined(_WIN32)
+  HANDLE file_;
+  HANDLE mapping_;
+#endif
+};
+
+#ifdef TINYOBJLOADER_HAS_MMAP
+#ifdef _WIN32
+bool FileData::Map(const std::string &filename) {
+  file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                      OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER filesize;
+  if (!GetFileSizeEx(file_, &filesize) || (filesize.QuadPart <= 0)) {
+    Close();
+    return false;
+  }
+
+  mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping_ == NULL) {
+    Close();
+    return false;
+  }
+
+  LPVOID view = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const char *>(view);
+  size_ = static_cast<size_t>(filesize.QuadPart);
+  mapped_ = true;
+  return true;
+}
+#else
+bool FileData::Map(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat sb;
+  if ((fstat(fd, &sb) == -1) || !S_ISREG(sb.st_mode) || (sb.st_size <= 0)) {
+    close(fd);
+    return false;
+  }
+
+  void *p = mmap(NULL, static_cast<size_t>(sb.st_size), PROT_READ, MAP_PRIVATE,
+                 fd, 0);
+  close(fd);  // The mapping remains valid after closing the descriptor.
+  if (p == MAP_FAILED) {
+    return false;
+  }
+
+#if defined(POSIX_MADV_SEQUENTIAL)
+  posix_madvise(p, static_cast<size_t>(sb.st_size), POSIX_MADV_SEQUENTIAL);
+#endif
+
+  data_ = static_cast<const char *>(p);
+  size_ = static_cast<size_t>(sb.st_size);
+  mapped_ = true;
+  return true;
+}
+#endif
+#else
+bool FileData::Map(const std::string &filename) {
+  (void)filename;
+  return false;
+}
+#endif
+
+bool FileData::Open(const std::string &filename, bool use_mmap) {
+  Close();
+
+  if (use_mmap && Map(filename)) {
+    return true;
+  }
+
+  // Fallback. Also used for an empty file, which can't be mapped, and for a
+  // pipe or a device, whose size is unknown(read until EOF).
+  const FileType type = GetFileType(filename);
+  if (type == FILE_TYPE_DIRECTORY) {
+    return false;
+  }
+
+  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+
+  size_t read_size = 64 * 1024;
+  if (type == FILE_TYPE_REGULAR) {
+    ifs.seekg(0, ifs.end);
+    const std::streamoff filesize = ifs.tellg();  // -1 when it failed
+    if (filesize > 0) {
+      // +1 to hit EOF in the first read.
+      read_size = static_cast<size_t>(filesize) + 1;
+    }
+    ifs.clear();
+    ifs.seekg(0, ifs.beg);
+    if (!ifs) {
+      return false;
+    }
+  }
+
+  while (ifs) {
+    const size_t offset = buf_.size();
+    buf_.resize(offset + read_size);
+    ifs.read(&buf_[offset], static_cast<std::streamsize>(read_size));
+    buf_.resize(offset + static_cast<size_t>(ifs.gcount()));
+  }
+  if (ifs.bad()) {
+    return false;  // read error
+  }
+
+  size_ = buf_.size();
+  data_ = buf_.empty() ? NULL : &buf_[0];
+
+  return true;
+}
+
+void FileData::Close() {
+  if (mapped_) {
+#ifdef TINYOBJLOADER_HAS_MMAP
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char *>(data_), size_);
+#endif
+#endif
+  }
+#if defined(TINYOBJLOADER_HAS_MMAP) && defined(_WIN32)
+  if (mapping_ != NULL) {
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+  }
+  if (file_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+  }
+#endif
+  vector_of<char>::type().swap(buf_);
+  data_ = NULL;
+  size_ = 0;
+  mapped_ = false;
+}
+
+// Gets the size and the modification time(in seconds) of a file.
+static bool GetFileStamp(const std::string &filename, uint64_t *size,
+                         int64_t *mtime) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(filename.c_str(), &st) != 0) {
+    return false;
+  }
+#else
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    return false;
+  }
+#endif
+  (*size) = static_cast<uint64_t>(st.st_size);
+  (*mtime) = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
+
+//
+// Single-indexed mesh(`BuildIndexedMesh`).
+//
+
+// Open addressing(linear probing) hash table from a face vertex index
+// (vertex, normal, texcoord) to the index of the merged vertex.
+class VertexIndexMap {
+ public:
+  // `expected_vertices` is the estimated number of distinct keys.
+  explicit VertexIndexMap(size_t expected_vertices) : size_(0) {
+    size_t capacity = 16;
+    while (capacity < (expected_vertices * 2)) {
+      capacity *= 2;
+    }
+    Resize(capacity);
+  }
+
+  // Returns the merged vertex index of `idx`. `inserted` is set to true when
+  // `idx` is seen for the first time, and a new index(the number of keys so
+  // far) is assigned.
+  uint32_t Insert(const index_t &idx, bool *inserted) {
+    // Keep the load factor <= 0.5.
+    if ((size_t(size_) + 1) * 2 > slots_.size()) {
+      Resize(slots_.size() * 2);
+    }
+
+    const size_t mask = slots_.size() - 1;
+    size_t i = Hash(idx) & mask;
+    for (;;) {
+      Slot &slot = slots_[i];
+      if (slot.id == kEmpty) {
+        slot.vertex_index = idx.vertex_index;
+        slot.normal_index = idx.normal_index;
+        slot.texcoord_index = idx.texcoord_index;
+        slot.id = size_++;
+        (*inserted) = true;
+        return slot.id;
+      }
+      if ((slot.vertex_index == idx.vertex_index) &&
+          (slot.normal_index == idx.normal_index) &&
+          (slot.texcoord_index == idx.texcoord_index)) {
+        (*inserted) = false;
+        return slot.id;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+ private:
+  // Key and value are stored together so that a lookup touches one cache
+  // line in most cases.
+  struct Slot {
+    int vertex_index;
+    int normal_index;
+    int texcoord_index;
+    uint32_t id;
+  };
+
+  static const uint32_t kEmpty = 0xffffffffu;
+
+  void Resize(size_t capacity) {
+    Slot empty;
+    empty.vertex_index = 0;
+    empty.normal_index = 0;
+    empty.texcoord_index = 0;
+    empty.id = kEmpty;
+
+    vector_of<Slot>::type old_slots(capacity, empty);
+    old_slots.swap(slots_);
+
+    const size_t mask = capacity - 1;
+    for (size_t k = 0; k < old_slots.size(); k++) {
+      if (old_slots[k].id == kEmpty) {
+        continue;
+      }
+      index_t idx;
+      idx.vertex_index = old_slots[k].vertex_index;
+      idx.normal_index = old_slots[k].normal_index;
+      idx.texcoord_index = old_slots[k].texcoord_index;
+      size_t i = Hash(idx) & mask;
+      while (slots_[i].id != kEmpty) {
+        i = (i + 1) & mask;
+      }
+      slots_[i] = old_slots[k];
+    }
+  }
+
+  // Nearby vertex indices are mapped to nearby slots, since consecutive faces
+  // mostly refer to nearby vertices. Different normal/texcoord of the same
+  // vertex are spread over 8 slots.
+  static size_t Hash(const index_t &idx) {
+    uint32_t h = static_cast<uint32_t>(idx.normal_index) * 0x9e3779b1u;
+    h ^= static_cast<uint32_t>(idx.texcoord_index) * 0x85ebca77u;
+    return (static_cast<size_t>(static_cast<uint32_t>(idx.vertex_index)) << 3) +
+           static_cast<size_t>(h >> 29);
+  }
 
-        std::vector<std::string> filenames;
-        SplitString(std::string(token), ' ', '\\', filenames);
+  vector_of<Slot>::type slots_;
+  uint32_t size_;
+};
 
-        if (filenames.empty()) {
-          if (warn) {
-            (*warn) +=
-                "Looks like empty filename for mtllib. Use default "
-                "material. \n";
-          }
-        } else {
-          bool found = false;
-          for (size_t s = 0; s < filenames.size(); s++) {
-            if (material_filenames.count(filenames[s]) > 0) {
-              found = true;
-              continue;
-            }
+static void SetIndexedVertex(indexed_vertex_t *vtx, const attrib_t &attrib,
+                             const index_t &idx) {
+  const size_t vi = static_cast<size_t>(idx.vertex_index);
+  const size_t ni = static_cast<size_t>(idx.normal_index);
+  const size_t ti = static_cast<size_t>(idx.texcoord_index);
 
-            std::string warn_mtl;
-            std::string err_mtl;
-            bool ok = (*readMatFn)(filenames[s].c_str(), &materials,
-                                   &material_map, &warn_mtl, &err_mtl);
+  if ((idx.vertex_index >= 0) && ((3 * vi + 2) < attrib.vertices.size())) {
+    vtx->position[0] = attrib.vertices[3 * vi + 0];
+    vtx->position[1] = attrib.vertices[3 * vi + 1];
+    vtx->position[2] = attrib.vertices[3 * vi + 2];
+  } else {
+    vtx->position[0] = vtx->position[1] = vtx->position[2] = real_t(0.0);
+  }
 
-            if (warn && (!warn_mtl.empty())) {
-              (*warn) += warn_mtl;  // This should be warn message.
-            }
+  if ((idx.normal_index >= 0) && ((3 * ni + 2) < attrib.normals.size())) {
+    vtx->normal[0] = attrib.normals[3 * ni + 0];
+    vtx->normal[1] = attrib.normals[3 * ni + 1];
+    vtx->normal[2] = attrib.normals[3 * ni + 2];
+  } else {
+    vtx->normal[0] = vtx->normal[1] = vtx->normal[2] = real_t(0.0);
+  }
 
-            if (err && (!err_mtl.empty())) {
-              (*err) += err_mtl;
-            }
+  if ((idx.texcoord_index >= 0) && ((2 * ti + 1) < attrib.texcoords.size())) {
+    vtx->texcoord[0] = attrib.texcoords[2 * ti + 0];
+    vtx->texcoord[1] = attrib.texcoords[2 * ti + 1];
+  } else {
+    vtx->texcoord[0] = vtx->texcoord[1] = real_t(0.0);
+  }
 
-            if (ok) {
-              found = true;
-              material_filenames.insert(filenames[s]);
-              break;
-            }
-          }
+  // Vertex color is a part of `v`, thus shares the vertex index.
+  if ((idx.vertex_index >= 0) && ((3 * vi + 2) < attrib.colors.size())) {
+    vtx->color[0] = attrib.colors[3 * vi + 0];
+    vtx->color[1] = attrib.colors[3 * vi + 1];
+    vtx->color[2] = attrib.colors[3 * vi + 2];
+  } else {
+    vtx->color[0] = vtx->color[1] = vtx->color[2] = real_t(1.0);
+  }
+}
 
-          if (!found) {
-            if (warn) {
-              (*warn) +=
-                  "Failed to load material file(s). Use default "
-                  "material.\n";
-            }
-          } else {
-            if (callback.mtllib_cb) {
-              callback.mtllib_cb(user_data, &materials.at(0),
-                                 static_cast<int>(materials.size()));
-            }
-          }
+void BuildIndexedMesh(indexed_mesh_t *indexed_mesh, const attrib_t &attrib,
+                      const shape_t &shape) {
+  const mesh_t &mesh = shape.mesh;
+  const size_t num_faces = mesh.num_face_vertices.size();
+
+  vector_of<indexed_vertex_t>::type &vertices = indexed_mesh->vertices;
+  vector_of<uint32_t>::type &indices = indexed_mesh->indices;
+  vector_of<indexed_submesh_t>::type &submeshes = indexed_mesh->submeshes;
+  vertices.clear();
+  indices.clear();
+  submeshes.clear();
+
+  // 1. Assign each face to the submesh of its material and count indices.
+  const uint32_t kNoSubmesh = 0xffffffffu;
+  vector_of<uint32_t>::type face_submesh(num_faces, kNoSubmesh);
+  size_t last_submesh = 0;
+  for (size_t f = 0; f < num_faces; f++) {
+    const unsigned int nv = mesh.num_face_vertices[f];
+    if (nv < 3) {
+      continue;
+    }
+    const int material_id =
+        (f < mesh.material_ids.size()) ? mesh.material_ids[f] : -1;
+
+    // Consecutive faces mostly share the material.
+    if (submeshes.empty() ||
+        (submeshes[last_submesh].material_id != material_id)) {
+      last_submesh = 0;
+      while ((last_submesh < submeshes.size()) &&
+             (submeshes[last_submesh].material_id != material_id)) {
+        last_submesh++;
+      }
+      if (last_submesh == submeshes.size()) {
+        indexed_submesh_t submesh;
+        submesh.material_id = material_id;
+        submesh.index_offset = 0;
+        submesh.num_indices = 0;
+        submeshes.push_back(submesh);
+      }
+    }
+    face_submesh[f] = static_cast<uint32_t>(last_submesh);
+    submeshes[last_submesh].num_indices += 3 * (nv - 2);
+  }
+
+  vector_of<uint32_t>::type cursor(submeshes.size());
+  uint32_t num_indices = 0;
+  for (size_t s = 0; s < submeshes.size(); s++) {
+    submeshes[s].index_offset = num_indices;
+    cursor[s] = num_indices;
+    num_indices += submeshes[s].num_indices;
+  }
+  indices.resize(num_indices);
+
+  // 2. Merge face vertices and write triangle fans to the submesh ranges.
+  // A mesh usually has about the same number of merged vertices as `v`.
+  const size_t expected_vertices =
+      (std::min)(mesh.indices.size(), attrib.vertices.size() / 3);
+  VertexIndexMap vertex_map(expected_vertices);
+  vertices.reserve(expected_vertices);
+  vector_of<uint32_t>::type face_vertices;
+  size_t index_offset = 0;
+  for (size_t f = 0; f < num_faces; f++) {
+    const unsigned int nv = mesh.num_face_vertices[f];
+    if ((face_submesh[f] != kNoSubmesh) &&
+        ((index_offset + nv) <= mesh.indices.size())) {
+      face_vertices.resize(nv);
+      for (unsigned int k = 0; k < nv; k++) {
+        const index_t &idx = mesh.indices[index_offset + k];
+        bool inserted = false;
+        face_vertices[k] = vertex_map.Insert(idx, &inserted);
+        if (inserted) {
+          vertices.resize(vertices.size() + 1);
+          SetIndexedVertex(&vertices.back(), attrib, idx);
         }
       }
 
-      continue;
+      uint32_t &dst = cursor[face_submesh[f]];
+      for (unsigned int k = 2; k < nv; k++) {
+        indices[dst++] = face_vertices[0];
+        indices[dst++] = face_vertices[k - 1];
+        indices[dst++] = face_vertices[k];
+      }
     }
+    index_offset += nv;
+  }
+}
 
-    // group name
-    if (token[0] == 'g' && IS_SPACE((token[1]))) {
-      names.clear();
+static void BuildIndexedMeshes(std::vector<indexed_mesh_t> *indexed_meshes,
+                               const attrib_t &attrib,
+                               const std::vector<shape_t> &shapes) {
+  indexed_meshes->resize(shapes.size());
+  for (size_t i = 0; i < shapes.size(); i++) {
+    BuildIndexedMesh(&(*indexed_meshes)[i], attrib, shapes[i]);
+  }
+}
 
-      while (!IS_NEW_LINE(token[0])) {
-        std::string str = parseString(&token);
-        names.push_back(str);
-        token += strspn(token, " \t\r");  // skip tag
-      }
+//
+// Binary cache file(`ObjReader::SaveCache`).
+//
+// All values are stored in the native byte order. Arrays start at 8 byte
+// aligned offsets, so they are copied from the mapped cache file with a single
+// memcpy each.
+//
+//   CacheHeader
+//   attrib_t
+//   std::vector<shape_t>
+//   std::vector<material_t>
+//   warning(std::string)
+//   std::vector<indexed_mesh_t>
+//
+struct CacheHeader {
+  char magic[8];  // "TOBJCACH"
+  uint32_t version;
+  uint32_t byte_order;  // kCacheByteOrderMark
+  uint32_t real_size;   // sizeof(real_t)
+  uint32_t reserved;
+  uint64_t obj_file_size;
+  int64_t obj_file_mtime;
+};
 
-      assert(names.size() > 0);
+static const char kCacheMagic[8] = {'T', 'O', 'B', 'J', 'C', 'A', 'C', 'H'};
+static const uint32_t kCacheVersion = 2;
+static const uint32_t kCacheByteOrderMark = 0x01020304;
 
-      if (callback.group_cb) {
-        if (names.size() > 1) {
-          // create const char* array.
-          names_out.resize(names.size() - 1);
-          for (size_t j = 0; j < names_out.size(); j++) {
-            names_out[j] = names[j + 1].c_str();
-          }
-          callback.group_cb(user_data, &names_out.at(0),
-                            static_cast<int>(names_out.size()));
+class CacheWriter {
+ public:
+  explicit CacheWriter(std::ostream *os) : os_(os), pos_(0) {}
 
-        } else {
-          callback.group_cb(user_data, NULL, 0);
-        }
-      }
+  bool ok() const { return os_->good(); }
 
-      continue;
+  void Bytes(const void *p, size_t n) {
+    os_->write(static_cast<const char *>(p), static_cast<std::streamsize>(n));
+    pos_ += n;
+  }
+
+  void Align() {
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    Bytes(zeros, (8 - (pos_ % 8)) % 8);
+  }
+
+  template <typename T>
+  void Value(T *v) {
+    Bytes(v, sizeof(T));
+  }
+
+  void Size(size_t *n) {
+    uint64_t v = (*n);
+    Value(&v);
+  }
+
+  template <typename T, typename Alloc>
+  void Array(std::vector<T, Alloc> *v) {
+    size_t n = v->size();
+    Size(&n);
+    Align();
+    if (n > 0) {
+      Bytes(&v->at(0), n * sizeof(T));
     }
+  }
 
-    // object name
-    if (token[0] == 'o' && IS_SPACE((token[1]))) {
-      // @todo { multiple object name? }
-      token += 2;
+  void String(std::string *str) {
+    size_t n = str->size();
+    Size(&n);
+    Bytes(str->data(), n);
+  }
 
-      std::stringstream ss;
-      ss << token;
-      std::string object_name = ss.str();
+  void StringMap(std::map<std::string, std::string> *m) {
+    size_t n = m->size();
+    Size(&n);
+    for (std::map<std::string, std::string>::iterator it = m->begin();
+         it != m->end(); ++it) {
+      std::string key = it->first;
+      String(&key);
+      String(&it->second);
+    }
+  }
 
-      if (callback.object_cb) {
-        callback.object_cb(user_data, object_name.c_str());
-      }
+  // Elements are serialized by the caller.
+  template <typename T, typename Alloc>
+  void Resize(std::vector<T, Alloc> *v) {
+    size_t n = v->size();
+    Size(&n);
+  }
 
-      continue;
+ private:
+  std::ostream *os_;
+  size_t pos_;
+};
+
+class CacheReader {
+ public:
+  CacheReader(const char *data, size_t size)
+      : data_(data), size_(size), pos_(0), ok_(true) {}
+
+  bool ok() const { return ok_; }
+
+  void Bytes(void *p, size_t n) {
+    if (!ok_ || (n > (size_ - pos_))) {
+      ok_ = false;
+      return;
     }
+    memcpy(p, data_ + pos_, n);
+    pos_ += n;
+  }
 
-#if 0  // @todo
-    if (token[0] == 't' && IS_SPACE(token[1])) {
-      tag_t tag;
+  void Align() {
+    size_t pad = (8 - (pos_ % 8)) % 8;
+    if (!ok_ || (pad > (size_ - pos_))) {
+      ok_ = false;
+      return;
+    }
+    pos_ += pad;
+  }
 
-      token += 2;
-      std::stringstream ss;
-      ss << token;
-      tag.name = ss.str();
+  template <typename T>
+  void Value(T *v) {
+    Bytes(v, sizeof(T));
+  }
 
-      token += tag.name.size() + 1;
+  // Every element takes 1 byte or more, so a valid size never exceeds the
+  // remaining bytes. This also prevents a huge allocation for a broken file.
+  void Size(size_t *n) {
+    uint64_t v = 0;
+    Value(&v);
+    if (!ok_ || (v > uint64_t(size_ - pos_))) {
+      ok_ = false;
+      v = 0;
+    }
+    (*n) = static_cast<size_t>(v);
+  }
 
-      tag_sizes ts = parseTagTriple(&token);
+  template <typename T, typename Alloc>
+  void Array(std::vector<T, Alloc> *v) {
+    size_t n = 0;
+    Size(&n);
+    Align();
+    if (!ok_ || (n > ((size_ - pos_) / sizeof(T)))) {
+      ok_ = false;
+      v->clear();
+      return;
+    }
+    v->resize(n);
+    if (n > 0) {
+      Bytes(&v->at(0), n * sizeof(T));
+    }
+  }
 
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+  void String(std::string *str) {
+    size_t n = 0;
+    Size(&n);
+    if (!ok_) {
+      return;
+    }
+    str->assign(data_ + pos_, n);
+    pos_ += n;
+  }
 
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = atoi(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+  void StringMap(std::map<std::string, std::string> *m) {
+    size_t n = 0;
+    Size(&n);
+    m->clear();
+    for (size_t i = 0; ok_ && (i < n); i++) {
+      std::string key;
+      std::string value;
+      String(&key);
+      String(&value);
+      (*m)[key] = value;
+    }
+  }
 
-      tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
-        tag.floatValues[i] = parseReal(&token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
+  template <typename T, typename Alloc>
+  void Resize(std::vector<T, Alloc> *v) {
+    size_t n = 0;
+    Size(&n);
+    v->resize(n);
+  }
 
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        std::stringstream ss;
-        ss << token;
-        tag.stringValues[i] = ss.str();
-        token += tag.stringValues[i].size() + 1;
-      }
+ private:
+  const char *data_;
+  size_t size_;
+  size_t pos_;
+  bool ok_;
+};
+
+// Serialize(`CacheWriter`) or deserialize(`CacheReader`) data.
+
+template <typename Archive>
+static void SerializeTextureOption(Archive *ar, texture_option_t *opt) {
+  ar->Value(&opt->type);
+  ar->Value(&opt->sharpness);
+  ar->Value(&opt->brightness);
+  ar->Value(&opt->contrast);
+  ar->Value(&opt->origin_offset);
+  ar->Value(&opt->scale);
+  ar->Value(&opt->turbulence);
+  ar->Value(&opt->texture_resolution);
+  ar->Value(&opt->clamp);
+  ar->Value(&opt->imfchan);
+  ar->Value(&opt->blendu);
+  ar->Value(&opt->blendv);
+  ar->Value(&opt->bump_multiplier);
+  ar->String(&opt->colorspace);
+}
+
+template <typename Archive>
+static void SerializeMaterial(Archive *ar, material_t *m) {
+  ar->String(&m->name);
+
+  ar->Value(&m->ambient);
+  ar->Value(&m->diffuse);
+  ar->Value(&m->specular);
+  ar->Value(&m->transmittance);
+  ar->Value(&m->emission);
+  ar->Value(&m->shininess);
+  ar->Value(&m->ior);
+  ar->Value(&m->dissolve);
+  ar->Value(&m->illum);
+
+  ar->String(&m->ambient_texname);
+  ar->String(&m->diffuse_texname);
+  ar->String(&m->specular_texname);
+  ar->String(&m->specular_highlight_texname);
+  ar->String(&m->bump_texname);
+  ar->String(&m->displacement_texname);
+  ar->String(&m->alpha_texname);
+  ar->String(&m->reflection_texname);
+
+  SerializeTextureOption(ar, &m->ambient_texopt);
+  SerializeTextureOption(ar, &m->diffuse_texopt);
+  SerializeTextureOption(ar, &m->specular_texopt);
+  SerializeTextureOption(ar, &m->specular_highlight_texopt);
+  SerializeTextureOption(ar, &m->bump_texopt);
+  SerializeTextureOption(ar, &m->displacement_texopt);
+  SerializeTextureOption(ar, &m->alpha_texopt);
+  SerializeTextureOption(ar, &m->reflection_texopt);
+
+  ar->Value(&m->roughness);
+  ar->Value(&m->metallic);
+  ar->Value(&m->sheen);
+  ar->Value(&m->clearcoat_thickness);
+  ar->Value(&m->clearcoat_roughness);
+  ar->Value(&m->anisotropy);
+  ar->Value(&m->anisotropy_rotation);
+  ar->String(&m->roughness_texname);
+  ar->String(&m->metallic_texname);
+  ar->String(&m->sheen_texname);
+  ar->String(&m->emissive_texname);
+  ar->String(&m->normal_texname);
+
+  SerializeTextureOption(ar, &m->roughness_texopt);
+  SerializeTextureOption(ar, &m->metallic_texopt);
+  SerializeTextureOption(ar, &m->sheen_texopt);
+  SerializeTextureOption(ar, &m->emissive_texopt);
+  SerializeTextureOption(ar, &m->normal_texopt);
+
+  ar->StringMap(&m->unknown_parameter);
+}
 
-      tags.push_back(tag);
+template <typename Archive>
+static void SerializeShape(Archive *ar, shape_t *shape) {
+  ar->String(&shape->name);
+
+  ar->Array(&shape->mesh.indices);
+  ar->Array(&shape->mesh.num_face_vertices);
+  ar->Array(&shape->mesh.material_ids);
+  ar->Array(&shape->mesh.smoothing_group_ids);
+
+  ar->Resize(&shape->mesh.tags);
+  for (size_t i = 0; ar->ok() && (i < shape->mesh.tags.size()); i++) {
+    tag_t &tag = shape->mesh.tags[i];
+    ar->String(&tag.name);
+    ar->Array(&tag.intValues);
+    ar->Array(&tag.floatValues);
+    ar->Resize(&tag.stringValues);
+    for (size_t k = 0; ar->ok() && (k < tag.stringValues.size()); k++) {
+      ar->String(&tag.stringValues[k]);
     }
-#endif
+  }
+
+  ar->Array(&shape->lines.indices);
+  ar->Array(&shape->lines.num_line_vertices);
+  ar->Array(&shape->points.indices);
+}
 
-    // Ignore unknown command.
+template <typename Archive>
+static void SerializeAttrib(Archive *ar, attrib_t *attrib) {
+  ar->Array(&attrib->vertices);
+  ar->Array(&attrib->vertex_weights);
+  ar->Array(&attrib->normals);
+  ar->Array(&attrib->texcoords);
+  ar->Array(&attrib->texcoord_ws);
+  ar->Array(&attrib->colors);
+
+  ar->Resize(&attrib->skin_weights);
+  for (size_t i = 0; ar->ok() && (i < attrib->skin_weights.size()); i++) {
+    ar->Value(&attrib->skin_weights[i].vertex_id);
+    ar->Array(&attrib->skin_weights[i].weightValues);
   }
+}
 
-  if (err) {
-    (*err) += errss.str();
+template <typename Archive>
+static void SerializeObj(Archive *ar, attrib_t *attrib,
+                         std::vector<shape_t> *shapes,
+                         std::vector<material_t> *materials,
+                         std::string *warning,
+                         std::vector<indexed_mesh_t> *indexed_meshes) {
+  SerializeAttrib(ar, attrib);
+
+  ar->Resize(shapes);
+  for (size_t i = 0; ar->ok() && (i < shapes->size()); i++) {
+    SerializeShape(ar, &(*shapes)[i]);
   }
 
-  return true;
+  ar->Resize(materials);
+  for (size_t i = 0; ar->ok() && (i < materials->size()); i++) {
+    SerializeMaterial(ar, &(*materials)[i]);
+  }
+
+  ar->String(warning);
+
+  ar->Resize(indexed_meshes);
+  for (size_t i = 0; ar->ok() && (i < indexed_meshes->size()); i++) {
+    ar->Array(&(*indexed_meshes)[i].vertices);
+    ar->Array(&(*indexed_meshes)[i].indices);
+    ar->Array(&(*indexed_meshes)[i].submeshes);
+  }
 }
 
-bool ObjReader::ParseFromFile(const std::string &filename,
-                              const ObjReaderConfig &config) {
+// Returns the directory to search .mtl files of .obj `filename`, with a
+// trailing directory separator.
+static std::string GetMtlSearchPath(const std::string &filename,
+                                    const ObjReaderConfig &config) {
   std::string mtl_search_path;
 
   if (config.mtl_search_path.empty()) {
@@ -3467,9 +7657,46 @@ bool ObjReader::ParseFromFile(const std::string &filename,
     mtl_search_path = config.mtl_search_path;
   }
 
-  valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
-                   filename.c_str(), mtl_search_path.c_str(),
-                   config.triangulate, config.vertex_color);
+  if (!mtl_search_path.empty()) {
+#ifndef _WIN32
+    const char dirsep = '/';
+#else
+    const char dirsep = '\\';
+#endif
+    if (mtl_search_path[mtl_search_path.length() - 1] != dirsep) {
+      mtl_search_path += dirsep;
+    }
+  }
+
+  return mtl_search_path;
+}
+
+bool ObjReader::ParseFromFile(const std::string &filename,
+                              const ObjReaderConfig &config) {
+  if (!GetFileStamp(filename, &obj_file_size_, &obj_file_mtime_)) {
+    obj_file_size_ = 0;
+    obj_file_mtime_ = 0;
+  }
+
+  FileData obj_data;
+  if (!obj_data.Open(filename, config.use_mmap)) {
+    std::stringstream ss;
+    ss << "Cannot open file [" << filename << "]\n";
+    error_ = ss.str();
+    valid_ = false;
+    return valid_;
+  }
+
+  MaterialFileReader matFileReader(GetMtlSearchPath(filename, config));
+
+  valid_ = LoadObjFromMemory(&attrib_, &shapes_, &materials_, &warning_,
+                             &error_, obj_data.data(), obj_data.size(),
+                             &matFileReader, config);
+
+  indexed_meshes_.clear();
+  if (valid_ && config.indexed_mesh) {
+    BuildIndexedMeshes(&indexed_meshes_, attrib_, shapes_);
+  }
 
   return valid_;
 }
@@ -3477,20 +7704,358 @@ bool ObjReader::ParseFromFile(const std::string &filename,
 bool ObjReader::ParseFromString(const std::string &obj_text,
                                 const std::string &mtl_text,
                                 const ObjReaderConfig &config) {
-  std::stringbuf obj_buf(obj_text);
-  std::stringbuf mtl_buf(mtl_text);
+  return ParseFromMemory(obj_text.data(), obj_text.size(), mtl_text.data(),
+                         mtl_text.size(), config);
+}
 
-  std::istream obj_ifs(&obj_buf);
-  std::istream mtl_ifs(&mtl_buf);
+bool ObjReader::ParseFromMemory(const char *obj_buf, size_t obj_len,
+                                const char *mtl_buf, size_t mtl_len,
+                                const ObjReaderConfig &config) {
+  MemoryStreamBuf mtl_sbuf(mtl_buf, mtl_buf ? mtl_len : 0);
+  std::istream mtl_ifs(&mtl_sbuf);
 
   MaterialStreamReader mtl_ss(mtl_ifs);
 
-  valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
-                   &obj_ifs, &mtl_ss, config.triangulate, config.vertex_color);
+  obj_file_size_ = 0;
+  obj_file_mtime_ = 0;
+
+  valid_ = LoadObjFromMemory(&attrib_, &shapes_, &materials_, &warning_,
+                             &error_, obj_buf, obj_buf ? obj_len : 0, &mtl_ss,
+                             config);
+
+  indexed_meshes_.clear();
+  if (valid_ && config.indexed_mesh) {
+    BuildIndexedMeshes(&indexed_meshes_, attrib_, shapes_);
+  }
+
+  return valid_;
+}
+
+bool ObjReader::SaveCache(const std::string &cache_filename) {
+  if (!valid_) {
+    // `LoadCache` would make a partial result valid.
+    std::stringstream ss;
+    ss << "Cannot save cache file [" << cache_filename
+       << "] of a failed parse\n";
+    error_ += ss.str();
+    return false;
+  }
+
+  std::ofstream ofs(cache_filename.c_str(), std::ios::out | std::ios::binary);
+  if (!ofs) {
+    std::stringstream ss;
+    ss << "Cannot open cache file [" << cache_filename << "] for writing\n";
+    error_ += ss.str();
+    return false;
+  }
+
+  CacheHeader header;
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.byte_order = kCacheByteOrderMark;
+  header.real_size = static_cast<uint32_t>(sizeof(real_t));
+  header.reserved = 0;
+  header.obj_file_size = obj_file_size_;
+  header.obj_file_mtime = obj_file_mtime_;
+
+  // `CacheWriter` does not modify the data.
+  CacheWriter writer(&ofs);
+  writer.Value(&header);
+  SerializeObj(&writer, &attrib_, &shapes_, &materials_, &warning_,
+               &indexed_meshes_);
+
+  ofs.flush();
+  if (!writer.ok()) {
+    std::stringstream ss;
+    ss << "Failed to write cache file [" << cache_filename << "]\n";
+    error_ += ss.str();
+    return false;
+  }
+
+  return true;
+}
+
+bool ObjReader::LoadCache(const std::string &cache_filename,
+                          const std::string &obj_filename) {
+  FileData cache_data;
+  if (!cache_data.Open(cache_filename, /* use_mmap */ true)) {
+    std::stringstream ss;
+    ss << "Cannot open cache file [" << cache_filename << "]\n";
+    error_ = ss.str();
+    valid_ = false;
+    return valid_;
+  }
+
+  CacheReader reader(cache_data.data(), cache_data.size());
+
+  CacheHeader header;
+  reader.Value(&header);
+  if (!reader.ok() ||
+      (0 != memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic))) ||
+      (header.version != kCacheVersion) ||
+      (header.byte_order != kCacheByteOrderMark) ||
+      (header.real_size != sizeof(real_t))) {
+    std::stringstream ss;
+    ss << "Incompatible cache file [" << cache_filename << "]\n";
+    error_ = ss.str();
+    valid_ = false;
+    return valid_;
+  }
+
+  if (!obj_filename.empty()) {
+    uint64_t obj_file_size = 0;
+    int64_t obj_file_mtime = 0;
+    if (!GetFileStamp(obj_filename, &obj_file_size, &obj_file_mtime) ||
+        (obj_file_size != header.obj_file_size) ||
+        (obj_file_mtime != header.obj_file_mtime)) {
+      std::stringstream ss;
+      ss << "Cache file [" << cache_filename << "] is outdated for ["
+         << obj_filename << "]\n";
+      error_ = ss.str();
+      valid_ = false;
+      return valid_;
+    }
+  }
+
+  attrib_t attrib;
+  std::vector<shape_t> shapes;
+  std::vector<material_t> materials;
+  std::string warning;
+  std::vector<indexed_mesh_t> indexed_meshes;
+  SerializeObj(&reader, &attrib, &shapes, &materials, &warning,
+               &indexed_meshes);
+  if (!reader.ok()) {
+    std::stringstream ss;
+    ss << "Broken cache file [" << cache_filename << "]\n";
+    error_ = ss.str();
+    valid_ = false;
+    return valid_;
+  }
+
+  attrib_.vertices.swap(attrib.vertices);
+  attrib_.vertex_weights.swap(attrib.vertex_weights);
+  attrib_.normals.swap(attrib.normals);
+  attrib_.texcoords.swap(attrib.texcoords);
+  attrib_.texcoord_ws.swap(attrib.texcoord_ws);
+  attrib_.colors.swap(attrib.colors);
+  attrib_.skin_weights.swap(attrib.skin_weights);
+  shapes_.swap(shapes);
+  materials_.swap(materials);
+  warning_.swap(warning);
+  indexed_meshes_.swap(indexed_meshes);
+  error_.clear();
+  obj_file_size_ = header.obj_file_size;
+  obj_file_mtime_ = header.obj_file_mtime;
+
+  valid_ = true;
+  return valid_;
+}
+
+ObjStreamReader::ObjStreamReader()
+    : valid_(false),
+      finished_(true),
+      stream_(NULL),
+      file_(NULL),
+      file_mat_reader_(NULL),
+      decompress_buf_(NULL),
+      decompress_stream_(NULL),
+      parser_(NULL),
+      completed_index_(0) {}
+
+ObjStreamReader::~ObjStreamReader() { Close(); }
+
+void ObjStreamReader::Close() {
+  delete parser_;
+  parser_ = NULL;
+  delete file_mat_reader_;
+  file_mat_reader_ = NULL;
+  delete decompress_stream_;
+  decompress_stream_ = NULL;
+  delete decompress_buf_;
+  decompress_buf_ = NULL;
+  delete file_;
+  file_ = NULL;
+  stream_ = NULL;
+
+  completed_shapes_.clear();
+  completed_index_ = 0;
+  attrib_ = attrib_t();
+  materials_.clear();
+  warning_.clear();
+  error_.clear();
+  valid_ = false;
+  finished_ = true;
+}
+
+bool ObjStreamReader::Open(const std::string &filename,
+                           const ObjReaderConfig &config) {
+  Close();
+
+  file_ = new std::ifstream(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file_->is_open()) {
+    delete file_;
+    file_ = NULL;
+    std::stringstream ss;
+    ss << "Cannot open file [" << filename << "]\n";
+    error_ = ss.str();
+    return false;
+  }
+
+  file_mat_reader_ =
+      new MaterialFileReader(GetMtlSearchPath(filename, config));
+
+  const CompressionType compression = DetectStreamCompression(file_);
+  if (compression != COMPRESSION_NONE) {
+    decompress_buf_ = new DecompressStreamBuf(file_, compression);
+    decompress_stream_ = new std::istream(decompress_buf_);
+    return Start(decompress_stream_, file_mat_reader_, config);
+  }
+
+  return Start(file_, file_mat_reader_, config);
+}
+
+bool ObjStreamReader::Open(std::istream *inStream, MaterialReader *readMatFn,
+                           const ObjReaderConfig &config) {
+  Close();
+
+  return Start(inStream, readMatFn, config);
+}
+
+bool ObjStreamReader::Start(std::istream *inStream, MaterialReader *readMatFn,
+                            const ObjReaderConfig &config) {
+  stream_ = inStream;
+  parser_ = new ObjParser(&completed_shapes_, &materials_, readMatFn,
+                          config.triangulate, config.vertex_color, &warning_,
+                          &error_);
+  parser_->SetDefaultVertexAttribs(config.default_vertex_attribs);
+  parser_->SetAttributeMask(config.attribute_mask);
+  valid_ = (stream_ != NULL);
+  finished_ = !valid_;
+
+  return valid_;
+}
+
+bool ObjStreamReader::ReadShape(shape_t *shape) {
+  while (completed_index_ >= completed_shapes_.size()) {
+    // Release the shapes already returned.
+    completed_shapes_.clear();
+    completed_index_ = 0;
+
+    if (finished_) {
+      return false;
+    }
+
+    if (stream_->peek() == -1) {
+      if (decompress_buf_ && !decompress_buf_->Error().empty()) {
+        error_ += decompress_buf_->Error();
+        completed_shapes_.clear();
+        valid_ = false;
+        finished_ = true;
+        return false;
+      }
+      parser_->Finish(&attrib_);
+      finished_ = true;
+      continue;
+    }
+
+    safeGetline(*stream_, linebuf_);
+    if (!parser_->ParseLine(linebuf_.c_str())) {
+      completed_shapes_.clear();
+      valid_ = false;
+      finished_ = true;
+      return false;
+    }
+  }
+
+  std::swap(*shape, completed_shapes_[completed_index_]);
+  completed_index_++;
+
+  return true;
+}
+
+const vector_of<real_t>::type &ObjStreamReader::GetVertices() const {
+  if (parser_ && !finished_) {
+    return parser_->vertices();
+  }
+  return attrib_.vertices;
+}
+
+ObjIncrementalParser::ObjIncrementalParser()
+    : valid_(false),
+      finished_(true),
+      indexed_mesh_(false),
+      parser_(NULL),
+      skip_lf_(false) {}
+
+ObjIncrementalParser::~ObjIncrementalParser() { Close(); }
+
+void ObjIncrementalParser::Close() {
+  delete parser_;
+  parser_ = NULL;
+
+  linebuf_.clear();
+  skip_lf_ = false;
+  attrib_ = attrib_t();
+  shapes_.clear();
+  materials_.clear();
+  indexed_meshes_.clear();
+  warning_.clear();
+  error_.clear();
+  valid_ = false;
+  finished_ = true;
+}
+
+bool ObjIncrementalParser::Start(MaterialReader *readMatFn,
+                                 const ObjReaderConfig &config) {
+  Close();
+
+  parser_ = new ObjParser(&shapes_, &materials_, readMatFn, config.triangulate,
+                          config.vertex_color, &warning_, &error_);
+  parser_->SetDefaultVertexAttribs(config.default_vertex_attribs);
+  parser_->SetAttributeMask(config.attribute_mask);
+  indexed_mesh_ = config.indexed_mesh;
+  valid_ = true;
+  finished_ = false;
 
   return valid_;
 }
 
+bool ObjIncrementalParser::Feed(const char *buf, size_t len) {
+  if (finished_) {
+    return false;
+  }
+
+  if (!FeedLines(parser_, buf, len, &linebuf_, &skip_lf_)) {
+    valid_ = false;
+    finished_ = true;
+    return false;
+  }
+
+  return true;
+}
+
+bool ObjIncrementalParser::Finish() {
+  if (finished_) {
+    return false;
+  }
+  finished_ = true;
+
+  if (!FinishLines(parser_, &linebuf_)) {
+    valid_ = false;
+    return false;
+  }
+
+  parser_->Finish(&attrib_);
+  delete parser_;
+  parser_ = NULL;
+
+  if (indexed_mesh_) {
+    BuildIndexedMeshes(&indexed_meshes_, attrib_, shapes_);
+  }
+
+  return true;
+}
+
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif